@@ -0,0 +1,67 @@
+// capacity_planner.h
+#ifndef CAPACITY_PLANNER_H
+#define CAPACITY_PLANNER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "load_balancer.h"
+#include "fleet_snapshot.h"
+
+// A candidate fleet: groups of identical servers
+struct FleetConfiguration {
+    std::string name;
+    std::vector<std::pair<int, int>> groups;   // (server count, capacity per server)
+
+    int serverCount() const;
+    int totalCapacity() const;
+    FleetSnapshot materialize() const;
+};
+
+struct PlanningTargets {
+    double maxUtilization = 80.0;   // no server above this percentage at any point of the curve
+    double maxVariance = 100.0;     // variance of server load percentages, as in the status view
+};
+
+struct PlanEvaluation {
+    bool feasible;
+    int unplacedLoad;               // worst step; load the fleet could not take
+    double peakUtilization;         // worst step; hottest server
+    double peakVariance;            // worst step
+    size_t stepsEvaluated;          // stops at the first step that misses a target
+};
+
+struct CapacityPlan {
+    std::vector<BalancingAlgorithm> algorithms;
+    std::vector<std::vector<PlanEvaluation>> evaluations;   // [algorithm][configuration]
+    std::vector<int> best;                                  // per algorithm; -1 when nothing fits
+    double elapsedMs;
+};
+
+// What-if planner: replays a forecast load curve on every candidate fleet with each
+// algorithm and picks the smallest fleet (by total capacity, then server count)
+// that stays within the targets. Every step places the whole forecast load on an
+// empty fleet, as a rebalance would. Evaluations run in parallel.
+class CapacityPlanner {
+private:
+    unsigned threads;
+
+    PlanEvaluation evaluate(const FleetSnapshot& fleet, const std::vector<int>& forecast,
+                            BalancingAlgorithm algorithm, const PlanningTargets& targets) const;
+
+public:
+    // threads = 0 uses one per hardware thread
+    explicit CapacityPlanner(unsigned threads = 0);
+
+    // COST_OPTIMIZED depends on the balancer's cost index and is skipped
+    CapacityPlan plan(const std::vector<int>& forecast, const std::vector<FleetConfiguration>& candidates,
+                      const std::vector<BalancingAlgorithm>& algorithms,
+                      const PlanningTargets& targets = PlanningTargets()) const;
+
+    // Every fleet of minServers..maxServers servers of each listed capacity
+    static std::vector<FleetConfiguration> uniformCandidates(int minServers, int maxServers,
+                                                             const std::vector<int>& capacities);
+    static std::string formatPlan(const CapacityPlan& plan, const std::vector<FleetConfiguration>& candidates);
+};
+
+#endif // CAPACITY_PLANNER_H
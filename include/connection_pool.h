@@ -0,0 +1,163 @@
+// connection_pool.h
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ConnectionPoolOptions {
+    int minIdle = 4;                    // kept open ahead of demand
+    int maxSize = 64;                   // open connections per server, idle or in use
+    double maxLifetimeSeconds = 300.0;  // older connections are closed on checkout or return
+    double connectLatencyUs = 500.0;    // TCP and TLS setup to the backend, modeled
+    int maxStreamsPerConnection = 1;    // 1 is HTTP/1.1; more multiplexes requests as HTTP/2 streams
+};
+
+// A stream on a checked-out connection; slot is -1 when the pool was exhausted
+struct PooledConnection {
+    int serverId;
+    int slot;
+    bool reused;
+};
+
+struct ConnectionPoolStats {
+    uint64_t checkouts;
+    uint64_t reuses;             // checkouts served by an already open connection
+    uint64_t created;
+    uint64_t recycled;           // closed for reaching the maximum lifetime
+    uint64_t exhausted;          // checkouts refused with every stream slot in use
+    int idle;                    // open connections with a free stream slot
+    int activeStreams;
+    int openConnections;
+    int peakConnections;
+    int exhaustedPools;          // pools with nothing left to hand out right now
+    double meanCheckoutUs;       // measured, plus the modeled connect for new connections
+    double maxCheckoutUs;
+
+    double reuseRatio() const { return checkouts ? static_cast<double>(reuses) / checkouts : 0.0; }
+    double streamsPerConnection() const {
+        return openConnections ? static_cast<double>(activeStreams) / openConnections : 0.0;
+    }
+};
+
+// Requests from concurrent clients through the pools to an in-process stand-in
+// backend that holds each stream for the service time
+struct UpstreamBenchmarkReport {
+    int clients;
+    int requests;
+    int maxStreamsPerConnection;
+    int poolSize;                // connections per server
+    uint64_t connectionsOpened;
+    int peakConnections;         // summed over servers
+    uint64_t refused;            // checkouts retried because every slot was busy
+    int failed;                  // requests given up after the retry limit
+    double meanLatencyUs;        // wait for a stream, connect if new, service
+    double p99LatencyUs;
+    double requestsPerSecond;
+};
+
+// Upstream connections of one server for proxy modes. Open connections with a
+// free stream slot sit on a lock-free stack, so the most recently returned
+// (warmest) connection is handed out first; unopened slots sit on a second
+// stack. Both are Treiber stacks over slot indexes, with a tag in the head word
+// against ABA.
+//
+// With HTTP/1.1 a connection carries one request at a time and leaves the stack
+// while checked out. Multiplexed connections stay on the stack until all their
+// streams are taken, so new requests pack onto the warmest connection and the
+// pool opens another only when it is full. A connection past its lifetime, or
+// broken, drains: it takes no new streams and closes with its last one.
+class ConnectionPool {
+private:
+    struct Connection {
+        std::atomic<uint32_t> next;
+        std::atomic<uint32_t> state;     // streams in flight, plus kDraining
+        std::atomic<bool> retire;        // broken while on the stack; the next checkout drains it
+        double createdAt;                // written only while the slot is unopened
+    };
+
+    struct alignas(64) Stack {
+        std::atomic<uint64_t> head;  // tag << 32 | slot
+    };
+
+    static constexpr uint32_t kNil = 0xFFFFFFFFu;
+    static constexpr uint32_t kDraining = 0x80000000u;
+    static constexpr uint32_t kStreamMask = 0x7FFFFFFFu;
+    static constexpr int kCheckoutRetries = 16;
+
+    int serverId;
+    ConnectionPoolOptions options;
+    std::unique_ptr<Connection[]> connections;
+    Stack idle;
+    Stack unopened;
+    std::atomic<int> idleCount;
+    std::atomic<int> activeStreams;
+    std::atomic<int> openConnections;
+    std::atomic<int> peakConnections;
+
+    std::atomic<uint64_t> checkouts;
+    std::atomic<uint64_t> reuses;
+    std::atomic<uint64_t> created;
+    std::atomic<uint64_t> recycled;
+    std::atomic<uint64_t> exhausted;
+    std::atomic<uint64_t> checkoutNanos;
+    std::atomic<uint64_t> maxCheckoutNanos;
+
+    void push(Stack& stack, uint32_t slot);
+    uint32_t pop(Stack& stack);
+    bool expired(uint32_t slot, double now) const;
+    void open(uint32_t slot, double now, uint32_t streams);
+    void close(uint32_t slot);
+    void drain(uint32_t slot, double now);   // by the thread holding the slot off the stack
+    void recordCheckout(uint64_t nanos);
+
+public:
+    ConnectionPool(int serverId, const ConnectionPoolOptions& options, double now);
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    PooledConnection checkout(double now);
+    void checkin(const PooledConnection& connection, double now, bool broken = false);
+
+    // Opens connections until minIdle are idle (bounded by maxSize); returns how many
+    int warmup(double now);
+
+    int getServerId() const;
+    int getHeadroom() const;     // stream slots that could still be checked out
+    ConnectionPoolStats getStats() const;
+};
+
+// One pool per server. Pools are added and removed with membership on the
+// balancer's thread; checkout and checkin may come from any thread.
+class ConnectionPoolManager {
+private:
+    ConnectionPoolOptions options;
+    std::unordered_map<int, std::unique_ptr<ConnectionPool>> pools;
+    std::chrono::steady_clock::time_point startTime;
+
+public:
+    explicit ConnectionPoolManager(const ConnectionPoolOptions& options = ConnectionPoolOptions());
+
+    double now() const;          // seconds since the manager was created
+    const ConnectionPoolOptions& getOptions() const;
+
+    void addServer(int serverId);
+    void removeServer(int serverId);
+    ConnectionPool* getPool(int serverId) const;
+
+    // Placement capacity signal: stream slots left, or -1 for a server without a pool
+    int getHeadroom(int serverId) const;
+    void maintain();             // min-idle warmup of every pool
+
+    ConnectionPoolStats getStats() const;
+    static std::string formatStats(const ConnectionPoolStats& stats);
+    static std::string formatUpstreamReports(const std::vector<UpstreamBenchmarkReport>& reports);
+};
+
+#endif // CONNECTION_POOL_H
@@ -0,0 +1,166 @@
+// connection_table.h
+#ifndef CONNECTION_TABLE_H
+#define CONNECTION_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "huge_pages.h"
+#include "key_hasher.h"
+
+struct FlowTuple {
+    uint32_t srcIp;
+    uint32_t dstIp;
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint8_t protocol;
+};
+
+// Maglev consistent hashing: every backend walks its own permutation of a prime
+// sized lookup table, claiming free entries in turns proportional to its weight.
+// Removing a backend only remaps the entries it held plus a small fraction of
+// the others, so a flow hashes to the same backend on every balancer that sees
+// the same membership, including one that just restarted.
+class MaglevHash {
+private:
+    KeyHasher hasher;
+    std::vector<int> entries;
+
+public:
+    static const size_t kDefaultTableSize = 65537;
+
+    // tableSize should be a prime well above the backend count
+    explicit MaglevHash(const KeyHasher& hasher, size_t tableSize = kDefaultTableSize);
+
+    // Backends with a non-positive weight are left out
+    void build(const std::vector<int>& backendIds, const std::vector<double>& weights);
+    int lookup(uint64_t flowHash) const;   // -1 without backends
+    size_t tableSize() const;
+};
+
+struct ConnectionTableStats {
+    uint64_t hits;
+    uint64_t newFlows;
+    uint64_t recovered;          // mid-connection packets of flows the table did not know
+    uint64_t rerouted;           // tracked flows whose backend left
+    uint64_t expired;
+    uint64_t untracked;          // routed by hash alone because the table was full
+    uint64_t rehashes;           // in-place rebuilds clearing tombstones
+    size_t flows;                // includes idle flows not reaped yet
+    size_t capacity;
+    size_t memoryBytes;
+};
+
+struct ConnectionBenchmarkReport {
+    int backends;
+    int flows;
+    int lookups;
+    size_t memoryBytes;
+    double insertsPerSecond;
+    double lookupsPerSecond;
+    double keptAfterRemoval;           // flows on surviving backends left in place with the table
+    double keptAfterRemovalHashOnly;   // ... by consistent hashing alone
+    double keptAfterRestart;           // flows recovered onto their backend by an empty table
+    double keptAfterRestartAndRemoval;
+    int churnRounds;                   // each replaces every flow once: close one, open a new one
+    uint64_t churnRehashes;
+    double firstRoundMissNs;           // mean cost of opening a new flow, first churn round
+    double lastRoundMissNs;
+};
+
+// L4 connection tracking for direct server return: the balancer only sees the
+// client-to-server direction, so a flow's backend has to be remembered, not
+// recomputed, for connections to outlive membership changes.
+//
+// Slots are 16-wide groups with a control byte per slot holding 7 bits of the
+// flow's hash, or empty/deleted. A lookup compares the tag against a whole group
+// with one SSE2 compare and only reads entries whose tag matched. Entries are 20
+// bytes; at the maximum load of 7/8 a flow costs 24 bytes of table. Tables are
+// sized up front (10M flows is about 240MB) and live in huge pages when enabled.
+//
+// Expiry is lazy: an idle entry is dropped when a lookup reaches it, and each
+// insert reaps one more group in sweep order. Erasing from a full group leaves a
+// tombstone so probes keep going past it; under churn those would leave no group
+// with an empty slot and every miss would walk the whole table, so once they pass
+// 1/16 of capacity the table is rehashed in place. Flows the table does not know fall
+// back to the Maglev hash, so after a restart existing connections land on the
+// backend they were on as long as membership did not change meanwhile.
+//
+// Not thread-safe; a forwarding path keeps one table per core.
+class ConnectionTable {
+private:
+    struct ConnectionEntry {
+        uint32_t srcIp;
+        uint32_t dstIp;
+        uint16_t srcPort;
+        uint16_t dstPort;
+        uint32_t lastSeen;
+        uint32_t backendAndProtocol;   // server id in the low 24 bits
+    };
+
+    static constexpr size_t kGroupWidth = 16;
+    static constexpr uint8_t kEmptySlot = 0x80;
+    static constexpr uint8_t kDeletedSlot = 0xFE;
+
+    KeyHasher hasher;
+    MaglevHash maglev;
+    std::vector<uint8_t> liveBackends;     // indexed by server id
+    std::vector<uint8_t, HugePageAllocator<uint8_t>> control;
+    std::vector<ConnectionEntry, HugePageAllocator<ConnectionEntry>> entries;
+    size_t groupCount;
+    size_t maxFlows;
+    size_t used;                 // full slots
+    size_t tombstones;
+    size_t sweepCursor;
+    uint32_t idleTimeout;
+
+    uint64_t hits;
+    uint64_t newFlows;
+    uint64_t recovered;
+    uint64_t rerouted;
+    uint64_t expired;
+    uint64_t untracked;
+    uint64_t rehashes;
+
+    uint64_t hashFlow(const FlowTuple& flow) const;
+    static bool matches(const ConnectionEntry& entry, const FlowTuple& flow);
+    bool isIdle(const ConnectionEntry& entry, uint32_t now) const;
+    bool isLive(int backendId) const;
+    size_t homeGroup(uint64_t hash) const;
+
+    // Bit i set when slot i of the group has control byte `value`
+    uint32_t matchGroup(size_t group, uint8_t value) const;
+    size_t find(const FlowTuple& flow, uint64_t hash) const;   // slot index or npos
+    bool insert(const FlowTuple& flow, uint64_t hash, int backendId, uint32_t now);
+    void eraseSlot(size_t slot);
+    void sweepGroup(uint32_t now);
+    void rehash();               // drops tombstones without extra memory
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    ConnectionTable(size_t maxFlows, uint32_t idleTimeoutSeconds, const KeyHasher& hasher = KeyHasher());
+
+    // Membership for new and unknown flows, weighted (e.g. by capacity).
+    // Tracked flows keep their backend while it stays in the set.
+    void setBackends(const std::vector<int>& backendIds, const std::vector<double>& weights);
+
+    // Backend for a packet; connectionStart marks a SYN (or first datagram)
+    int route(const FlowTuple& flow, bool connectionStart, uint32_t now);
+    void close(const FlowTuple& flow);   // FIN/RST seen
+    void clear();                        // forgets every flow, as a restart would
+
+    ConnectionTableStats getStats() const;
+    size_t size() const;
+    size_t memoryBytes() const;
+
+    // Inserts flows, measures hit lookups, then checks which flows keep their
+    // backend when the last backend leaves and when the table starts empty.
+    // Finally churns a full table to show the cost of a miss stays flat.
+    static ConnectionBenchmarkReport benchmark(const std::vector<int>& backendIds, const std::vector<double>& weights,
+                                               int flows, int lookups, const KeyHasher& hasher = KeyHasher());
+    static std::string formatReport(const ConnectionBenchmarkReport& report);
+};
+
+#endif // CONNECTION_TABLE_H
@@ -0,0 +1,63 @@
+// failure_analysis.h
+#ifndef FAILURE_ANALYSIS_H
+#define FAILURE_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include "load_balancer.h"
+#include "fleet_snapshot.h"
+
+enum class FailureDomain {
+    SERVER,
+    ZONE
+};
+
+struct FailureScenario {
+    FailureDomain domain;
+    std::vector<int> failed;     // server ids or zone ids
+    int orphanedLoad;            // load the failed servers were carrying
+};
+
+struct ScenarioOutcome {
+    int unplacedLoad;            // orphaned load the survivors could not take
+    int overloadedServers;       // survivors pushed past their capacity
+    double peakUtilization;      // highest survivor load as a percentage of capacity
+
+    bool overflows() const { return unplacedLoad > 0 || overloadedServers > 0; }
+};
+
+struct BlastRadiusReport {
+    std::vector<BalancingAlgorithm> algorithms;
+    std::vector<FailureScenario> scenarios;
+    std::vector<std::vector<ScenarioOutcome>> outcomes;   // [algorithm][scenario]
+    std::vector<int> overflowCounts;                      // per algorithm
+    double elapsedMs;
+};
+
+// N-k analysis: for every loss of up to maxFailures servers (and, when servers
+// carry zones, every loss of up to maxFailures zones) the failed servers' load is
+// re-placed on the survivors with each algorithm, and the scenarios where the
+// survivors overflow are reported. Scenarios are independent and evaluated on
+// worker threads, each against its own fork of the snapshot.
+class FailureAnalyzer {
+private:
+    int maxFailures;
+    bool includeZones;
+    unsigned threads;
+
+    std::vector<FailureScenario> enumerateScenarios(const FleetSnapshot& fleet) const;
+    ScenarioOutcome evaluate(const FleetSnapshot& fleet, const FailureScenario& scenario,
+                             BalancingAlgorithm algorithm) const;
+
+public:
+    // threads = 0 uses one per hardware thread
+    explicit FailureAnalyzer(int maxFailures = 2, bool includeZones = true, unsigned threads = 0);
+
+    // COST_OPTIMIZED depends on the balancer's cost index and is skipped
+    BlastRadiusReport analyze(const FleetSnapshot& fleet, const std::vector<BalancingAlgorithm>& algorithms) const;
+
+    static std::string describe(const FailureScenario& scenario);
+    static std::string formatReport(const BlastRadiusReport& report, size_t maxListed = 5);
+};
+
+#endif // FAILURE_ANALYSIS_H
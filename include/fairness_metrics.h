@@ -0,0 +1,56 @@
+// fairness_metrics.h
+#ifndef FAIRNESS_METRICS_H
+#define FAIRNESS_METRICS_H
+
+#include <string>
+#include <unordered_map>
+#include "order_statistics_tree.h"
+
+struct FairnessSnapshot {
+    int servers;                 // online servers with effective capacity
+    double jainIndex;            // 1 when every server is equally utilized, 1/n when one carries everything
+    double maxMeanRatio;         // hottest server's utilization over the mean
+    double gini;                 // 0 for perfect balance, towards 1 as load concentrates
+    double weightedVariance;     // utilization variance weighted by effective capacity (%^2)
+};
+
+// Balance metrics over the effective utilization of each online server, i.e.
+// load / (capacity * performanceMultiplier) as a percentage. Every per-server
+// change is O(log n): the plain and capacity-weighted moments are running sums,
+// and the Gini coefficient keeps sum(rank * utilization) over the sorted order
+// up to date through an order-statistics tree. Reading a snapshot is O(log n).
+class FairnessTracker {
+private:
+    struct Entry {
+        double utilization;
+        double weight;           // effective capacity
+        bool tracked;            // counted in the metrics (online, nonzero capacity)
+    };
+
+    std::unordered_map<int, Entry> entries;
+    OrderStatisticsTree sorted;
+
+    double sum;
+    double sumSquares;
+    double weightTotal;
+    double weightedSum;
+    double weightedSquares;
+    double rankWeightedSum;      // sum over sorted order of (1-based rank) * utilization
+    int updatesSinceResync;
+
+    void track(int serverId, const Entry& entry);
+    void untrack(int serverId, const Entry& entry);
+    void resync();
+
+public:
+    FairnessTracker();
+
+    void update(int serverId, int load, int capacity, double performanceMultiplier, bool online);
+    void remove(int serverId);
+    void clear();
+
+    FairnessSnapshot snapshot() const;
+    static std::string format(const FairnessSnapshot& snapshot);
+};
+
+#endif // FAIRNESS_METRICS_H
@@ -0,0 +1,65 @@
+// fleet_snapshot.h
+#ifndef FLEET_SNAPSHOT_H
+#define FLEET_SNAPSHOT_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Server state for a fixed-size run of slots
+struct FleetChunk {
+    static const size_t kSlots = 64;
+
+    int ids[kSlots];
+    int capacities[kSlots];
+    int loads[kSlots];
+    double multipliers[kSlots];
+    char online[kSlots];
+    int zones[kSlots];
+};
+
+// Point-in-time fleet state with copy-on-write sharing. Slots live in refcounted
+// chunks reached through a refcounted chunk table, so fork() copies one pointer
+// and a mutation clones the table (if shared) plus the one chunk it touches (if
+// shared). Forks never observe each other's writes. A single snapshot must not be
+// mutated from several threads, but forks of it may be mutated concurrently.
+//
+// Also a placement engine Fleet, so algorithms can run directly on a fork.
+class FleetSnapshot {
+private:
+    typedef std::vector<std::shared_ptr<FleetChunk>> ChunkTable;
+
+    std::shared_ptr<ChunkTable> table;
+    size_t count;
+
+    const FleetChunk& chunk(size_t i) const { return *(*table)[i / FleetChunk::kSlots]; }
+    FleetChunk& mutableChunk(size_t i);
+
+public:
+    FleetSnapshot();
+
+    FleetSnapshot fork() const { return *this; }
+    void add(int id, int capacity, int load, double multiplier, bool isOnline, int zone);
+
+    size_t size() const { return count; }
+    size_t chunkCount() const { return table->size(); }
+    // Chunks this snapshot shares with at least one fork
+    size_t sharedChunkCount() const;
+
+    int getId(size_t i) const { return chunk(i).ids[i % FleetChunk::kSlots]; }
+    int getCapacity(size_t i) const { return chunk(i).capacities[i % FleetChunk::kSlots]; }
+    int getCurrentLoad(size_t i) const { return chunk(i).loads[i % FleetChunk::kSlots]; }
+    double getPerformanceMultiplier(size_t i) const { return chunk(i).multipliers[i % FleetChunk::kSlots]; }
+    bool isOnline(size_t i) const { return chunk(i).online[i % FleetChunk::kSlots] != 0; }
+    int getZone(size_t i) const { return chunk(i).zones[i % FleetChunk::kSlots]; }
+
+    int getAvailableCapacity(size_t i) const;
+    double getEffectiveCapacity(size_t i) const;
+
+    void setCurrentLoad(size_t i, int load);
+    void setOnline(size_t i, bool isOnline);
+    void setPerformanceMultiplier(size_t i, double multiplier);
+    void clearLoads();
+};
+
+#endif // FLEET_SNAPSHOT_H
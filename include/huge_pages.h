@@ -0,0 +1,160 @@
+// huge_pages.h
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+
+const size_t kHugePageSize = 2 * 1024 * 1024;
+
+enum class HugePageBacking {
+    HUGETLBFS,      // reserved pages via MAP_HUGETLB
+    TRANSPARENT,    // 2MB-aligned mapping with MADV_HUGEPAGE
+    NORMAL          // regular pages
+};
+
+// Random server lookups by id over a server table on regular pages, then on a
+// huge-page arena
+struct TlbBenchmarkReport {
+    int servers;
+    int lookups;
+    bool countersAvailable;          // perf_event_open allowed; misses are 0 otherwise
+    HugePageBacking arenaBacking;    // what the arena's regions actually got
+    double normalNsPerLookup;
+    double hugeNsPerLookup;
+    uint64_t normalTlbMisses;
+    uint64_t hugeTlbMisses;
+};
+
+namespace hugepages {
+
+// Tries MAP_HUGETLB first, then a 2MB-aligned mapping advised for THP.
+// Sizes are rounded up to whole huge pages.
+void* allocate(size_t bytes, HugePageBacking* backing = nullptr);
+void release(void* memory, size_t bytes);
+size_t roundUp(size_t bytes);
+
+// Process-wide switch, off until enabled, and cumulative bytes mapped per backing
+void setEnabled(bool enabled);
+bool isEnabled();
+size_t bytesMapped(HugePageBacking backing);
+
+std::string formatReport(const TlbBenchmarkReport& report);
+
+} // namespace hugepages
+
+// STL allocator: blocks of at least half a huge page come from huge-page mappings
+// while backing is enabled; smaller ones use operator new.
+template <typename T>
+class HugePageAllocator {
+public:
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (usesHugePages(bytes)) {
+            void* memory = hugepages::allocate(bytes);
+            if (!memory) throw std::bad_alloc();
+            return static_cast<T*>(memory);
+        }
+        return static_cast<T*>(::operator new(bytes));
+    }
+
+    void deallocate(T* memory, size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (usesHugePages(bytes)) {
+            hugepages::release(memory, bytes);
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    // Decided by size alone so deallocate always agrees with allocate, even if
+    // backing is switched off in between
+    static bool usesHugePages(size_t bytes) {
+        return bytes >= kHugePageSize / 2;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+// Arena carving small objects (servers, table nodes) out of huge-page regions so
+// scans over them touch few TLB entries. Freed blocks go to per-size free lists.
+class HugePageArena {
+private:
+    std::mutex mutex;
+    std::vector<std::pair<char*, size_t>> regions;
+    char* cursor;
+    size_t remaining;
+    std::map<size_t, std::vector<void*>> freeLists;
+
+public:
+    HugePageArena();
+    ~HugePageArena();
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    void* allocate(size_t bytes);
+    void deallocate(void* memory, size_t bytes);
+    size_t regionCount() const;
+};
+
+// Allocator over a shared arena, for std::allocate_shared
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    std::shared_ptr<HugePageArena> arena;
+
+    explicit ArenaAllocator(std::shared_ptr<HugePageArena> arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* memory, size_t n) {
+        arena->deallocate(memory, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+// dTLB read misses of the calling thread via perf_event_open, for comparing runs
+// with and without huge-page backing. available() is false where perf is restricted.
+class TlbMissCounter {
+private:
+    int fd;
+
+public:
+    TlbMissCounter();
+    ~TlbMissCounter();
+
+    TlbMissCounter(const TlbMissCounter&) = delete;
+    TlbMissCounter& operator=(const TlbMissCounter&) = delete;
+
+    bool available() const;
+    void start();
+    uint64_t stop();
+};
+
+#endif // HUGE_PAGES_H
@@ -9,16 +9,78 @@
 #include <map>
 #include <chrono>
 #include <random>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include "key_hasher.h"
+#include "fairness_metrics.h"
+#include "utilization_index.h"
 
 // Forward declarations for optional modules
 class LoadMonitor;
 class ServerHealthSimulator;
 class LoadPatternGenerator;
+class DeterministicSubsetter;
+class RequestTracer;
+class TraceEventWriter;
+class HugePageArena;
+struct TlbBenchmarkReport;
+struct NumaBenchmarkReport;
+class TenantQuotaManager;
+class ShuffleSharder;
+class FleetSnapshot;
+class OperationJournal;
+class JournalReplayer;
+class TlsTerminator;
+struct TlsBenchmarkReport;
+class ConnectionTable;
+struct ConnectionBenchmarkReport;
+struct FlowTuple;
+class ConnectionPoolManager;
+struct ConnectionPoolStats;
+struct PooledConnection;
+struct UpstreamBenchmarkReport;
+struct BlastRadiusReport;
+struct RequestSpan;
 
 enum class BalancingAlgorithm {
     ROUND_ROBIN,
     LEAST_LOADED,
-    WEIGHTED_OPTIMIZATION
+    WEIGHTED_OPTIMIZATION,
+    COST_OPTIMIZED
+};
+
+const int kBalancingAlgorithmCount = static_cast<int>(BalancingAlgorithm::COST_OPTIMIZED) + 1;
+
+// What COST_OPTIMIZED minimizes
+enum class CostObjective {
+    PRICE,      // cheapest cost per load unit first
+    ENERGY      // fewest watts: pack active servers and let the rest idle
+};
+
+// Quiet construction of a large fleet with lazy modules, then its first placement
+struct StartupBenchmarkReport {
+    int servers;
+    BalancingAlgorithm algorithm;
+    double constructMs;
+    double firstPickUs;
+    int chosenServer;           // -1 if the first pick found no room
+    int modulesConstructed;     // lazy modules built before the first pick; should be 0
+};
+
+class Server;
+
+// Told about every change to a server's placement state (only actual changes)
+class ServerObserver {
+public:
+    virtual ~ServerObserver() {}
+    virtual void onLoadChanged(const Server& server, int oldLoad) = 0;
+    virtual void onCapacityChanged(const Server& server, int oldCapacity) = 0;
+    virtual void onPerformanceChanged(const Server& server, double oldMultiplier) = 0;
+    virtual void onOnlineChanged(const Server& server) = 0;
+    virtual void onStatusChanged(const Server& server, const std::string& oldStatus) = 0;
 };
 
 class Server {
@@ -29,6 +91,14 @@ private:
     double performanceMultiplier;
     bool online;
     std::string status;
+    
+    // Cost and power model
+    double costPerUnit;         // price per load unit per hour
+    double idlePowerWatts;      // draw when online with any load
+    double peakPowerWatts;      // draw at full capacity
+    int zone;                   // failure domain, 0 unless assigned
+    
+    ServerObserver* observer;
 
 public:
     Server(int id, int capacity);
@@ -47,6 +117,18 @@ public:
     void setPerformanceMultiplier(double multiplier);
     void setOnline(bool online);
     void setStatus(const std::string& status);
+    void setCostModel(double costPerUnit, double idlePowerWatts, double peakPowerWatts);
+    void setZone(int zone);
+    int getZone() const;
+    void setObserver(ServerObserver* observer);
+    
+    // Cost and power
+    double getCostPerUnit() const;
+    double getIdlePowerWatts() const;
+    double getPeakPowerWatts() const;
+    double getHourlyCost() const;
+    double getPowerDraw() const;
+    double getMarginalPowerPerUnit() const;
     
     // Operations
     int getAvailableCapacity() const;
@@ -54,36 +136,183 @@ public:
     double getLoadPercentage() const;
 };
 
-class LoadBalancer {
+class LoadBalancer : private ServerObserver {
 private:
     std::vector<std::shared_ptr<Server>> servers;
     BalancingAlgorithm currentAlgorithm;
     int nextServerId;
     int randomLoadAmount;
     std::mt19937 rng;
+    KeyHasher keyHasher;    // seeded per instance for keyed routing
+    std::shared_ptr<HugePageArena> serverArena;   // servers added while huge-page backing is on
+    
+    bool verbose;
     
     // Optional components
     std::shared_ptr<LoadMonitor> monitor;
     std::shared_ptr<ServerHealthSimulator> healthSimulator;
     std::shared_ptr<LoadPatternGenerator> loadGenerator;
     
-    // Algorithm implementations
-    void distributeLoadRoundRobin(int loadAmount);
-    void distributeLoadLeastLoaded(int loadAmount);
-    void distributeLoadWeightedOptimization(int loadAmount);
+    // Factories for optional components created on first use
+    std::function<std::shared_ptr<LoadMonitor>()> monitorFactory;
+    std::function<std::shared_ptr<ServerHealthSimulator>()> healthSimulatorFactory;
+    std::function<std::shared_ptr<LoadPatternGenerator>()> loadGeneratorFactory;
+    
+    // Deterministic subsetting: algorithms only place load on subsetServers
+    std::shared_ptr<DeterministicSubsetter> subsetter;
+    std::vector<int> subsetIds;
+    std::vector<std::shared_ptr<Server>> subsetServers;
+    const std::vector<std::shared_ptr<Server>>& getPlacementServers() const;
+    void refreshSubset(bool fullRecompute);
+    
+    // Sampled request tracing
+    std::shared_ptr<RequestTracer> tracer;
+    void beginTrace(RequestSpan& span, int loadAmount, std::vector<int>& loadsBefore) const;
+    void finishTrace(RequestSpan& span, const std::vector<int>& loadsBefore) const;
+    
+    // Timeline export: rebalances, health transitions, scaling and per-server load counters
+    std::shared_ptr<TraceEventWriter> timeline;
+    std::map<int, int> timelineLoads;   // last load emitted per server counter track
+    void emitLoadCounters();
+    
+    // Algorithm implementations; each returns the load units actually placed
+    int distributeLoadRoundRobin(int loadAmount);
+    int distributeLoadLeastLoaded(int loadAmount);
+    int distributeLoadWeightedOptimization(int loadAmount);
+    int distributeLoadCostOptimized(int loadAmount);
+    
+    // Multi-tenant admission. The load hook records where each tenant's units land
+    // while its placement runs, so a release takes them off those servers again
+    std::shared_ptr<TenantQuotaManager> tenantQuotas;
+    std::unordered_map<int, std::map<int, int>> tenantPlacements;   // tenant -> server id -> units
+    int placingTenant;   // -1 outside a tenant's placement
+    int getFreePlacementCapacity() const;
+    
+    // Shuffle sharding: a tenant's load is placed only within its shard
+    std::shared_ptr<ShuffleSharder> sharder;
+    std::map<int, std::vector<std::shared_ptr<Server>>> tenantShards;   // cleared on membership change
+    const std::vector<std::shared_ptr<Server>>* placementOverride;      // a tenant's shard while its load is placed
+    const std::vector<std::shared_ptr<Server>>& getTenantShard(int tenantId);
+    std::vector<int> getShardCandidateIds() const;
+    
+    // TLS termination model; sessions resume against its shared cache
+    std::shared_ptr<TlsTerminator> tlsTerminator;
+    
+    // UDP flow placement; forwarder workers call in concurrently
+    std::mutex flowMutex;
+    size_t flowCursor;
+    bool capturingFlow;
+    int flowPlacedServer;
+    
+    // L4 connection tracking; its backends follow the placement pool and are
+    // resynced on the next routed packet after a membership change
+    std::shared_ptr<ConnectionTable> connectionTable;
+    bool connectionBackendsDirty;
+    void syncConnectionBackends();
+    
+    // Backend connection pools for proxy modes; a server whose pool is exhausted
+    // has no capacity for placement until a connection comes back
+    std::shared_ptr<ConnectionPoolManager> connectionPools;
+    bool poolExhausted(int serverId) const;
+    
+    // Cost-aware placement: (marginal cost, server id) for servers with headroom
+    // under the utilization SLO. Server hooks keep each entry current; the index
+    // is rebuilt when membership, cost models or the placement pool change
+    CostObjective costObjective;
+    double utilizationSlo;
+    std::set<std::pair<double, int>> costIndex;
+    std::unordered_map<int, double> costIndexEntries;   // server id -> its key in costIndex
+    const std::vector<std::shared_ptr<Server>>* costIndexPool;
+    bool costIndexDirty;
+    double marginalCost(const Server& server) const;
+    int sloHeadroom(const Server& server) const;
+    void rebuildCostIndex();
+    void updateCostIndex(const Server& server);
+    void eraseCostIndexEntry(int serverId);
     
     // Internal methods
+    std::ostream& console() const;
+    void recordMonitorMetrics(double operationTime);
+    void advanceHealthModels();
+    int placeLoad(int loadAmount);
+    int admissionAllowance() const;
     void rebalanceLoads();
     double calculateLoadVariance() const;
     int getTotalLoad() const;
     int getTotalCapacity() const;
     
+    // Overload handling: load on servers the health simulator takes offline is
+    // re-placed after the tick, and placement never pushes the pool past the
+    // admission ceiling (0 disables it)
+    bool failover;
+    int pendingFailover;
+    double admissionCeiling;
+    
+    // Periodic N-1 check of the current algorithm (0 disables it). Placement only
+    // queues a snapshot; one worker thread analyzes it, and the next placement
+    // reports the outcome. A newer snapshot replaces one still queued.
+    int safetyCheckInterval;
+    int placementsSinceCheck;
+    std::thread safetyThread;
+    std::mutex safetyMutex;
+    std::condition_variable safetyWake;
+    std::unique_ptr<FleetSnapshot> safetyFleet;
+    BalancingAlgorithm safetyAlgorithm;
+    std::unique_ptr<BlastRadiusReport> safetyResult;
+    bool safetyStopping;
+    void runSafetyCheck();
+    void safetyLoop();
+    void reportSafetyCheck();
+    void stopSafetyThread();
+    
+    // Mutation journal; every Server change reaches it through the observer hooks
+    std::shared_ptr<OperationJournal> journal;
+    std::shared_ptr<JournalReplayer> journalReplayer;   // keeps its checkpoints across undo and redo
+    size_t journalFloor;   // undo stops at the fleet recorded on attach
+    void journalServerAttributes(const Server& server);
+    void journalTenantUsage(int tenantId, int oldUsage);
+    
+    // Server creation and the observer hooks every Server change goes through
+    std::shared_ptr<Server> createServer(int id, int capacity);
+    void onLoadChanged(const Server& server, int oldLoad) override;
+    void onCapacityChanged(const Server& server, int oldCapacity) override;
+    void onPerformanceChanged(const Server& server, double oldMultiplier) override;
+    void onOnlineChanged(const Server& server) override;
+    void onStatusChanged(const Server& server, const std::string& oldStatus) override;
+    
+    // Balance metrics, the utilization order and fleet totals, kept current by the
+    // same observer hooks so status views never walk the whole fleet
+    FairnessTracker fairness;
+    UtilizationIndex utilizationIndex;
+    std::unordered_map<int, std::shared_ptr<Server>> serversById;
+    int fleetLoad;           // all servers
+    int fleetCapacity;       // online servers
+    int degradedServers;     // online servers whose health status is not HEALTHY
+    void indexServer(const Server& server);
+    void unindexServer(const Server& server);
+    std::shared_ptr<Server> findServer(int serverId) const;
+    void drawFleetSummary(std::ostream& ss) const;
+    
+    // Online capacity, online load and free capacity of the fleet and of the subset,
+    // so admission and quota checks never walk the placement pool
+    struct PoolTotals {
+        int capacity = 0;
+        int load = 0;
+        int free = 0;
+    };
+    std::unordered_map<int, PoolTotals> serverShares;
+    PoolTotals fleetTotals;
+    PoolTotals subsetTotals;
+    void updatePoolTotals(const Server& server);
+    void erasePoolTotals(int serverId);
+    PoolTotals getPlacementTotals() const;
+    
     // Timing
     std::chrono::time_point<std::chrono::system_clock> lastOperationTime;
     double measureOperationTime();
     
 public:
-    LoadBalancer();
+    explicit LoadBalancer(int initialServers = 3, int serverCapacity = 100, bool verbose = true);
     ~LoadBalancer();
     
     // Server management
@@ -95,16 +324,113 @@ public:
     // Load operations
     void addRandomLoad();
     void addLoadToServer(int serverId, int loadAmount);
-    void addSystemLoad(int loadAmount);
+    int addSystemLoad(int loadAmount);
+    int addTenantLoad(int tenantId, int loadAmount);
+    
+    // Tenant quotas
+    void setTenantQuota(int tenantId, int reservation, int limit);
+    void releaseTenantLoad(int tenantId, int loadAmount);
+    std::shared_ptr<const TenantQuotaManager> getTenantQuotas() const;
+    
+    // Shuffle sharding
+    void enableShuffleSharding(int shardSize);
+    void disableShuffleSharding();
+    std::vector<int> getTenantShardIds(int tenantId);
+    std::string getShardIsolationReport(int poisonedTenant, const std::vector<int>& tenantIds) const;
+    
+    // TLS termination
+    void enableTlsTermination(size_t cacheShards = 16, size_t cacheCapacity = 65536);
+    void disableTlsTermination();
+    std::shared_ptr<TlsTerminator> getTlsTerminator() const;
+    // Runs with tickets on or off for the run, whatever the terminator's setting
+    TlsBenchmarkReport benchmarkTls(int clients, int connectionsPerClient, bool tickets, unsigned threads = 0);
+    
+    // UDP flows: one load unit per flow, placed with the current algorithm
+    int assignFlow();
+    void releaseFlow(int serverId);
+    
+    // L4 connection tracking (direct server return)
+    void enableConnectionTracking(size_t maxFlows = 1 << 20, uint32_t idleTimeoutSeconds = 300);
+    void disableConnectionTracking();
+    std::shared_ptr<ConnectionTable> getConnectionTable() const;
+    int routeConnection(const FlowTuple& flow, bool connectionStart, uint32_t now);
+    ConnectionBenchmarkReport benchmarkConnectionTable(int flows, int lookups);
+    
+    // Backend connection pools (proxy mode): a request takes one load unit and
+    // one stream on a pooled connection to the server it was placed on, so a
+    // server's load counts its concurrent streams whether or not they share a
+    // connection (maxStreamsPerConnection 1 is HTTP/1.1)
+    void enableConnectionPools(int minIdle = 4, int maxSize = 64, double maxLifetimeSeconds = 300.0,
+                               int maxStreamsPerConnection = 1);
+    void disableConnectionPools();
+    std::shared_ptr<ConnectionPoolManager> getConnectionPools() const;
+    bool proxyRequest(PooledConnection& connection);
+    void finishRequest(const PooledConnection& connection, bool broken = false);
+    ConnectionPoolStats benchmarkConnectionPools(unsigned threads, int requestsPerThread);
+    // Runs on an idle copy of the placement pool with pools of its own, so live
+    // loads, pools and the journal are untouched
+    UpstreamBenchmarkReport benchmarkUpstream(int maxStreamsPerConnection, int clients, int requestsPerClient,
+                                              double serviceUs = 200.0, int poolSize = 8);
     
     // Algorithm selection
     void setBalancingAlgorithm(BalancingAlgorithm algorithm);
     BalancingAlgorithm getCurrentAlgorithm() const;
     std::string getAlgorithmName() const;
+    static std::string algorithmName(BalancingAlgorithm algorithm);
     
     // Configuration
     void setRandomLoadAmount(int amount);
     int getRandomLoadAmount() const;
+    void setHashSeed(uint64_t seed);
+    
+    // Process-wide: applies to every balancer's servers added afterwards and to the
+    // journals, tracer rings, connection tables and metrics history they allocate
+    static void setHugePageBacking(bool enabled);
+    static bool isHugePageBackingEnabled();
+    
+    // Memory placement benchmarks
+    TlbBenchmarkReport benchmarkHugePages(int serverCount, int lookups);
+    NumaBenchmarkReport benchmarkNumaReplicas(int serverCount, int lookupsPerThread);
+    
+    // Overload handling
+    void setFailover(bool enabled);
+    void setAdmissionCeiling(double utilizationPercent);
+    
+    // Operation journal and replay
+    void attachJournal(std::shared_ptr<OperationJournal> journalObj);
+    std::shared_ptr<OperationJournal> getJournal() const;
+    void rewindTo(size_t position);
+    bool undo();
+    bool redo();
+    
+    // Failure analysis
+    void setServerZone(int serverId, int zone);
+    FleetSnapshot snapshotFleet() const;
+    void restoreFleet(const FleetSnapshot& fleet);   // loads, health and multipliers, matched by server id
+    BlastRadiusReport analyzeFailures(int maxFailures = 2) const;
+    void setCapacitySafetyCheck(int everyPlacements);
+    
+    // Cost-aware placement
+    void setCostObjective(CostObjective objective);
+    CostObjective getCostObjective() const;
+    void setUtilizationSlo(double percentage);
+    void setServerCostModel(int serverId, double costPerUnit, double idlePowerWatts, double peakPowerWatts);
+    double getHourlyCost() const;
+    double getPowerDraw() const;
+    FairnessSnapshot getFairnessMetrics() const;
+    
+    // Utilization order queries, O(log n) each; ranks count from the most loaded server
+    double getUtilizationPercentile(double p) const;
+    int getUtilizationRank(int serverId) const;
+    int getKthMostLoadedServer(int k) const;
+    std::vector<int> getMostLoadedServers(int n) const;
+    const KeyHasher& getKeyHasher() const;
+    
+    // Subsetting
+    void enableSubsetting(int clientId, int subsetSize);
+    void disableSubsetting();
+    bool isSubsettingEnabled() const;
+    const std::vector<int>& getSubsetServerIds() const;
     
     // Visualization
     std::string visualizeLoads() const;
@@ -114,6 +440,23 @@ public:
     void attachMonitor(std::shared_ptr<LoadMonitor> monitor);
     void attachHealthSimulator(std::shared_ptr<ServerHealthSimulator> healthSimulator);
     void attachLoadGenerator(std::shared_ptr<LoadPatternGenerator> loadGenerator);
+    void attachTracer(std::shared_ptr<RequestTracer> tracer);
+    void attachTimeline(std::shared_ptr<TraceEventWriter> timeline);
+    
+    // Lazy variants: nothing is constructed or opened until the module is first used
+    void setMonitorFactory(std::function<std::shared_ptr<LoadMonitor>()> factory);
+    void setHealthSimulatorFactory(std::function<std::shared_ptr<ServerHealthSimulator>()> factory);
+    void setLoadGeneratorFactory(std::function<std::shared_ptr<LoadPatternGenerator>()> factory);
+    std::shared_ptr<LoadMonitor> getMonitor();
+    std::shared_ptr<ServerHealthSimulator> getHealthSimulator();
+    std::shared_ptr<LoadPatternGenerator> getLoadGenerator();
+    
+    // Startup latency on a fresh, quiet balancer; the live one is untouched
+    static StartupBenchmarkReport benchmarkStartup(int serverCount, int serverCapacity,
+                                                   BalancingAlgorithm algorithm);
+    static std::string formatStartupReport(const StartupBenchmarkReport& report);
+    
+    void setVerbose(bool verbose);
     
     // Interactive command processing
     bool processCommand(char command);
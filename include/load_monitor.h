@@ -6,10 +6,15 @@
 #include <fstream>
 #include <chrono>
 #include <cmath>
+#include <map>
+#include <cstdint>
+#include "huge_pages.h"
 
 class LoadMonitor {
 private:
     std::ofstream logFile;
+    std::string logFilePath;
+    bool logOpenAttempted;   // the log is opened on the first write, not in the constructor
     std::chrono::time_point<std::chrono::system_clock> startTime;
     std::string currentAlgorithm;
     
@@ -21,20 +26,64 @@ private:
         double responseTime;
         int serverCount;
         std::string algorithm;
+        double costPerHour;
+        double powerWatts;
+        double peakTemperature;
+        int throttledServers;
+        int offlineServers;
+        double jainIndex;
+        double maxMeanRatio;
+        double gini;
+        double weightedVariance;
     };
     
-    std::vector<MetricsSnapshot> metrics;
+    std::vector<MetricsSnapshot, HugePageAllocator<MetricsSnapshot>> metrics;
+    
+    // Latest utilization per tenant
+    struct TenantSnapshot {
+        int usage;
+        int reservation;
+        int limit;
+        int rejected;
+    };
+    
+    std::map<int, TenantSnapshot> tenantMetrics;
+    
+    // Load that failover could not re-place, per algorithm
+    std::map<std::string, int> failoverShed;
+    
+    // Latest backend connection pool state, cumulative since the pools were enabled
+    struct PoolSnapshot {
+        double reuseRatio;
+        double meanCheckoutUs;
+        double maxCheckoutUs;
+        double streamsPerConnection;
+        int exhaustedPools;
+        uint64_t refused;
+    };
+    
+    bool poolsRecorded;
+    PoolSnapshot poolMetrics;
+    
+    bool ensureLogOpen();
     
 public:
     LoadMonitor(const std::string& logFilePath = "load_balancer_metrics.log");
     ~LoadMonitor();
     
     // Core monitoring methods
-    void recordMetrics(const std::vector<int>& serverLoads, double responseTime);
+    void recordMetrics(const std::vector<int>& serverLoads, double responseTime,
+                       double costPerHour = 0.0, double powerWatts = 0.0);
     void setAlgorithm(const std::string& algorithm);
     void logServerAddition();
     void logServerRemoval();
     void logRebalancing();
+    void recordHealthState(double peakTemperature, int throttledServers, int offlineServers);   // attaches to the latest sample
+    void logFailover(int moved, int shed);
+    void recordFairness(double jainIndex, double maxMeanRatio, double gini, double weightedVariance);   // attaches to the latest sample
+    void recordTenantUtilization(int tenantId, int usage, int reservation, int limit, int rejected);
+    void recordConnectionPools(double reuseRatio, double meanCheckoutUs, double maxCheckoutUs,
+                               double streamsPerConnection, int exhaustedPools, uint64_t refused);
     
     // Analysis methods
     double calculateLoadVariance(const std::vector<int>& serverLoads);
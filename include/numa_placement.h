@@ -0,0 +1,108 @@
+// numa_placement.h
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+// NUMA topology as reported by /sys/devices/system/node. Machines without NUMA
+// information are treated as a single node holding every online CPU.
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> nodeCpus;
+    std::vector<int> cpuNodes;
+
+public:
+    static NumaTopology detect();
+
+    int nodeCount() const;
+    const std::vector<int>& cpusOfNode(int node) const;
+    int nodeOfCpu(int cpu) const;
+    int currentNode() const;
+};
+
+// Random reads of a replicated server table by threads pinned to each node, once
+// from their own node's replica and once from the next node's
+struct NumaBenchmarkReport {
+    int nodes;
+    int servers;
+    int threadsPerNode;
+    int lookupsPerThread;
+    bool pinned;                     // every worker thread accepted its node affinity
+    bool placed;                     // every replica landed on its own node
+    double localLookupsPerSecond;
+    double crossLookupsPerSecond;    // 0 unless there are several nodes and both flags hold
+};
+
+namespace numa {
+
+// Anonymous mapping bound to a node with mbind(). When the kernel refuses the
+// policy the pages are first-touched by a thread pinned to the node instead.
+// placed reports whether either way put the pages on the node.
+void* allocateOnNode(const NumaTopology& topology, size_t bytes, int node, bool* placed = nullptr);
+void freeOnNode(void* memory, size_t bytes);
+
+void firstTouch(void* memory, size_t bytes);
+bool pinCurrentThreadToNode(const NumaTopology& topology, int node);
+
+std::string formatReport(const NumaBenchmarkReport& report);
+
+} // namespace numa
+
+// One copy of a trivially copyable table per NUMA node, each allocated on its node,
+// so worker threads pinned to a node read the server table without crossing sockets.
+// Writers update every replica through publish().
+template <typename T>
+class NodeReplicatedTable {
+private:
+    const NumaTopology* topology;
+    std::vector<T*> replicas;
+    size_t count;
+    bool placed;
+
+    void release() {
+        for (T* replica : replicas) {
+            numa::freeOnNode(replica, count * sizeof(T));
+        }
+        replicas.clear();
+    }
+
+public:
+    NodeReplicatedTable(const NumaTopology& topology, size_t count)
+        : topology(&topology), count(count), placed(true) {
+        for (int node = 0; node < topology.nodeCount(); node++) {
+            bool onNode = false;
+            void* memory = numa::allocateOnNode(topology, count * sizeof(T), node, &onNode);
+            if (!memory) {
+                release();
+                throw std::bad_alloc();
+            }
+            replicas.push_back(static_cast<T*>(memory));
+            placed = placed && onNode;
+        }
+    }
+
+    ~NodeReplicatedTable() {
+        release();
+    }
+
+    NodeReplicatedTable(const NodeReplicatedTable&) = delete;
+    NodeReplicatedTable& operator=(const NodeReplicatedTable&) = delete;
+
+    size_t size() const { return count; }
+    bool isPlaced() const { return placed; }   // every replica is on its own node
+
+    const T* replica(int node) const { return replicas[node]; }
+    const T* local() const { return replicas[topology->currentNode()]; }
+
+    void publish(const T* source) {
+        for (T* replica : replicas) {
+            std::memcpy(replica, source, count * sizeof(T));
+        }
+    }
+};
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,150 @@
+// operation_journal.h
+#ifndef OPERATION_JOURNAL_H
+#define OPERATION_JOURNAL_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "huge_pages.h"
+#include "load_balancer.h"
+
+enum class JournalOp : uint8_t {
+    ADD_SERVER,       // after = capacity
+    REMOVE_SERVER,    // before = capacity
+    SET_LOAD,
+    SET_ONLINE,
+    SET_MULTIPLIER,   // fixed point, see encodeMultiplier
+    SET_CAPACITY,
+    SET_ALGORITHM,    // server id unused
+    PLACEMENT,        // marks a placement request; after = requested load (negative for a tenant release),
+                      // server id set for direct placements
+    SET_STATUS,       // see encodeStatus
+    SET_ZONE,
+    SET_COST,         // cost per unit, fixed point as encodeMultiplier
+    SET_IDLE_POWER,   // milliwatts, see encodeWatts
+    SET_PEAK_POWER,
+    SET_TENANT_USAGE, // server id holds the tenant id
+    HEALTH            // marks a health transition; before/after as encodeStatus
+};
+
+// 16 bytes; the journal file is a header followed by these records verbatim
+struct JournalRecord {
+    uint8_t op;
+    uint8_t reserved[3];
+    int32_t serverId;
+    int32_t before;
+    int32_t after;
+};
+
+// Append-only binary log of every balancer state mutation. Records are plain
+// structs appended to a pre-reserved, huge-page backed buffer, so an append is a
+// bounds check and a 16-byte store. The journal also keeps an undo cursor: undone
+// records stay available for redo until something new is appended.
+class OperationJournal {
+private:
+    std::vector<JournalRecord, HugePageAllocator<JournalRecord>> records;
+    size_t cursor;   // records before the cursor are in effect
+    uint64_t generation;   // bumped whenever a redo tail is discarded
+
+public:
+    explicit OperationJournal(size_t expectedRecords = 1 << 16);
+
+    void append(JournalOp op, int serverId, int32_t before, int32_t after) {
+        if (cursor != records.size()) {
+            records.resize(cursor);   // a new operation discards the redo tail
+            generation++;
+        }
+        JournalRecord record = {static_cast<uint8_t>(op), {0, 0, 0}, serverId, before, after};
+        records.push_back(record);
+        cursor++;
+    }
+
+    size_t size() const { return records.size(); }
+    size_t position() const { return cursor; }
+    uint64_t getGeneration() const { return generation; }
+    const JournalRecord& operator[](size_t index) const { return records[index]; }
+
+    // Operation boundaries: server changes, algorithm switches, placements, health
+    // transitions, and zone or cost model assignments
+    static bool isOperationStart(const JournalRecord& record);
+    size_t previousOperation(size_t position) const;
+    size_t nextOperation(size_t position) const;
+    void setPosition(size_t position);
+
+    static int32_t encodeMultiplier(double multiplier);
+    static double decodeMultiplier(int32_t encoded);
+    static int32_t encodeWatts(double watts);
+    static double decodeWatts(int32_t encoded);
+
+    // Health statuses by ServerState order; anything else is -1
+    static int32_t encodeStatus(const std::string& status);
+    static std::string decodeStatus(int32_t encoded);
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// Defaults match a newly constructed Server
+struct ReplayedServer {
+    int capacity = 0;
+    int load = 0;
+    bool online = true;
+    double multiplier = 1.0;
+    std::string status = "HEALTHY";
+    int zone = 0;
+    double costPerUnit = 1.0;
+    double idlePowerWatts = 100.0;
+    double peakPowerWatts = 200.0;
+};
+
+struct ReplayState {
+    std::map<int, ReplayedServer> servers;
+    std::map<int, int> tenantUsage;
+    BalancingAlgorithm algorithm;
+    size_t position;   // records applied
+
+    int getTotalLoad() const;
+};
+
+// Rebuilds balancer state at any journal position by replaying from the nearest
+// checkpoint. Checkpoints are taken every checkpointInterval records as replay
+// passes them, so repeated queries (e.g. a bisection) stay cheap.
+class JournalReplayer {
+private:
+    const OperationJournal& journal;
+    size_t checkpointInterval;
+    std::vector<ReplayState> checkpoints;   // checkpoints[i] is the state at i * checkpointInterval
+    uint64_t generation;                    // journal generation the checkpoints belong to
+
+public:
+    explicit JournalReplayer(const OperationJournal& journal, size_t checkpointInterval = 4096);
+
+    static void apply(ReplayState& state, const JournalRecord& record);
+    ReplayState stateAt(size_t position);
+
+    // First operation boundary at which predicate holds, assuming it stays true
+    // once it does (e.g. "some server is over capacity"); size() when it never does
+    template <typename Predicate>
+    size_t bisect(Predicate predicate) {
+        std::vector<size_t> boundaries;
+        for (size_t i = 0; i < journal.size(); i++) {
+            if (OperationJournal::isOperationStart(journal[i])) boundaries.push_back(i);
+        }
+        boundaries.push_back(journal.size());
+
+        size_t low = 0;
+        size_t high = boundaries.size();
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (predicate(stateAt(boundaries[mid]))) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+        return low < boundaries.size() ? boundaries[low] : journal.size();
+    }
+};
+
+#endif // OPERATION_JOURNAL_H
@@ -0,0 +1,81 @@
+// order_statistics_tree.h
+#ifndef ORDER_STATISTICS_TREE_H
+#define ORDER_STATISTICS_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+// Balanced search tree (a treap) over (value, id) keys, where every node also
+// carries the count, value sum and squared-value sum of its subtree. Inserts,
+// erases and the prefix queries below are O(log n) expected. Ties on value are
+// ordered by id, so every key is unique and an entry is erased by the exact key
+// it went in with.
+class OrderStatisticsTree {
+private:
+    struct Node {
+        double value;
+        int id;
+        uint32_t priority;
+        int left;
+        int right;
+        int count;       // nodes in this subtree
+        double sum;      // values in this subtree
+        double squares;  // squared values in this subtree
+    };
+
+    // Nodes live in one vector and link by index; erased slots are reused
+    std::vector<Node> nodes;
+    std::vector<int> freeSlots;
+    int root;
+    uint32_t rngState;
+
+    static bool less(double value, int id, const Node& node);     // (value, id) before node
+    static bool before(const Node& node, double value, int id);   // node before (value, id)
+    uint32_t nextPriority();
+    int count(int node) const;
+    double sum(int node) const;
+    double squares(int node) const;
+    void pull(int node);
+    void split(int node, double value, int id, int& left, int& right);
+    int merge(int left, int right);
+    int insertAt(int node, int created);
+    int eraseAt(int node, double value, int id, bool& erased);
+
+public:
+    OrderStatisticsTree();
+
+    void insert(double value, int id);
+    bool erase(double value, int id);
+    void clear();
+
+    int size() const;
+    double total() const;
+    double totalSquares() const;
+    double maxValue() const;     // 0 when empty
+
+    // Entries ordered strictly before (value, id), and the sum of their values
+    int countLess(double value, int id) const;
+    void prefix(double value, int id, int& countBefore, double& sumBefore) const;
+
+    // k-th entry in ascending order (0-based); false when k is out of range
+    bool select(int k, double& value, int& id) const;
+
+    // In-order walk, smallest first: fn(value, id)
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        std::vector<int> stack;
+        int node = root;
+        while (node >= 0 || !stack.empty()) {
+            while (node >= 0) {
+                stack.push_back(node);
+                node = nodes[node].left;
+            }
+            node = stack.back();
+            stack.pop_back();
+            fn(nodes[node].value, nodes[node].id);
+            node = nodes[node].right;
+        }
+    }
+};
+
+#endif // ORDER_STATISTICS_TREE_H
@@ -0,0 +1,222 @@
+// placement_engine.h
+#ifndef PLACEMENT_ENGINE_H
+#define PLACEMENT_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// The stateless placement algorithms, written once over a fleet adapter so the
+// balancer and offline analyses (failure scenarios, what-if plans) place load the
+// same way. A Fleet provides:
+//   size_t size() const
+//   bool isOnline(size_t i) const
+//   int getCurrentLoad(size_t i) const
+//   void setCurrentLoad(size_t i, int load)
+//   int getAvailableCapacity(size_t i) const
+//   double getEffectiveCapacity(size_t i) const
+// Each function returns the load units actually placed and writes its warnings to log.
+namespace placement {
+
+template <typename Fleet>
+int roundRobin(Fleet& fleet, int loadAmount, std::ostream& log) {
+    const size_t count = fleet.size();
+    if (count == 0) {
+        log << "No servers available to distribute load" << std::endl;
+        return 0;
+    }
+
+    // Find the first online server
+    size_t startIdx = 0;
+    while (startIdx < count && !fleet.isOnline(startIdx)) {
+        startIdx++;
+    }
+
+    if (startIdx >= count) {
+        log << "No online servers available" << std::endl;
+        return 0;
+    }
+
+    // Start with a static distribution
+    int baseLoadPerServer = loadAmount / static_cast<int>(count);
+    int remainingLoad = loadAmount % static_cast<int>(count);
+
+    // Distribute base load to all servers
+    int placedLoad = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t idx = (startIdx + i) % count;
+
+        if (fleet.isOnline(idx)) {
+            int serverLoad = baseLoadPerServer;
+
+            // Distribute remaining load units one by one
+            if (remainingLoad > 0) {
+                serverLoad++;
+                remainingLoad--;
+            }
+
+            fleet.setCurrentLoad(idx, fleet.getCurrentLoad(idx) + serverLoad);
+            placedLoad += serverLoad;
+        }
+    }
+
+    return placedLoad;
+}
+
+template <typename Fleet>
+int leastLoaded(Fleet& fleet, int loadAmount, std::ostream& log) {
+    const size_t count = fleet.size();
+    if (count == 0) {
+        log << "No servers available to distribute load" << std::endl;
+        return 0;
+    }
+
+    // Track remaining load to distribute
+    int remainingLoad = loadAmount;
+
+    // Keep distributing while there's load and available capacity
+    while (remainingLoad > 0) {
+        // Find server with the most available capacity
+        size_t best = count;
+        int bestAvailableCapacity = -1;
+
+        for (size_t i = 0; i < count; i++) {
+            if (!fleet.isOnline(i)) continue;
+
+            int availableCapacity = fleet.getAvailableCapacity(i);
+            if (availableCapacity > bestAvailableCapacity) {
+                bestAvailableCapacity = availableCapacity;
+                best = i;
+            }
+        }
+
+        // No more capacity available
+        if (best == count || bestAvailableCapacity <= 0) {
+            log << "Warning: Insufficient capacity. " << remainingLoad
+                << " load units could not be distributed." << std::endl;
+            break;
+        }
+
+        // Determine how much load to add to this server
+        int loadToAdd = std::min(remainingLoad, bestAvailableCapacity);
+        fleet.setCurrentLoad(best, fleet.getCurrentLoad(best) + loadToAdd);
+        remainingLoad -= loadToAdd;
+    }
+
+    return loadAmount - remainingLoad;
+}
+
+template <typename Fleet>
+int weightedOptimization(Fleet& fleet, int loadAmount, std::ostream& log) {
+    const size_t count = fleet.size();
+    if (count == 0) {
+        log << "No servers available to distribute load" << std::endl;
+        return 0;
+    }
+
+    // Calculate total effective capacity
+    double totalEffectiveCapacity = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (fleet.isOnline(i)) {
+            totalEffectiveCapacity += fleet.getEffectiveCapacity(i);
+        }
+    }
+
+    if (totalEffectiveCapacity <= 0.0) {
+        log << "No effective capacity available" << std::endl;
+        return 0;
+    }
+
+    // Calculate ideal load distribution based on capacity ratio
+    std::vector<int> idealLoads(count);
+    int distributedLoad = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!fleet.isOnline(i)) {
+            idealLoads[i] = 0;
+            continue;
+        }
+
+        // Calculate proportional load
+        double ratio = fleet.getEffectiveCapacity(i) / totalEffectiveCapacity;
+        int serverIdealLoad = static_cast<int>(ratio * loadAmount);
+
+        // Ensure we don't exceed capacity
+        int availableCapacity = fleet.getAvailableCapacity(i);
+        if (serverIdealLoad > availableCapacity) {
+            serverIdealLoad = availableCapacity;
+        }
+
+        idealLoads[i] = serverIdealLoad;
+        distributedLoad += serverIdealLoad;
+    }
+
+    // Distribute any remaining load to servers that still have capacity
+    int remainingLoad = loadAmount - distributedLoad;
+    while (remainingLoad > 0) {
+        bool distributed = false;
+
+        for (size_t i = 0; i < count && remainingLoad > 0; i++) {
+            if (!fleet.isOnline(i)) continue;
+
+            int availableCapacity = fleet.getAvailableCapacity(i) - idealLoads[i];
+            if (availableCapacity > 0) {
+                idealLoads[i]++;
+                remainingLoad--;
+                distributed = true;
+            }
+        }
+
+        if (!distributed) break; // No more capacity
+    }
+
+    // Apply the calculated loads
+    for (size_t i = 0; i < count; i++) {
+        if (idealLoads[i] > 0) {
+            fleet.setCurrentLoad(i, fleet.getCurrentLoad(i) + idealLoads[i]);
+        }
+    }
+
+    if (remainingLoad > 0) {
+        log << "Warning: Insufficient capacity. " << remainingLoad
+            << " load units could not be distributed." << std::endl;
+    }
+
+    return loadAmount - remainingLoad;
+}
+
+// Runs fn(first, last) over [0, total) in batches claimed by up to `threads`
+// workers (the caller is one of them), for what-if evaluations that are
+// independent of each other. threads = 0 uses one per hardware thread.
+template <typename Fn>
+void forEachBatch(size_t total, unsigned threads, size_t batch, Fn fn) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    batch = std::max<size_t>(1, batch);
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t first = next.fetch_add(batch);
+            if (first >= total) break;
+            fn(first, std::min(total, first + batch));
+        }
+    };
+
+    unsigned workerCount = static_cast<unsigned>(std::min<size_t>(threads, (total + batch - 1) / batch));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < workerCount; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+} // namespace placement
+
+#endif // PLACEMENT_ENGINE_H
@@ -0,0 +1,85 @@
+// request_tracer.h
+#ifndef REQUEST_TRACER_H
+#define REQUEST_TRACER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "huge_pages.h"
+
+const int kMaxTraceCandidates = 16;
+const int kMaxTracePlacements = 16;
+
+struct TraceCandidate {
+    int serverId;
+    double score;   // algorithm-specific: load %, available capacity or capacity share
+};
+
+struct TracePlacement {
+    int serverId;
+    int amount;
+};
+
+// One sampled placement decision. Fixed size so it can live in a preallocated ring.
+struct RequestSpan {
+    uint64_t requestId;
+    int64_t arrivalNs;      // relative to tracer start
+    int64_t dispatchNs;     // algorithm started; dispatch - arrival is the queue wait
+    int64_t completionNs;
+    int algorithm;
+    int loadAmount;
+    int chosenServerId;     // server that received the largest share, -1 if none
+    int candidateCount;     // candidates considered, may exceed the stored ones
+    int placementCount;
+    int threadIndex;        // filled in by the tracer
+    TraceCandidate candidates[kMaxTraceCandidates];
+    TracePlacement placements[kMaxTracePlacements];
+};
+
+class RequestTracer {
+private:
+    // Single-producer ring owned by one thread. The writer publishes with a release
+    // store of head; readers drop any slot the writer lapped while it was copied.
+    struct SpanRing {
+        std::vector<RequestSpan, HugePageAllocator<RequestSpan>> slots;
+        std::atomic<uint64_t> head;
+        int threadIndex;
+
+        SpanRing(size_t capacity, int threadIndex);
+    };
+
+    uint64_t instanceId;
+    uint64_t sampleThreshold;
+    size_t ringCapacity;
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<uint64_t> nextRequestId;
+
+    mutable std::mutex ringsMutex;   // taken once per thread on registration and on export
+    std::vector<std::unique_ptr<SpanRing>> rings;
+
+    SpanRing* threadRing();
+
+public:
+    RequestTracer(double sampleRate = 0.01, size_t ringCapacity = 4096);
+
+    void setSampleRate(double sampleRate);
+    double getSampleRate() const;
+
+    // Hot path: cheap per-thread PRNG draw against the sampling threshold
+    bool sample() const;
+    uint64_t newRequestId();
+    int64_t nowNs() const;
+
+    void record(const RequestSpan& span);
+    std::vector<RequestSpan> collect() const;
+
+    // Export
+    bool exportBinary(const std::string& path) const;
+    bool exportChromeTrace(const std::string& path) const;
+};
+
+#endif // REQUEST_TRACER_H
@@ -0,0 +1,78 @@
+// sampling_profiler.h
+#ifndef SAMPLING_PROFILER_H
+#define SAMPLING_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+enum class ProfilePhase {
+    OTHER,
+    DISPATCH,
+    HEALTH_UPDATE,
+    METRICS,
+    RENDERING
+};
+
+// Marks the calling thread as being in a phase until the scope ends
+class ProfilePhaseScope {
+private:
+    int previousPhase;
+
+public:
+    explicit ProfilePhaseScope(ProfilePhase phase);
+    ~ProfilePhaseScope();
+
+    ProfilePhaseScope(const ProfilePhaseScope&) = delete;
+    ProfilePhaseScope& operator=(const ProfilePhaseScope&) = delete;
+};
+
+// In-process sampling profiler. An ITIMER_PROF timer delivers SIGPROF at the configured
+// frequency; the handler captures the interrupted stack and phase tag into a preallocated
+// buffer claimed with an atomic index, so it never allocates or locks. The handler that
+// claims the first slot past the buffer disarms the timer, so sampling stops on its own
+// once the configured interval is used up; stop() then only restores the previous
+// handler. Link with -rdynamic for symbol names.
+class SamplingProfiler {
+private:
+    static const int kMaxFrames = 64;
+
+    struct Sample {
+        int phase;
+        int depth;
+        void* frames[kMaxFrames];
+    };
+
+    std::unique_ptr<Sample[]> samples;
+    size_t capacity;
+    std::atomic<size_t> nextSample;
+    std::atomic<size_t> droppedSamples;
+    int frequencyHz;
+    bool running;
+
+    static std::atomic<SamplingProfiler*> activeProfiler;
+    static void handleSignal(int signal);
+    static std::string symbolize(void* address);
+
+    SamplingProfiler();
+
+public:
+    static SamplingProfiler& instance();
+
+    // Sample at frequencyHz for durationSeconds of CPU time
+    bool start(int frequencyHz = 99, double durationSeconds = 10.0);
+    void stop();
+    bool isRunning() const;
+
+    size_t getSampleCount() const;
+    size_t getDroppedSamples() const;
+
+    // One "phase;outer;...;inner count" line per distinct stack, for flamegraph.pl
+    std::vector<std::string> foldedStacks() const;
+    bool writeFoldedStacks(const std::string& path) const;
+
+    static std::string phaseToString(ProfilePhase phase);
+};
+
+#endif // SAMPLING_PROFILER_H
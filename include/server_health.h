@@ -16,6 +16,32 @@ enum class ServerState {
     OFFLINE
 };
 
+// Sustained load heats a server; past throttleStart its performance is scaled down
+// linearly until it reaches minThrottle at throttleMax. Each tick a server gains
+// heatingRate * load fraction degrees and sheds coolingRate of its excess over
+// ambient, so constant load settles at ambient + heatingRate * load / coolingRate.
+struct ThermalParams {
+    double ambient = 25.0;         // degrees C
+    double heatingRate = 10.0;     // degrees per tick at 100% load
+    double coolingRate = 0.15;     // fraction of the excess over ambient shed per tick
+    double throttleStart = 70.0;
+    double throttleMax = 95.0;
+    double minThrottle = 0.4;      // performance multiplier at throttleMax and above
+};
+
+// Overload feedback: servers above threshold utilization build up pressure, and
+// each tick a server steps one health level down with probability equal to its
+// pressure. Pressure bleeds off below the threshold, after which the servers it
+// degraded recover one level at a time with their usual recovery probability. An
+// offline server serves nothing, so its excess decays whatever load it still holds.
+struct OverloadParams {
+    double threshold = 0.85;          // utilization where pressure starts to build
+    double accrualRate = 0.5;         // pressure per tick per unit of excess
+    double relief = 0.1;              // pressure shed per tick below threshold
+    bool queueingCollapse = true;     // measure excess on the queueing delay curve u/(1-u)
+    double gcPauseProbability = 0.0;  // per tick at full excess: a stall that fails health checks outright
+};
+
 class ServerHealthSimulator {
 private:
     std::mt19937 rng;
@@ -30,9 +56,31 @@ private:
         
         // For degraded performance calculation
         double performanceMultiplier;  // 1.0 is normal, lower values mean degraded performance
+        double thermalThrottle;        // applied on top of performanceMultiplier
     };
     
     std::vector<ServerHealth> servers;
+    
+    // Thermal state as structure of arrays, slot i belonging to servers[i], so the
+    // per-tick update is a branch-free loop the compiler can vectorize
+    bool thermalEnabled;
+    ThermalParams thermal;
+    std::vector<double> loadFraction;
+    std::vector<double> temperature;
+    std::vector<double> throttle;
+    
+    // Overload state, same slots as the thermal arrays
+    bool overloadEnabled;
+    OverloadParams overload;
+    std::vector<double> overloadExcess;
+    std::vector<double> overloadPressure;
+    std::vector<double> overloadServing;   // 1.0 unless offline, refreshed each step
+    std::vector<char> overloadDegraded;    // stepped down by overload and not yet healthy again
+    
+    void thermalStep(double dt);
+    void overloadStep(double dt);
+    void applyOverloadTransitions();
+    double effectiveMultiplier(const ServerHealth& server) const;
     std::map<ServerState, std::string> stateLabels;
     
     // Callbacks for state changes
@@ -62,6 +110,25 @@ public:
     void setStateChangeCallback(std::function<void(int, ServerState)> callback);
     void setPerformanceUpdateCallback(std::function<void(int, double)> callback);
     
+    // Thermal model
+    void enableThermalModel(const ThermalParams& params = ThermalParams());
+    void disableThermalModel();
+    bool isThermalModelEnabled() const;
+    
+    // Overload-to-health coupling
+    void enableOverloadModel(const OverloadParams& params = OverloadParams());
+    void disableOverloadModel();
+    bool isOverloadModelEnabled() const;
+    double getServerOverloadPressure(int serverId) const;
+    
+    // Sets each listed server's load fraction (0.0-1.0+) and advances the thermal
+    // and overload models by dt ticks
+    bool isLoadCoupled() const;
+    void updateLoadEffects(const std::vector<std::pair<int, double>>& serverLoads, double dt = 1.0);
+    double getServerTemperature(int serverId) const;
+    double getPeakTemperature() const;
+    int getThrottledServerCount() const;
+    
     // Event simulation
     void simulateRandomFailure();
     void simulateNetworkPartition(const std::vector<int>& affectedServers);
@@ -0,0 +1,39 @@
+// shuffle_sharding.h
+#ifndef SHUFFLE_SHARDING_H
+#define SHUFFLE_SHARDING_H
+
+#include <vector>
+#include <map>
+#include "key_hasher.h"
+
+struct ShardIsolationReport {
+    int poisonedTenant;
+    int shardSize;
+    int tenantCount;                 // tenants compared against the poisoned one
+    int fullyOverlapping;            // tenants whose whole shard is shared with it
+    double meanOverlap;              // servers shared, averaged over tenants
+    std::map<int, int> overlapHistogram;   // shared servers -> tenant count
+};
+
+// Maps each tenant to a pseudo-random shard of k servers by rendezvous hashing:
+// every (tenant, server) pair gets a hash and the tenant's shard is its k highest.
+// Removing a server only changes shards that contained it, and adding one only
+// displaces a member where the new server ranks in the top k.
+class ShuffleSharder {
+private:
+    KeyHasher hasher;
+    int shardSize;
+
+public:
+    ShuffleSharder(const KeyHasher& hasher, int shardSize);
+
+    int getShardSize() const;
+    std::vector<int> shardFor(int tenantId, const std::vector<int>& serverIds) const;
+
+    // Overlap of every tenant's shard with the poisoned tenant's shard, i.e. how many
+    // of its servers a tenant loses if the poisoned tenant takes its shard down
+    ShardIsolationReport analyzeIsolation(int poisonedTenant, const std::vector<int>& tenantIds,
+                                          const std::vector<int>& serverIds) const;
+};
+
+#endif // SHUFFLE_SHARDING_H
@@ -0,0 +1,38 @@
+// subsetting.h
+#ifndef SUBSETTING_H
+#define SUBSETTING_H
+
+#include <vector>
+#include <cstdint>
+
+// Deterministic subsetting: balancer instances (clients) are grouped into rounds of
+// (serverCount / subsetSize) clients. Every round shuffles the sorted server list with
+// a round-specific seed and hands each client of the round a disjoint slice, so every
+// server ends up in the subsets of roughly the same number of clients.
+class DeterministicSubsetter {
+private:
+    int clientId;
+    int subsetSize;
+    uint64_t seed;
+
+    // Shuffled server order for the round this client belongs to
+    std::vector<int> roundOrder(const std::vector<int>& sortedIds, int round) const;
+
+public:
+    DeterministicSubsetter(int clientId, int subsetSize, uint64_t seed = 0x5eed5eed5eedULL);
+
+    int getClientId() const;
+    int getSubsetSize() const;
+
+    // Full computation from scratch
+    std::vector<int> computeSubset(const std::vector<int>& serverIds) const;
+
+    // Membership change: keeps surviving members of the previous subset, swaps up to
+    // a quarter of them (at least one) for servers the fresh computation picks but the
+    // subset lacks, then fills vacancies the same way. Repeated changes converge on the
+    // fresh assignment, so new servers are admitted without reshuffling every client.
+    std::vector<int> updateSubset(const std::vector<int>& previousSubset,
+                                  const std::vector<int>& serverIds) const;
+};
+
+#endif // SUBSETTING_H
@@ -0,0 +1,46 @@
+// tenant_quota.h
+#ifndef TENANT_QUOTA_H
+#define TENANT_QUOTA_H
+
+#include <unordered_map>
+#include <vector>
+
+struct TenantQuota {
+    int reservation;   // capacity held back for this tenant even when others are busy
+    int limit;         // maximum load the tenant may hold, 0 for unlimited
+    int usage;
+    int rejected;      // load refused by admission so far
+};
+
+// Per-tenant admission control for a shared pool. Every check and update is O(1):
+// the manager keeps the unused part of all reservations as a running total, so
+// admitting a tenant never scans the other tenants or the servers.
+class TenantQuotaManager {
+private:
+    std::unordered_map<int, TenantQuota> tenants;
+    long long unusedReservations;
+
+    static int unusedReservation(const TenantQuota& quota);
+    TenantQuota& tenant(int tenantId);
+
+public:
+    TenantQuotaManager();
+
+    void setQuota(int tenantId, int reservation, int limit);
+    void removeTenant(int tenantId);
+
+    // How much of `requested` the tenant may place given the pool's free capacity.
+    // Free capacity is only consulted when some other tenant holds unused reservations.
+    int admit(int tenantId, int requested, int freeCapacity) const;
+    bool needsFreeCapacity(int tenantId) const;
+
+    void commit(int tenantId, int placed, int rejected);
+    void release(int tenantId, int amount);
+    void setUsage(int tenantId, int usage);   // journal rewind
+
+    const TenantQuota* getQuota(int tenantId) const;
+    std::vector<int> getTenantIds() const;
+    long long getUnusedReservations() const;
+};
+
+#endif // TENANT_QUOTA_H
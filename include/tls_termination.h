@@ -0,0 +1,218 @@
+// tls_termination.h
+#ifndef TLS_TERMINATION_H
+#define TLS_TERMINATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "key_hasher.h"
+
+enum class HandshakeKind {
+    FULL,
+    RESUMED_SESSION_ID,
+    RESUMED_TICKET
+};
+
+// CPU spent at the balancer, in microseconds. Defaults are in the range of an
+// ECDHE + RSA-2048 full handshake and an abbreviated one on a single core.
+struct TlsCostModel {
+    double fullHandshakeUs = 1200.0;
+    double resumedHandshakeUs = 60.0;
+    double recordCryptoUsPerKb = 0.8;   // AES-GCM over application data
+    double copyUsPerKb = 0.3;           // user-to-kernel copy of the ciphertext
+};
+
+// Stateless resumption: the session state travels with the client, sealed under
+// the ticket key of the epoch it was issued in
+struct SessionTicket {
+    uint32_t keyEpoch;
+    uint64_t sessionId;
+    int backendId;
+    double issuedAt;
+};
+
+struct TlsClientHello {
+    uint64_t sessionId;          // 0 when the client offers no session id
+    bool hasTicket;
+    SessionTicket ticket;
+};
+
+struct TlsHandshakeResult {
+    HandshakeKind kind;
+    uint64_t sessionId;
+    SessionTicket ticket;        // fresh ticket when tickets are enabled
+    int backendId;               // backend the session was pinned to, -1 for a new session
+    double cpuUs;
+};
+
+struct TlsTerminationStats {
+    uint64_t fullHandshakes;
+    uint64_t resumedBySessionId;
+    uint64_t resumedByTicket;
+    uint64_t cacheEvictions;
+    size_t cachedSessions;
+    double cpuSeconds;
+
+    uint64_t total() const { return fullHandshakes + resumedBySessionId + resumedByTicket; }
+    double resumedRatio() const { return total() ? static_cast<double>(total() - fullHandshakes) / total() : 0.0; }
+};
+
+struct TlsBenchmarkReport {
+    int clients;
+    int connectionsPerClient;
+    unsigned threads;
+    bool tickets;                // clients offered tickets; otherwise only session ids
+    TlsTerminationStats stats;
+    double elapsedMs;
+    double handshakesPerSecond;  // wall clock through the terminator and its cache
+    double modeledHandshakesPerCore;   // from the CPU cost model
+};
+
+// Session-ID cache shared by all terminating threads. Sessions are spread over
+// independently locked shards by a keyed hash of the id, so concurrent
+// handshakes only contend when they land on the same shard. Each shard is an
+// LRU bounded to its share of the capacity; entries also expire after the
+// session lifetime.
+class TlsSessionCache {
+private:
+    struct Entry {
+        uint64_t sessionId;
+        int backendId;
+        double expiresAt;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;    // most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        uint64_t evictions = 0;
+    };
+
+    KeyHasher hasher;
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardMask;
+    size_t capacityPerShard;
+    double lifetimeSeconds;
+
+    Shard& shardFor(uint64_t sessionId) const;
+
+public:
+    // The shard count is rounded up to a power of two
+    TlsSessionCache(size_t shardCount, size_t capacity, double lifetimeSeconds, const KeyHasher& hasher);
+
+    void store(uint64_t sessionId, int backendId, double now);
+    bool lookup(uint64_t sessionId, double now, int& backendId);
+    void erase(uint64_t sessionId);
+
+    size_t size() const;
+    uint64_t getEvictions() const;
+    void resetEvictions();
+    size_t getShardCount() const;
+    double getLifetime() const;
+};
+
+// TLS termination at the balancer, modeled: handshakes are classified as full or
+// resumed (by session id against the shared cache, or by ticket against the
+// accepted ticket keys) and charged to the cost model. With kernel TLS the
+// record crypto still runs, but in the kernel on data sent zero-copy, so the
+// copy into the socket buffer is not charged.
+class TlsTerminator {
+private:
+    TlsSessionCache cache;
+    TlsCostModel cost;
+    bool ticketsEnabled;
+    bool kernelTls;
+    std::atomic<uint32_t> ticketEpoch;
+    uint32_t acceptedTicketKeys;     // current key plus this many - 1 previous ones
+
+    std::atomic<uint64_t> nextSessionId;
+    std::atomic<uint64_t> fullHandshakes;
+    std::atomic<uint64_t> resumedBySessionId;
+    std::atomic<uint64_t> resumedByTicket;
+    std::atomic<uint64_t> cpuNanos;
+
+    bool ticketValid(const SessionTicket& ticket, double now) const;
+    void charge(double us);
+
+public:
+    TlsTerminator(size_t cacheShards = 16, size_t cacheCapacity = 65536, double sessionLifetimeSeconds = 300.0,
+                  const KeyHasher& hasher = KeyHasher());
+
+    void setCostModel(const TlsCostModel& model);
+    void setTicketsEnabled(bool enabled);
+    bool areTicketsEnabled() const;
+    void setKernelTls(bool enabled);
+    bool isKernelTls() const;
+    void rotateTicketKey();
+
+    // pickBackend is consulted only for new sessions; resumed ones keep their backend
+    // while backendAlive(id) holds. A session pinned to a backend that is gone gets
+    // a full handshake to a freshly picked one, and its cache entry is dropped.
+    template <typename PickBackend, typename BackendAlive>
+    TlsHandshakeResult handshake(const TlsClientHello& hello, double now, PickBackend pickBackend,
+                                 BackendAlive backendAlive);
+
+    // CPU for sending `bytes` of application data on a terminated connection
+    double recordCostUs(size_t bytes) const;
+    void chargeRecords(size_t bytes);
+
+    TlsTerminationStats getStats() const;
+    void resetStats();
+
+    // Every client reconnects once per round, connectionsPerClient rounds spaced
+    // reconnectInterval seconds apart; each round is spread over threads
+    // (0 = one per hardware thread)
+    TlsBenchmarkReport benchmark(const std::vector<int>& backendIds, int clients, int connectionsPerClient,
+                                 double reconnectIntervalSeconds, unsigned threads);
+    static std::string formatReport(const TlsBenchmarkReport& report);
+};
+
+template <typename PickBackend, typename BackendAlive>
+TlsHandshakeResult TlsTerminator::handshake(const TlsClientHello& hello, double now, PickBackend pickBackend,
+                                            BackendAlive backendAlive) {
+    TlsHandshakeResult result;
+    result.ticket = SessionTicket{0, 0, -1, 0.0};
+    result.backendId = -1;
+
+    int cachedBackend = -1;
+    if (ticketsEnabled && hello.hasTicket && ticketValid(hello.ticket, now) &&
+        backendAlive(hello.ticket.backendId)) {
+        result.kind = HandshakeKind::RESUMED_TICKET;
+        result.sessionId = hello.ticket.sessionId;
+        result.backendId = hello.ticket.backendId;
+        resumedByTicket.fetch_add(1, std::memory_order_relaxed);
+    } else if (hello.sessionId != 0 && cache.lookup(hello.sessionId, now, cachedBackend) &&
+               backendAlive(cachedBackend)) {
+        result.kind = HandshakeKind::RESUMED_SESSION_ID;
+        result.sessionId = hello.sessionId;
+        result.backendId = cachedBackend;
+        resumedBySessionId.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        if (cachedBackend >= 0) {
+            cache.erase(hello.sessionId);   // pinned to a backend that is gone
+        }
+        result.kind = HandshakeKind::FULL;
+        result.sessionId = nextSessionId.fetch_add(1, std::memory_order_relaxed);
+        result.backendId = pickBackend(result.sessionId);
+        fullHandshakes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    result.cpuUs = (result.kind == HandshakeKind::FULL) ? cost.fullHandshakeUs : cost.resumedHandshakeUs;
+    charge(result.cpuUs);
+
+    if (result.kind == HandshakeKind::FULL) {
+        cache.store(result.sessionId, result.backendId, now);
+    }
+    if (ticketsEnabled) {
+        result.ticket = SessionTicket{ticketEpoch.load(std::memory_order_relaxed), result.sessionId,
+                                      result.backendId, now};
+    }
+    return result;
+}
+
+#endif // TLS_TERMINATION_H
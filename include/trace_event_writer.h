@@ -0,0 +1,49 @@
+// trace_event_writer.h
+#ifndef TRACE_EVENT_WRITER_H
+#define TRACE_EVENT_WRITER_H
+
+#include <string>
+#include <fstream>
+#include <chrono>
+
+// Buffered writer for the Chrome trace-event JSON format (also loaded by Perfetto).
+// Events are appended to an in-memory buffer and written out in large blocks, so
+// emitting from simulation loops stays cheap. Timestamps are microseconds since the
+// writer was created. Names and categories are escaped; argument strings are passed
+// through as a JSON object literal.
+class TraceEventWriter {
+private:
+    std::ofstream out;
+    std::string buffer;
+    size_t flushThreshold;
+    bool firstEvent;
+    bool failed;    // a write to the file failed
+    std::chrono::steady_clock::time_point startTime;
+
+    void beginEvent(const std::string& name, const char* category, char phase, int tid, double timestampUs);
+    void endEvent(const std::string& args);
+
+public:
+    TraceEventWriter(const std::string& path, size_t bufferSize = 1 << 20);
+    ~TraceEventWriter();
+
+    bool isOpen() const;
+    double nowUs() const;
+
+    // Metadata
+    void setProcessName(const std::string& name);
+    void setThreadName(int tid, const std::string& name);
+
+    // Events
+    void instant(const std::string& name, const char* category, int tid, const std::string& args = "");
+    void begin(const std::string& name, const char* category, int tid, const std::string& args = "");
+    void end(const std::string& name, const char* category, int tid);
+    void complete(const std::string& name, const char* category, int tid,
+                  double timestampUs, double durationUs, const std::string& args = "");
+    void counter(const std::string& name, const char* series, double value);
+
+    void flush();
+    bool close();   // false if the trace could not be written out
+};
+
+#endif // TRACE_EVENT_WRITER_H
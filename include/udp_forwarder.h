@@ -0,0 +1,261 @@
+// udp_forwarder.h
+#ifndef UDP_FORWARDER_H
+#define UDP_FORWARDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include "key_hasher.h"
+
+class LoadBalancer;
+
+// Flow -> server map shared by the forwarder's workers, which never block each
+// other. A slot is a key word and a value word: a key is claimed by CAS, then
+// the value (server and last-seen second) is published; readers that match a key
+// whose value is still zero wait for it. Idle flows are expired by zeroing the
+// value and turning the key into a tombstone, which later flows may reclaim.
+//
+// Tombstones in front of live keys are only reclaimed by inserts that probe
+// through them, so with short-lived flows (DNS, one source port per query) they
+// would eventually leave no empty slot to end a probe. Once they pass a quarter
+// of the table, the sweep rebuilds it. Workers hold reader() around each batch of
+// lookups; a rebuild waits for the batches in flight and holds off new ones.
+//
+// Flows are only created by the worker whose socket receives them (the kernel
+// hashes a flow to one SO_REUSEPORT socket), so inserts of the same flow do not
+// race in practice; if they do, the loser's server choice is released.
+class UdpFlowTable {
+private:
+    struct alignas(16) Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    uint32_t idleTimeout;
+    KeyHasher hasher;
+    std::atomic<size_t> liveFlows;
+    mutable std::shared_mutex maintenance;
+    std::atomic<bool> rebuildPending;    // holds new readers back; the lock itself prefers readers
+    uint64_t rebuilds;
+
+    static uint64_t packValue(int serverId, uint32_t now) {
+        return (static_cast<uint64_t>(serverId + 1) << 32) | now;
+    }
+    static int serverOf(uint64_t value) { return static_cast<int>(value >> 32) - 1; }
+    static uint32_t lastSeenOf(uint64_t value) { return static_cast<uint32_t>(value); }
+
+    void touch(Slot& slot, uint64_t value, uint32_t now);
+    uint64_t awaitValue(Slot& slot, uint64_t flow) const;   // 0 when the slot stopped holding flow
+    void rebuild();
+
+public:
+    static const uint64_t kEmpty = 0;
+    static const uint64_t kTombstone = ~0ULL;
+
+    // Capacity is rounded up to a power of two; keep it at twice the expected flows
+    UdpFlowTable(size_t capacity, uint32_t idleTimeoutSeconds, const KeyHasher& hasher);
+
+    // Source address and port plus the listener port. The listener address and
+    // protocol are the same for every flow of a table, so three fields of the
+    // 5-tuple identify the flow.
+    static uint64_t flowKey(const sockaddr_in& source, uint16_t listenPort);
+
+    // Held around lookup() and route(); expireIdle() takes it exclusively to rebuild
+    std::shared_lock<std::shared_mutex> reader() const;
+
+    int lookup(uint64_t flow, uint32_t now);
+
+    // Existing server of the flow, or pick() for a new one (-1 drops the flow)
+    template <typename Pick, typename Release>
+    int route(uint64_t flow, uint32_t now, Pick pick, Release release, bool& created);
+
+    // Expires flows idle for the timeout (all flows when `all`); release(serverId) per flow
+    template <typename Release>
+    size_t expireIdle(uint32_t now, Release release, bool all = false);
+
+    size_t size() const;
+    size_t capacity() const;
+    uint64_t getRebuilds() const;
+};
+
+struct UdpForwarderStats {
+    uint64_t packetsIn;
+    uint64_t packetsOut;
+    uint64_t dropped;            // no backend for the flow's server, or the send failed
+    uint64_t truncated;          // larger than the receive buffer; dropped
+    uint64_t batches;            // recvmmsg calls that returned datagrams
+    uint64_t gsoSends;           // messages that carried several datagrams as GSO segments
+    uint64_t newFlows;
+    uint64_t expiredFlows;
+    uint64_t tableRebuilds;
+};
+
+struct UdpBenchmarkReport {
+    int flows;
+    int packetsPerFlow;
+    unsigned workers;
+    size_t payloadBytes;
+    uint64_t sent;
+    uint64_t received;           // at the backends
+    UdpForwarderStats forwarder;
+    bool gso;
+    double elapsedMs;
+    double packetsPerSecond;
+};
+
+// UDP load balancing on loopback-capable sockets: each worker owns one
+// SO_REUSEPORT socket on the listener port, reads datagrams in recvmmsg
+// batches, maps each to its flow's server and forwards the batch with one
+// sendmmsg. Consecutive equal-size datagrams for the same backend are coalesced
+// into a single UDP_SEGMENT (GSO) send where the kernel supports it. New flows
+// are placed through the balancer's current algorithm, one load unit per flow,
+// released when the flow idles out. Forwarding is one-way (metrics, logs);
+// replies are not relayed back to clients.
+//
+// Workers place and release flows through the balancer under its flow lock,
+// which orders them against each other but not against membership changes. The
+// balancer's servers and subsets must stay fixed while a forwarder runs, as they
+// do during benchmark().
+class UdpForwarder {
+private:
+    LoadBalancer& balancer;
+    UdpFlowTable flows;
+    uint16_t listenPort;
+    unsigned workerCount;
+    std::vector<int> sockets;
+    std::unordered_map<int, sockaddr_in> backends;   // server id -> address, fixed while running
+    std::vector<std::thread> workers;
+    std::atomic<bool> running;
+    std::atomic<bool> gsoEnabled;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::atomic<uint64_t> packetsIn;
+    std::atomic<uint64_t> packetsOut;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> truncated;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> gsoSends;
+    std::atomic<uint64_t> newFlows;
+    std::atomic<uint64_t> expiredFlows;
+
+    uint32_t nowSeconds() const;
+    void workerLoop(unsigned index);
+    void expireFlows(uint32_t now, bool all);
+
+public:
+    // listenPort 0 binds an ephemeral port; see getListenPort()
+    UdpForwarder(LoadBalancer& balancer, uint16_t listenPort = 0, unsigned workers = 1,
+                 size_t flowCapacity = 1 << 16, uint32_t idleTimeoutSeconds = 30);
+    ~UdpForwarder();
+
+    UdpForwarder(const UdpForwarder&) = delete;
+    UdpForwarder& operator=(const UdpForwarder&) = delete;
+
+    // Backends are loopback ports standing in for the balancer's servers
+    void addBackend(int serverId, uint16_t port);
+    bool start();
+    void stop();   // joins the workers and releases every flow's load
+
+    uint16_t getListenPort() const;
+    bool isGsoEnabled() const;
+    UdpForwarderStats getStats() const;
+    size_t getFlowCount() const;
+
+    // Clients with one socket per flow send packetsPerFlow datagrams each through
+    // a forwarder in front of loopback sinks, one per online server
+    static UdpBenchmarkReport benchmark(LoadBalancer& balancer, int flows, int packetsPerFlow,
+                                        unsigned workers = 1, size_t payloadBytes = 64);
+    static std::string formatReport(const UdpBenchmarkReport& report);
+};
+
+template <typename Pick, typename Release>
+int UdpFlowTable::route(uint64_t flow, uint32_t now, Pick pick, Release release, bool& created) {
+    created = false;
+    size_t start = hasher.hashInt(flow) & mask;
+    size_t reusable = mask + 1;   // first tombstone on the probe path
+    size_t probe = 0;
+
+    // Lookup: stops at the first empty slot
+    for (; probe <= mask; probe++) {
+        Slot& slot = slots[(start + probe) & mask];
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key == flow) {
+            uint64_t value = awaitValue(slot, flow);
+            if (value == 0) continue;
+            touch(slot, value, now);
+            return serverOf(value);
+        }
+        if (key == kEmpty) break;
+        if (key == kTombstone && reusable > mask) reusable = (start + probe) & mask;
+    }
+
+    int serverId = pick();
+    if (serverId < 0) return -1;
+
+    // Claim a tombstone on the path if there was one, else the empty slot that ended it
+    while (probe <= mask || reusable <= mask) {
+        bool useTombstone = reusable <= mask;
+        Slot& slot = slots[useTombstone ? reusable : (start + probe) & mask];
+        uint64_t expected = useTombstone ? kTombstone : kEmpty;
+        reusable = mask + 1;
+        if (!useTombstone) probe++;
+
+        if (slot.key.compare_exchange_strong(expected, flow, std::memory_order_acq_rel)) {
+            slot.value.store(packValue(serverId, now), std::memory_order_release);
+            liveFlows.fetch_add(1, std::memory_order_relaxed);
+            created = true;
+            return serverId;
+        }
+        if (expected == flow) {
+            // Lost the race to another worker inserting the same flow
+            uint64_t value = awaitValue(slot, flow);
+            if (value != 0) {
+                release(serverId);
+                return serverOf(value);
+            }
+        }
+    }
+
+    // Table full
+    release(serverId);
+    return -1;
+}
+
+template <typename Release>
+size_t UdpFlowTable::expireIdle(uint32_t now, Release release, bool all) {
+    size_t expired = 0;
+    size_t tombstones = 0;
+    for (size_t i = 0; i <= mask; i++) {
+        Slot& slot = slots[i];
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key == kTombstone) tombstones++;
+        if (key == kEmpty || key == kTombstone) continue;
+
+        uint64_t value = slot.value.load(std::memory_order_acquire);
+        if (value == 0) continue;
+        if (!all && now - lastSeenOf(value) < idleTimeout) continue;
+
+        // Zeroing the value first makes concurrent readers wait, then re-probe
+        if (slot.value.compare_exchange_strong(value, 0, std::memory_order_acq_rel)) {
+            slot.key.store(kTombstone, std::memory_order_release);
+            liveFlows.fetch_sub(1, std::memory_order_relaxed);
+            release(serverOf(value));
+            expired++;
+        }
+    }
+    if (tombstones + expired > capacity() / 4) {
+        rebuild();
+    }
+    return expired;
+}
+
+#endif // UDP_FORWARDER_H
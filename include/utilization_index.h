@@ -0,0 +1,48 @@
+// utilization_index.h
+#ifndef UTILIZATION_INDEX_H
+#define UTILIZATION_INDEX_H
+
+#include <unordered_map>
+#include <vector>
+#include "order_statistics_tree.h"
+
+// Online servers ordered by load percentage (load / capacity), so percentile,
+// rank and "k-th most loaded" queries are O(log n) instead of a sort of the
+// fleet. Ties are broken by server id. The tree's subtree sums also give the
+// mean and variance without a pass over the fleet.
+class UtilizationIndex {
+private:
+    std::unordered_map<int, double> indexed;   // server id -> key it is stored under
+    OrderStatisticsTree sorted;
+
+public:
+    void update(int serverId, double loadPercentage, bool online);
+    void remove(int serverId);
+    void clear();
+
+    int size() const;
+
+    // Nearest-rank percentile, p in [0, 100]; 0 when no server is indexed
+    double percentile(double p) const;
+
+    // 1 for the most loaded server; 0 when the server is not indexed
+    int rankOf(int serverId) const;
+
+    // Server id of the k-th most loaded server (1-based); -1 when out of range
+    int kthMostLoaded(int k) const;
+    int kthLeastLoaded(int k) const;
+
+    // Up to n server ids, most loaded first / least loaded first
+    std::vector<int> mostLoaded(int n) const;
+    std::vector<int> leastLoaded(int n) const;
+
+    // Population mean and variance of the indexed percentages, O(1)
+    double mean() const;
+    double variance() const;
+
+    // Servers per bucket [bounds[i-1], bounds[i]), with the first bucket open
+    // below and an extra last bucket for bounds.back() and up; O(bounds log n)
+    std::vector<int> histogram(const std::vector<double>& bounds) const;
+};
+
+#endif // UTILIZATION_INDEX_H
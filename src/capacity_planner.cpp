@@ -0,0 +1,182 @@
+// capacity_planner.cpp
+#include "include/capacity_planner.h"
+#include "include/placement_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+int FleetConfiguration::serverCount() const {
+    int count = 0;
+    for (const auto& group : groups) {
+        count += group.first;
+    }
+    return count;
+}
+
+int FleetConfiguration::totalCapacity() const {
+    int total = 0;
+    for (const auto& group : groups) {
+        total += group.first * group.second;
+    }
+    return total;
+}
+
+FleetSnapshot FleetConfiguration::materialize() const {
+    FleetSnapshot fleet;
+    int nextId = 1;
+    for (const auto& group : groups) {
+        for (int i = 0; i < group.first; i++) {
+            fleet.add(nextId++, group.second, 0, 1.0, true, 0);
+        }
+    }
+    return fleet;
+}
+
+CapacityPlanner::CapacityPlanner(unsigned threads) : threads(threads) {
+}
+
+PlanEvaluation CapacityPlanner::evaluate(const FleetSnapshot& fleet, const std::vector<int>& forecast,
+                                         BalancingAlgorithm algorithm, const PlanningTargets& targets) const {
+    PlanEvaluation evaluation = {true, 0, 0.0, 0.0, 0};
+    std::ostream quiet(nullptr);
+
+    for (int demand : forecast) {
+        // Steps start from the empty fleet; the fork copies chunks as load lands
+        FleetSnapshot working = fleet.fork();
+
+        int placed = 0;
+        switch (algorithm) {
+            case BalancingAlgorithm::ROUND_ROBIN:
+                placed = placement::roundRobin(working, demand, quiet);
+                break;
+            case BalancingAlgorithm::LEAST_LOADED:
+                placed = placement::leastLoaded(working, demand, quiet);
+                break;
+            case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
+                placed = placement::weightedOptimization(working, demand, quiet);
+                break;
+            case BalancingAlgorithm::COST_OPTIMIZED:
+                break;
+        }
+
+        // Same statistics as the status view: load percentages of online servers
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        double peak = 0.0;
+        int online = 0;
+        for (size_t i = 0; i < working.size(); i++) {
+            int capacity = working.getCapacity(i);
+            if (!working.isOnline(i) || capacity <= 0) continue;
+            double percentage = 100.0 * working.getCurrentLoad(i) / capacity;
+            sum += percentage;
+            sumSquares += percentage * percentage;
+            peak = std::max(peak, percentage);
+            online++;
+        }
+        double variance = 0.0;
+        if (online > 0) {
+            double mean = sum / online;
+            variance = std::max(0.0, sumSquares / online - mean * mean);
+        }
+
+        evaluation.unplacedLoad = std::max(evaluation.unplacedLoad, demand - placed);
+        evaluation.peakUtilization = std::max(evaluation.peakUtilization, peak);
+        evaluation.peakVariance = std::max(evaluation.peakVariance, variance);
+        evaluation.stepsEvaluated++;
+
+        if (demand > placed || peak > targets.maxUtilization || variance > targets.maxVariance) {
+            evaluation.feasible = false;
+            break;
+        }
+    }
+
+    return evaluation;
+}
+
+CapacityPlan CapacityPlanner::plan(const std::vector<int>& forecast, const std::vector<FleetConfiguration>& candidates,
+                                   const std::vector<BalancingAlgorithm>& algorithms,
+                                   const PlanningTargets& targets) const {
+    auto start = std::chrono::steady_clock::now();
+
+    CapacityPlan result;
+    for (BalancingAlgorithm algorithm : algorithms) {
+        if (algorithm != BalancingAlgorithm::COST_OPTIMIZED) {
+            result.algorithms.push_back(algorithm);
+        }
+    }
+    result.evaluations.assign(result.algorithms.size(), std::vector<PlanEvaluation>(candidates.size()));
+    result.best.assign(result.algorithms.size(), -1);
+
+    std::vector<FleetSnapshot> fleets;
+    fleets.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        fleets.push_back(candidate.materialize());
+    }
+
+    // One what-if per (configuration, algorithm)
+    const size_t algorithmCount = result.algorithms.size();
+    placement::forEachBatch(candidates.size() * algorithmCount, threads, 8, [&](size_t first, size_t last) {
+        for (size_t w = first; w < last; w++) {
+            size_t c = w / algorithmCount;
+            size_t a = w % algorithmCount;
+            result.evaluations[a][c] = evaluate(fleets[c], forecast, result.algorithms[a], targets);
+        }
+    });
+
+    for (size_t a = 0; a < algorithmCount; a++) {
+        for (size_t c = 0; c < candidates.size(); c++) {
+            if (!result.evaluations[a][c].feasible) continue;
+
+            int best = result.best[a];
+            if (best < 0 ||
+                candidates[c].totalCapacity() < candidates[best].totalCapacity() ||
+                (candidates[c].totalCapacity() == candidates[best].totalCapacity() &&
+                 candidates[c].serverCount() < candidates[best].serverCount())) {
+                result.best[a] = static_cast<int>(c);
+            }
+        }
+    }
+
+    result.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<FleetConfiguration> CapacityPlanner::uniformCandidates(int minServers, int maxServers,
+                                                                   const std::vector<int>& capacities) {
+    std::vector<FleetConfiguration> candidates;
+    for (int capacity : capacities) {
+        for (int count = std::max(1, minServers); count <= maxServers; count++) {
+            FleetConfiguration candidate;
+            candidate.name = std::to_string(count) + " x " + std::to_string(capacity);
+            candidate.groups.push_back(std::make_pair(count, capacity));
+            candidates.push_back(candidate);
+        }
+    }
+    return candidates;
+}
+
+std::string CapacityPlanner::formatPlan(const CapacityPlan& plan, const std::vector<FleetConfiguration>& candidates) {
+    std::stringstream ss;
+    ss << "=== CAPACITY PLAN ===" << std::endl;
+    ss << "Candidates: " << candidates.size() << " (" << std::fixed << std::setprecision(2)
+       << plan.elapsedMs << " ms)" << std::endl;
+
+    for (size_t a = 0; a < plan.algorithms.size(); a++) {
+        ss << LoadBalancer::algorithmName(plan.algorithms[a]) << ": ";
+        int best = plan.best[a];
+        if (best < 0) {
+            ss << "no candidate meets the targets" << std::endl;
+            continue;
+        }
+
+        const PlanEvaluation& evaluation = plan.evaluations[a][best];
+        ss << candidates[best].name << " (" << candidates[best].totalCapacity() << " capacity, peak "
+           << std::setprecision(1) << evaluation.peakUtilization << "%, variance "
+           << std::setprecision(2) << evaluation.peakVariance << ")" << std::endl;
+    }
+
+    ss << "=====================" << std::endl;
+    return ss.str();
+}
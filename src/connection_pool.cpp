@@ -0,0 +1,333 @@
+// connection_pool.cpp
+#include "include/connection_pool.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+ConnectionPool::ConnectionPool(int serverId, const ConnectionPoolOptions& options, double now)
+    : serverId(serverId),
+      options(options),
+      idleCount(0),
+      activeStreams(0),
+      openConnections(0),
+      peakConnections(0),
+      checkouts(0),
+      reuses(0),
+      created(0),
+      recycled(0),
+      exhausted(0),
+      checkoutNanos(0),
+      maxCheckoutNanos(0) {
+    this->options.maxSize = std::max(0, options.maxSize);
+    this->options.minIdle = std::max(0, std::min(options.minIdle, this->options.maxSize));
+    this->options.maxStreamsPerConnection = std::max(1, options.maxStreamsPerConnection);
+
+    int size = this->options.maxSize;
+    connections.reset(new Connection[std::max(1, size)]);
+    for (int i = 0; i < size; i++) {
+        connections[i].next.store(i + 1 < size ? static_cast<uint32_t>(i + 1) : kNil, std::memory_order_relaxed);
+        connections[i].state.store(0, std::memory_order_relaxed);
+        connections[i].retire.store(false, std::memory_order_relaxed);
+        connections[i].createdAt = 0.0;
+    }
+    idle.head.store(kNil, std::memory_order_relaxed);
+    unopened.head.store(size > 0 ? 0 : kNil, std::memory_order_relaxed);
+
+    warmup(now);
+}
+
+void ConnectionPool::push(Stack& stack, uint32_t slot) {
+    uint64_t head = stack.head.load(std::memory_order_acquire);
+    uint64_t replacement;
+    do {
+        connections[slot].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        replacement = (((head >> 32) + 1) << 32) | slot;
+    } while (!stack.head.compare_exchange_weak(head, replacement, std::memory_order_release,
+                                               std::memory_order_acquire));
+}
+
+uint32_t ConnectionPool::pop(Stack& stack) {
+    uint64_t head = stack.head.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t slot = static_cast<uint32_t>(head);
+        if (slot == kNil) return kNil;
+
+        // A stale next is harmless: the tag makes the CAS fail if the head moved
+        uint32_t next = connections[slot].next.load(std::memory_order_relaxed);
+        uint64_t replacement = (((head >> 32) + 1) << 32) | next;
+        if (stack.head.compare_exchange_weak(head, replacement, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+}
+
+bool ConnectionPool::expired(uint32_t slot, double now) const {
+    return now - connections[slot].createdAt >= options.maxLifetimeSeconds;
+}
+
+void ConnectionPool::open(uint32_t slot, double now, uint32_t streams) {
+    Connection& connection = connections[slot];
+    connection.createdAt = now;
+    connection.retire.store(false, std::memory_order_relaxed);
+    connection.state.store(streams, std::memory_order_relaxed);
+    created.fetch_add(1, std::memory_order_relaxed);
+
+    int open = openConnections.fetch_add(1, std::memory_order_relaxed) + 1;
+    int peak = peakConnections.load(std::memory_order_relaxed);
+    while (open > peak && !peakConnections.compare_exchange_weak(peak, open, std::memory_order_relaxed)) {
+    }
+}
+
+void ConnectionPool::close(uint32_t slot) {
+    openConnections.fetch_sub(1, std::memory_order_relaxed);
+    push(unopened, slot);
+}
+
+void ConnectionPool::drain(uint32_t slot, double now) {
+    // Streams still in flight close it when the last one returns
+    uint32_t old = connections[slot].state.fetch_or(kDraining, std::memory_order_acq_rel);
+    if ((old & kStreamMask) == 0) {
+        close(slot);
+        warmup(now);
+    }
+}
+
+void ConnectionPool::recordCheckout(uint64_t nanos) {
+    checkoutNanos.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t seen = maxCheckoutNanos.load(std::memory_order_relaxed);
+    while (nanos > seen && !maxCheckoutNanos.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+PooledConnection ConnectionPool::checkout(double now) {
+    auto start = std::chrono::steady_clock::now();
+    const uint32_t maxStreams = static_cast<uint32_t>(options.maxStreamsPerConnection);
+    PooledConnection connection = {serverId, -1, false};
+    double connectUs = 0.0;
+
+    for (int attempt = 0; connection.slot < 0; attempt++) {
+        // Warmest first; connections past their lifetime or broken drain on the way
+        for (uint32_t slot = pop(idle); slot != kNil; slot = pop(idle)) {
+            idleCount.fetch_sub(1, std::memory_order_relaxed);
+            bool retired = connections[slot].retire.load(std::memory_order_relaxed);
+            if (retired || expired(slot, now)) {
+                if (!retired) recycled.fetch_add(1, std::memory_order_relaxed);
+                drain(slot, now);
+                continue;
+            }
+
+            // Back on the stack while it has a free stream slot
+            uint32_t streams = connections[slot].state.fetch_add(1, std::memory_order_acq_rel) + 1;
+            if (streams < maxStreams) {
+                push(idle, slot);
+                idleCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            connection.slot = static_cast<int>(slot);
+            connection.reused = true;
+            break;
+        }
+        if (connection.slot >= 0) break;
+
+        uint32_t slot = pop(unopened);
+        if (slot != kNil) {
+            open(slot, now, 1);
+            if (maxStreams > 1) {
+                push(idle, slot);
+                idleCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            connection.slot = static_cast<int>(slot);
+            connectUs = options.connectLatencyUs;
+            break;
+        }
+
+        // Another checkout may hold a multiplexed connection off the stack
+        // for a moment; only refuse once every stream slot is really taken
+        if (maxStreams == 1 || attempt >= kCheckoutRetries || getHeadroom() <= 0) {
+            exhausted.fetch_add(1, std::memory_order_relaxed);
+            return connection;
+        }
+        std::this_thread::yield();
+    }
+
+    activeStreams.fetch_add(1, std::memory_order_relaxed);
+    checkouts.fetch_add(1, std::memory_order_relaxed);
+    if (connection.reused) {
+        reuses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    recordCheckout(nanos + static_cast<uint64_t>(connectUs * 1000.0));
+    return connection;
+}
+
+void ConnectionPool::checkin(const PooledConnection& connection, double now, bool broken) {
+    if (connection.slot < 0 || connection.serverId != serverId) return;
+    uint32_t slot = static_cast<uint32_t>(connection.slot);
+    activeStreams.fetch_sub(1, std::memory_order_relaxed);
+
+    uint32_t old = connections[slot].state.fetch_sub(1, std::memory_order_acq_rel);
+    uint32_t streams = old & kStreamMask;
+    if (old & kDraining) {
+        if (streams == 1) {
+            close(slot);
+            warmup(now);
+        }
+        return;
+    }
+
+    if (streams == static_cast<uint32_t>(options.maxStreamsPerConnection)) {
+        // It was full and off the stack; this stream frees a slot on it
+        if (broken || expired(slot, now)) {
+            if (!broken) recycled.fetch_add(1, std::memory_order_relaxed);
+            drain(slot, now);
+            return;
+        }
+        push(idle, slot);
+        idleCount.fetch_add(1, std::memory_order_relaxed);
+    } else if (broken) {
+        // Still on the stack, where only a checkout can take it off
+        connections[slot].retire.store(true, std::memory_order_relaxed);
+    }
+}
+
+int ConnectionPool::warmup(double now) {
+    int opened = 0;
+    while (idleCount.load(std::memory_order_relaxed) < options.minIdle) {
+        uint32_t slot = pop(unopened);
+        if (slot == kNil) break;
+
+        open(slot, now, 0);
+        push(idle, slot);
+        idleCount.fetch_add(1, std::memory_order_relaxed);
+        opened++;
+    }
+    return opened;
+}
+
+int ConnectionPool::getServerId() const {
+    return serverId;
+}
+
+int ConnectionPool::getHeadroom() const {
+    return options.maxSize * options.maxStreamsPerConnection - activeStreams.load(std::memory_order_relaxed);
+}
+
+ConnectionPoolStats ConnectionPool::getStats() const {
+    ConnectionPoolStats stats;
+    stats.checkouts = checkouts.load(std::memory_order_relaxed);
+    stats.reuses = reuses.load(std::memory_order_relaxed);
+    stats.created = created.load(std::memory_order_relaxed);
+    stats.recycled = recycled.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted.load(std::memory_order_relaxed);
+    stats.idle = std::max(0, idleCount.load(std::memory_order_relaxed));
+    stats.activeStreams = std::max(0, activeStreams.load(std::memory_order_relaxed));
+    stats.openConnections = std::max(0, openConnections.load(std::memory_order_relaxed));
+    stats.peakConnections = peakConnections.load(std::memory_order_relaxed);
+    stats.exhaustedPools = getHeadroom() <= 0 ? 1 : 0;
+    stats.meanCheckoutUs = stats.checkouts ? checkoutNanos.load(std::memory_order_relaxed) / 1000.0 / stats.checkouts
+                                           : 0.0;
+    stats.maxCheckoutUs = maxCheckoutNanos.load(std::memory_order_relaxed) / 1000.0;
+    return stats;
+}
+
+ConnectionPoolManager::ConnectionPoolManager(const ConnectionPoolOptions& options)
+    : options(options), startTime(std::chrono::steady_clock::now()) {
+}
+
+double ConnectionPoolManager::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+const ConnectionPoolOptions& ConnectionPoolManager::getOptions() const {
+    return options;
+}
+
+void ConnectionPoolManager::addServer(int serverId) {
+    if (pools.count(serverId)) return;
+    pools[serverId] = std::unique_ptr<ConnectionPool>(new ConnectionPool(serverId, options, now()));
+}
+
+void ConnectionPoolManager::removeServer(int serverId) {
+    pools.erase(serverId);
+}
+
+ConnectionPool* ConnectionPoolManager::getPool(int serverId) const {
+    auto it = pools.find(serverId);
+    return it != pools.end() ? it->second.get() : nullptr;
+}
+
+int ConnectionPoolManager::getHeadroom(int serverId) const {
+    ConnectionPool* pool = getPool(serverId);
+    return pool ? pool->getHeadroom() : -1;
+}
+
+void ConnectionPoolManager::maintain() {
+    double current = now();
+    for (auto& entry : pools) {
+        entry.second->warmup(current);
+    }
+}
+
+ConnectionPoolStats ConnectionPoolManager::getStats() const {
+    ConnectionPoolStats total = ConnectionPoolStats();
+    double checkoutUs = 0.0;
+    for (auto& entry : pools) {
+        ConnectionPoolStats stats = entry.second->getStats();
+        total.checkouts += stats.checkouts;
+        total.reuses += stats.reuses;
+        total.created += stats.created;
+        total.recycled += stats.recycled;
+        total.exhausted += stats.exhausted;
+        total.idle += stats.idle;
+        total.activeStreams += stats.activeStreams;
+        total.openConnections += stats.openConnections;
+        total.peakConnections += stats.peakConnections;
+        total.exhaustedPools += stats.exhaustedPools;
+        total.maxCheckoutUs = std::max(total.maxCheckoutUs, stats.maxCheckoutUs);
+        checkoutUs += stats.meanCheckoutUs * stats.checkouts;
+    }
+    total.meanCheckoutUs = total.checkouts ? checkoutUs / total.checkouts : 0.0;
+    return total;
+}
+
+std::string ConnectionPoolManager::formatStats(const ConnectionPoolStats& stats) {
+    std::stringstream ss;
+    ss << "=== BACKEND CONNECTION POOLS ===" << std::endl;
+    ss << "Checkouts: " << stats.checkouts << " (" << std::fixed << std::setprecision(1)
+       << 100.0 * stats.reuseRatio() << "% reused)" << std::endl;
+    ss << "Connections: " << stats.openConnections << " open (" << stats.idle << " with a free stream), "
+       << stats.created << " opened, " << stats.recycled << " recycled" << std::endl;
+    ss << "Streams: " << stats.activeStreams << " in flight, " << std::setprecision(2)
+       << stats.streamsPerConnection() << " per connection" << std::endl;
+    ss << "Refused: " << stats.exhausted << " (" << stats.exhaustedPools << " pools exhausted now)" << std::endl;
+    ss << "Checkout latency: " << std::setprecision(2) << stats.meanCheckoutUs << " us mean, "
+       << stats.maxCheckoutUs << " us max" << std::endl;
+    ss << "================================" << std::endl;
+    return ss.str();
+}
+
+std::string ConnectionPoolManager::formatUpstreamReports(const std::vector<UpstreamBenchmarkReport>& reports) {
+    std::stringstream ss;
+    ss << "=== UPSTREAM MULTIPLEXING BENCHMARK ===" << std::endl;
+    if (!reports.empty()) {
+        ss << reports.front().clients << " clients, " << reports.front().requests << " requests, "
+           << reports.front().poolSize << " connections per server" << std::endl;
+    }
+    ss << std::left << std::setw(14) << "Mode" << std::right << std::setw(8) << "Opened" << std::setw(8) << "Peak"
+       << std::setw(10) << "Refused" << std::setw(8) << "Failed" << std::setw(12) << "Mean us" << std::setw(12) << "p99 us"
+       << std::setw(12) << "Req/s" << std::endl;
+    for (const auto& report : reports) {
+        std::string mode = report.maxStreamsPerConnection == 1 ? "HTTP/1.1" :
+                           std::to_string(report.maxStreamsPerConnection) + " streams";
+        ss << std::left << std::setw(14) << mode << std::right << std::setw(8) << report.connectionsOpened
+           << std::setw(8) << report.peakConnections << std::setw(10) << report.refused
+           << std::setw(8) << report.failed << std::fixed
+           << std::setprecision(0) << std::setw(12) << report.meanLatencyUs << std::setw(12) << report.p99LatencyUs
+           << std::setw(12) << report.requestsPerSecond << std::endl;
+    }
+    ss << "=======================================" << std::endl;
+    return ss.str();
+}
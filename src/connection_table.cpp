@@ -0,0 +1,476 @@
+// connection_table.cpp
+#include "include/connection_table.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+MaglevHash::MaglevHash(const KeyHasher& hasher, size_t tableSize)
+    : hasher(hasher), entries(std::max<size_t>(tableSize, 2), -1) {
+}
+
+void MaglevHash::build(const std::vector<int>& backendIds, const std::vector<double>& weights) {
+    size_t size = entries.size();
+    std::fill(entries.begin(), entries.end(), -1);
+
+    // Sorted by id so every balancer with the same membership builds the same table
+    std::vector<std::pair<int, double>> backends;
+    for (size_t i = 0; i < backendIds.size(); i++) {
+        double weight = i < weights.size() ? weights[i] : 1.0;
+        if (weight > 0.0) backends.emplace_back(backendIds[i], weight);
+    }
+    if (backends.empty()) return;
+    std::sort(backends.begin(), backends.end());
+
+    double maxWeight = 0.0;
+    for (auto& backend : backends) {
+        maxWeight = std::max(maxWeight, backend.second);
+    }
+
+    size_t count = backends.size();
+    std::vector<size_t> offset(count);
+    std::vector<size_t> skip(count);
+    std::vector<size_t> next(count, 0);
+    std::vector<double> credit(count, 0.0);
+    for (size_t i = 0; i < count; i++) {
+        offset[i] = hasher.hashPair(backends[i].first, 0) % size;
+        skip[i] = hasher.hashPair(backends[i].first, 1) % (size - 1) + 1;
+    }
+
+    // Each round a backend earns weight / maxWeight turns; a turn claims the next
+    // free entry of its permutation
+    size_t filled = 0;
+    while (filled < size) {
+        for (size_t i = 0; i < count && filled < size; i++) {
+            credit[i] += backends[i].second / maxWeight;
+            while (credit[i] >= 1.0 && filled < size) {
+                credit[i] -= 1.0;
+                size_t position;
+                do {
+                    position = (offset[i] + next[i] * skip[i]) % size;
+                    next[i]++;
+                } while (entries[position] >= 0);
+                entries[position] = backends[i].first;
+                filled++;
+            }
+        }
+    }
+}
+
+int MaglevHash::lookup(uint64_t flowHash) const {
+    return entries[flowHash % entries.size()];
+}
+
+size_t MaglevHash::tableSize() const {
+    return entries.size();
+}
+
+ConnectionTable::ConnectionTable(size_t maxFlows, uint32_t idleTimeoutSeconds, const KeyHasher& hasher)
+    : hasher(hasher),
+      maglev(hasher),
+      used(0),
+      tombstones(0),
+      sweepCursor(0),
+      idleTimeout(std::max<uint32_t>(1, idleTimeoutSeconds)),
+      hits(0),
+      newFlows(0),
+      recovered(0),
+      rerouted(0),
+      expired(0),
+      untracked(0),
+      rehashes(0) {
+    // At most 14 of a group's 16 slots are used, keeping probe chains short
+    const size_t perGroup = kGroupWidth * 7 / 8;
+    groupCount = std::max<size_t>(1, (maxFlows + perGroup - 1) / perGroup);
+    this->maxFlows = groupCount * perGroup;
+    control.assign(groupCount * kGroupWidth, kEmptySlot);
+    entries.resize(groupCount * kGroupWidth);
+}
+
+void ConnectionTable::setBackends(const std::vector<int>& backendIds, const std::vector<double>& weights) {
+    maglev.build(backendIds, weights);
+
+    std::fill(liveBackends.begin(), liveBackends.end(), 0);
+    for (size_t i = 0; i < backendIds.size(); i++) {
+        int id = backendIds[i];
+        double weight = i < weights.size() ? weights[i] : 1.0;
+        if (id < 0 || weight <= 0.0) continue;
+        if (static_cast<size_t>(id) >= liveBackends.size()) liveBackends.resize(id + 1, 0);
+        liveBackends[id] = 1;
+    }
+}
+
+uint64_t ConnectionTable::hashFlow(const FlowTuple& flow) const {
+    uint64_t addresses = (static_cast<uint64_t>(flow.srcIp) << 32) | flow.dstIp;
+    uint64_t ports = (static_cast<uint64_t>(flow.srcPort) << 24) | (static_cast<uint64_t>(flow.dstPort) << 8) |
+                     flow.protocol;
+    return hasher.hashPair(addresses, ports);
+}
+
+bool ConnectionTable::matches(const ConnectionEntry& entry, const FlowTuple& flow) {
+    return entry.srcIp == flow.srcIp && entry.dstIp == flow.dstIp && entry.srcPort == flow.srcPort &&
+           entry.dstPort == flow.dstPort && (entry.backendAndProtocol >> 24) == flow.protocol;
+}
+
+bool ConnectionTable::isIdle(const ConnectionEntry& entry, uint32_t now) const {
+    return now - entry.lastSeen >= idleTimeout;
+}
+
+bool ConnectionTable::isLive(int backendId) const {
+    return backendId >= 0 && static_cast<size_t>(backendId) < liveBackends.size() && liveBackends[backendId];
+}
+
+size_t ConnectionTable::homeGroup(uint64_t hash) const {
+    return static_cast<size_t>((static_cast<__uint128_t>(hash >> 7) * groupCount) >> 57);
+}
+
+uint32_t ConnectionTable::matchGroup(size_t group, uint8_t value) const {
+    const uint8_t* bytes = &control[group * kGroupWidth];
+#if defined(__SSE2__)
+    __m128i tags = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    __m128i wanted = _mm_set1_epi8(static_cast<char>(value));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(tags, wanted)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; i++) {
+        if (bytes[i] == value) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+size_t ConnectionTable::find(const FlowTuple& flow, uint64_t hash) const {
+    uint8_t tag = static_cast<uint8_t>(hash & 0x7F);
+    size_t group = homeGroup(hash);
+
+    // A group with an empty slot ends the probe: inserts fill the first group with room
+    for (size_t probed = 0; probed < groupCount; probed++) {
+        for (uint32_t candidates = matchGroup(group, tag); candidates; candidates &= candidates - 1) {
+            size_t slot = group * kGroupWidth + __builtin_ctz(candidates);
+            if (matches(entries[slot], flow)) return slot;
+        }
+        if (matchGroup(group, kEmptySlot)) return npos;
+        if (++group == groupCount) group = 0;
+    }
+    return npos;
+}
+
+bool ConnectionTable::insert(const FlowTuple& flow, uint64_t hash, int backendId, uint32_t now) {
+    if (used >= maxFlows) return false;
+
+    size_t group = homeGroup(hash);
+    for (size_t probed = 0; probed < groupCount; probed++) {
+        uint32_t room = matchGroup(group, kEmptySlot) | matchGroup(group, kDeletedSlot);
+        if (room) {
+            size_t slot = group * kGroupWidth + __builtin_ctz(room);
+            if (control[slot] == kDeletedSlot) tombstones--;
+            control[slot] = static_cast<uint8_t>(hash & 0x7F);
+            entries[slot] = ConnectionEntry{flow.srcIp, flow.dstIp, flow.srcPort, flow.dstPort, now,
+                                            (static_cast<uint32_t>(flow.protocol) << 24) |
+                                            (static_cast<uint32_t>(backendId) & 0xFFFFFF)};
+            used++;
+            return true;
+        }
+        if (++group == groupCount) group = 0;
+    }
+    return false;
+}
+
+void ConnectionTable::eraseSlot(size_t slot) {
+    // Probes already stop at a group with an empty slot, so no tombstone is needed there
+    if (matchGroup(slot / kGroupWidth, kEmptySlot)) {
+        control[slot] = kEmptySlot;
+    } else {
+        control[slot] = kDeletedSlot;
+        tombstones++;
+    }
+    used--;
+}
+
+void ConnectionTable::sweepGroup(uint32_t now) {
+    size_t group = sweepCursor;
+    if (++sweepCursor == groupCount) sweepCursor = 0;
+
+    uint32_t full = ~(matchGroup(group, kEmptySlot) | matchGroup(group, kDeletedSlot)) & 0xFFFF;
+    for (; full; full &= full - 1) {
+        size_t slot = group * kGroupWidth + __builtin_ctz(full);
+        if (isIdle(entries[slot], now)) {
+            eraseSlot(slot);
+            expired++;
+        }
+    }
+
+    // Once the group has an empty slot its tombstones can be emptied too
+    if (matchGroup(group, kEmptySlot)) {
+        for (uint32_t deleted = matchGroup(group, kDeletedSlot); deleted; deleted &= deleted - 1) {
+            control[group * kGroupWidth + __builtin_ctz(deleted)] = kEmptySlot;
+            tombstones--;
+        }
+    }
+}
+
+void ConnectionTable::rehash() {
+    // Full slots become pending (marked deleted) and tombstones become empty
+    for (auto& byte : control) {
+        byte = (byte & 0x80) ? kEmptySlot : kDeletedSlot;
+    }
+
+    // Each pending entry goes to the first free or pending slot on its probe
+    // path; swapping with a pending one leaves that one to place next
+    for (size_t slot = 0; slot < control.size(); slot++) {
+        while (control[slot] == kDeletedSlot) {
+            const ConnectionEntry& entry = entries[slot];
+            uint64_t hash = hashFlow(FlowTuple{entry.srcIp, entry.dstIp, entry.srcPort, entry.dstPort,
+                                               static_cast<uint8_t>(entry.backendAndProtocol >> 24)});
+            uint8_t tag = static_cast<uint8_t>(hash & 0x7F);
+
+            size_t group = homeGroup(hash);
+            uint32_t room = matchGroup(group, kEmptySlot) | matchGroup(group, kDeletedSlot);
+            while (!room) {
+                if (++group == groupCount) group = 0;
+                room = matchGroup(group, kEmptySlot) | matchGroup(group, kDeletedSlot);
+            }
+
+            if (group == slot / kGroupWidth) {
+                control[slot] = tag;
+                break;
+            }
+            size_t target = group * kGroupWidth + __builtin_ctz(room);
+            if (control[target] == kEmptySlot) {
+                entries[target] = entry;
+                control[slot] = kEmptySlot;
+            } else {
+                std::swap(entries[slot], entries[target]);
+            }
+            control[target] = tag;
+        }
+    }
+    tombstones = 0;
+    rehashes++;
+}
+
+int ConnectionTable::route(const FlowTuple& flow, bool connectionStart, uint32_t now) {
+    uint64_t hash = hashFlow(flow);
+    size_t slot = find(flow, hash);
+
+    if (slot != npos) {
+        ConnectionEntry& entry = entries[slot];
+        if (!isIdle(entry, now)) {
+            int backendId = static_cast<int>(entry.backendAndProtocol & 0xFFFFFF);
+            entry.lastSeen = now;
+            if (isLive(backendId)) {
+                hits++;
+                return backendId;
+            }
+
+            // The backend left; the connection is lost either way, so re-pin it
+            backendId = maglev.lookup(hash);
+            if (backendId < 0) return -1;
+            entry.backendAndProtocol = (entry.backendAndProtocol & 0xFF000000) |
+                                       (static_cast<uint32_t>(backendId) & 0xFFFFFF);
+            rerouted++;
+            return backendId;
+        }
+        expired++;
+        eraseSlot(slot);
+    }
+
+    int backendId = maglev.lookup(hash);
+    if (backendId < 0) return -1;
+    if (connectionStart) {
+        newFlows++;
+    } else {
+        recovered++;
+    }
+
+    sweepGroup(now);
+    if (tombstones > maxFlows / 16) {
+        rehash();
+    }
+    if (!insert(flow, hash, backendId, now)) {
+        untracked++;
+    }
+    return backendId;
+}
+
+void ConnectionTable::close(const FlowTuple& flow) {
+    size_t slot = find(flow, hashFlow(flow));
+    if (slot != npos) {
+        eraseSlot(slot);
+        if (tombstones > maxFlows / 16) {
+            rehash();
+        }
+    }
+}
+
+void ConnectionTable::clear() {
+    std::fill(control.begin(), control.end(), kEmptySlot);
+    used = 0;
+    tombstones = 0;
+    sweepCursor = 0;
+}
+
+ConnectionTableStats ConnectionTable::getStats() const {
+    ConnectionTableStats stats;
+    stats.hits = hits;
+    stats.newFlows = newFlows;
+    stats.recovered = recovered;
+    stats.rerouted = rerouted;
+    stats.expired = expired;
+    stats.untracked = untracked;
+    stats.rehashes = rehashes;
+    stats.flows = used;
+    stats.capacity = maxFlows;
+    stats.memoryBytes = memoryBytes();
+    return stats;
+}
+
+size_t ConnectionTable::size() const {
+    return used;
+}
+
+size_t ConnectionTable::memoryBytes() const {
+    return control.size() * sizeof(uint8_t) + entries.size() * sizeof(ConnectionEntry);
+}
+
+ConnectionBenchmarkReport ConnectionTable::benchmark(const std::vector<int>& backendIds,
+                                                     const std::vector<double>& weights, int flows, int lookups,
+                                                     const KeyHasher& hasher) {
+    ConnectionBenchmarkReport report = ConnectionBenchmarkReport();
+    report.backends = static_cast<int>(backendIds.size());
+    report.flows = std::max(1, flows);
+    report.lookups = std::max(0, lookups);
+    if (backendIds.empty()) return report;
+
+    // Clients towards one VIP on port 443
+    std::mt19937_64 rng(0xC0FFEE);
+    std::vector<FlowTuple> tuples(report.flows);
+    for (auto& tuple : tuples) {
+        uint64_t bits = rng();
+        tuple = FlowTuple{static_cast<uint32_t>(bits), 0x0A000001, static_cast<uint16_t>(bits >> 32), 443, 6};
+    }
+
+    ConnectionTable table(report.flows, 3600, hasher);
+    table.setBackends(backendIds, weights);
+    report.memoryBytes = table.memoryBytes();
+
+    std::vector<int> original(report.flows);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < report.flows; i++) {
+        original[i] = table.route(tuples[i], true, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.insertsPerSecond = seconds > 0.0 ? report.flows / seconds : 0.0;
+
+    // Random order defeats the prefetching a sequential walk would get
+    std::vector<uint32_t> order(report.lookups);
+    for (auto& index : order) {
+        index = static_cast<uint32_t>(rng() % report.flows);
+    }
+    uint64_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t index : order) {
+        checksum += table.route(tuples[index], false, 1);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.lookupsPerSecond = (seconds > 0.0 && checksum != 0) ? report.lookups / seconds : 0.0;
+
+    // The highest id leaves; flows on the other backends should stay put
+    std::vector<int> remainingIds = backendIds;
+    std::vector<double> remainingWeights = weights;
+    remainingWeights.resize(backendIds.size(), 1.0);
+    size_t removedAt = std::max_element(remainingIds.begin(), remainingIds.end()) - remainingIds.begin();
+    int removed = remainingIds[removedAt];
+    remainingIds.erase(remainingIds.begin() + removedAt);
+    remainingWeights.erase(remainingWeights.begin() + removedAt);
+
+    MaglevHash hashOnly(hasher);
+    hashOnly.build(remainingIds, remainingWeights);
+    table.setBackends(remainingIds, remainingWeights);
+
+    int surviving = 0;
+    int kept = 0;
+    int keptByHash = 0;
+    for (int i = 0; i < report.flows; i++) {
+        if (original[i] == removed) continue;
+        surviving++;
+        if (table.route(tuples[i], false, 2) == original[i]) kept++;
+        if (hashOnly.lookup(table.hashFlow(tuples[i])) == original[i]) keptByHash++;
+    }
+
+    // Restarts: every flow is unknown and falls back to the hash
+    int recoveredSame = 0;
+    table.clear();
+    table.setBackends(backendIds, weights);
+    for (int i = 0; i < report.flows; i++) {
+        if (table.route(tuples[i], false, 3) == original[i]) recoveredSame++;
+    }
+
+    int recoveredAfterRemoval = 0;
+    table.clear();
+    table.setBackends(remainingIds, remainingWeights);
+    for (int i = 0; i < report.flows; i++) {
+        if (original[i] != removed && table.route(tuples[i], false, 4) == original[i]) recoveredAfterRemoval++;
+    }
+
+    if (surviving > 0) {
+        report.keptAfterRemoval = static_cast<double>(kept) / surviving;
+        report.keptAfterRemovalHashOnly = static_cast<double>(keptByHash) / surviving;
+        report.keptAfterRestartAndRemoval = static_cast<double>(recoveredAfterRemoval) / surviving;
+    }
+    report.keptAfterRestart = static_cast<double>(recoveredSame) / report.flows;
+
+    // Churn: a full table where every closed flow is replaced by a new one.
+    // Without tombstone cleanup the last round's misses would walk the table.
+    table.clear();
+    table.setBackends(backendIds, weights);
+    for (int i = 0; i < report.flows; i++) {
+        table.route(tuples[i], true, 5);
+    }
+    uint64_t rehashesBefore = table.rehashes;
+    report.churnRounds = 4;
+    for (int round = 0; round < report.churnRounds; round++) {
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < report.flows; i++) {
+            size_t victim = rng() % report.flows;
+            table.close(tuples[victim]);
+            uint64_t bits = rng();
+            tuples[victim] = FlowTuple{static_cast<uint32_t>(bits), 0x0A000001,
+                                       static_cast<uint16_t>(bits >> 32), 443, 6};
+            table.route(tuples[victim], true, 5);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                    report.flows;
+        if (round == 0) report.firstRoundMissNs = ns;
+        report.lastRoundMissNs = ns;
+    }
+    report.churnRehashes = table.rehashes - rehashesBefore;
+    return report;
+}
+
+std::string ConnectionTable::formatReport(const ConnectionBenchmarkReport& report) {
+    std::stringstream ss;
+    ss << "=== CONNECTION TABLE BENCHMARK ===" << std::endl;
+    ss << "Flows: " << report.flows << " over " << report.backends << " backends, "
+       << report.lookups << " lookups" << std::endl;
+    ss << "Memory: " << std::fixed << std::setprecision(1) << report.memoryBytes / (1024.0 * 1024.0) << " MB ("
+       << static_cast<double>(report.memoryBytes) / std::max(1, report.flows) << " bytes/flow)" << std::endl;
+    ss << "Inserts: " << std::setprecision(2) << report.insertsPerSecond / 1e6 << " M/s, lookups: "
+       << report.lookupsPerSecond / 1e6 << " M/s" << std::endl;
+    ss << "Backend removed: " << std::setprecision(1) << 100.0 * report.keptAfterRemoval
+       << "% of surviving flows kept (" << 100.0 * report.keptAfterRemovalHashOnly
+       << "% by consistent hashing alone)" << std::endl;
+    ss << "Restart: " << 100.0 * report.keptAfterRestart << "% of flows recovered onto their backend ("
+       << 100.0 * report.keptAfterRestartAndRemoval << "% after a removal)" << std::endl;
+    ss << "Churn: " << std::setprecision(0) << report.firstRoundMissNs << " ns per close and new flow in round 1, "
+       << report.lastRoundMissNs << " ns in round " << report.churnRounds << " (" << report.churnRehashes
+       << " rehashes)" << std::endl;
+    ss << "==================================" << std::endl;
+    return ss.str();
+}
@@ -0,0 +1,181 @@
+// failure_analysis.cpp
+#include "include/failure_analysis.h"
+#include "include/placement_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <thread>
+
+FailureAnalyzer::FailureAnalyzer(int maxFailures, bool includeZones, unsigned threads)
+    : maxFailures(std::max(1, std::min(2, maxFailures))), includeZones(includeZones), threads(threads) {
+    if (this->threads == 0) {
+        this->threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+std::vector<FailureScenario> FailureAnalyzer::enumerateScenarios(const FleetSnapshot& fleet) const {
+    std::vector<FailureScenario> scenarios;
+
+    // Only servers that are up can fail
+    std::vector<size_t> live;
+    for (size_t i = 0; i < fleet.size(); i++) {
+        if (fleet.isOnline(i)) live.push_back(i);
+    }
+
+    for (size_t a = 0; a < live.size(); a++) {
+        scenarios.push_back({FailureDomain::SERVER, {fleet.getId(live[a])}, fleet.getCurrentLoad(live[a])});
+        if (maxFailures < 2) continue;
+
+        for (size_t b = a + 1; b < live.size(); b++) {
+            scenarios.push_back({FailureDomain::SERVER, {fleet.getId(live[a]), fleet.getId(live[b])},
+                                 fleet.getCurrentLoad(live[a]) + fleet.getCurrentLoad(live[b])});
+        }
+    }
+
+    if (!includeZones) return scenarios;
+
+    std::map<int, int> zoneLoads;
+    for (size_t i : live) {
+        zoneLoads[fleet.getZone(i)] += fleet.getCurrentLoad(i);
+    }
+
+    // A single zone is the whole fleet, not a failure domain
+    if (zoneLoads.size() < 2) return scenarios;
+
+    for (auto a = zoneLoads.begin(); a != zoneLoads.end(); ++a) {
+        scenarios.push_back({FailureDomain::ZONE, {a->first}, a->second});
+        if (maxFailures < 2) continue;
+
+        for (auto b = std::next(a); b != zoneLoads.end(); ++b) {
+            scenarios.push_back({FailureDomain::ZONE, {a->first, b->first}, a->second + b->second});
+        }
+    }
+
+    return scenarios;
+}
+
+ScenarioOutcome FailureAnalyzer::evaluate(const FleetSnapshot& fleet, const FailureScenario& scenario,
+                                          BalancingAlgorithm algorithm) const {
+    // The fork shares every chunk with the snapshot until a failure or the
+    // re-placed load touches it
+    FleetSnapshot survivors = fleet.fork();
+
+    // Take the failed servers down; their load is what has to move
+    for (size_t i = 0; i < survivors.size(); i++) {
+        int key = (scenario.domain == FailureDomain::SERVER) ? survivors.getId(i) : survivors.getZone(i);
+        if (survivors.isOnline(i) && std::find(scenario.failed.begin(), scenario.failed.end(), key) != scenario.failed.end()) {
+            survivors.setOnline(i, false);
+            survivors.setCurrentLoad(i, 0);
+        }
+    }
+
+    std::ostream quiet(nullptr);
+    int placed = 0;
+
+    switch (algorithm) {
+        case BalancingAlgorithm::ROUND_ROBIN:
+            placed = placement::roundRobin(survivors, scenario.orphanedLoad, quiet);
+            break;
+        case BalancingAlgorithm::LEAST_LOADED:
+            placed = placement::leastLoaded(survivors, scenario.orphanedLoad, quiet);
+            break;
+        case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
+            placed = placement::weightedOptimization(survivors, scenario.orphanedLoad, quiet);
+            break;
+        case BalancingAlgorithm::COST_OPTIMIZED:
+            break;
+    }
+
+    ScenarioOutcome outcome = {scenario.orphanedLoad - placed, 0, 0.0};
+    for (size_t i = 0; i < survivors.size(); i++) {
+        int capacity = survivors.getCapacity(i);
+        if (!survivors.isOnline(i) || capacity <= 0) continue;
+
+        if (survivors.getCurrentLoad(i) > capacity) outcome.overloadedServers++;
+        outcome.peakUtilization = std::max(outcome.peakUtilization,
+                                           100.0 * survivors.getCurrentLoad(i) / capacity);
+    }
+    return outcome;
+}
+
+BlastRadiusReport FailureAnalyzer::analyze(const FleetSnapshot& fleet,
+                                           const std::vector<BalancingAlgorithm>& algorithms) const {
+    auto start = std::chrono::steady_clock::now();
+
+    BlastRadiusReport report;
+    for (BalancingAlgorithm algorithm : algorithms) {
+        if (algorithm != BalancingAlgorithm::COST_OPTIMIZED) {
+            report.algorithms.push_back(algorithm);
+        }
+    }
+    report.scenarios = enumerateScenarios(fleet);
+    report.outcomes.assign(report.algorithms.size(), std::vector<ScenarioOutcome>(report.scenarios.size()));
+    report.overflowCounts.assign(report.algorithms.size(), 0);
+
+    // Scenarios are independent; each one works on its own fork of the snapshot
+    placement::forEachBatch(report.scenarios.size(), threads, 16, [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; s++) {
+            for (size_t a = 0; a < report.algorithms.size(); a++) {
+                report.outcomes[a][s] = evaluate(fleet, report.scenarios[s], report.algorithms[a]);
+            }
+        }
+    });
+
+    for (size_t a = 0; a < report.algorithms.size(); a++) {
+        for (const auto& outcome : report.outcomes[a]) {
+            if (outcome.overflows()) report.overflowCounts[a]++;
+        }
+    }
+
+    report.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::string FailureAnalyzer::describe(const FailureScenario& scenario) {
+    std::stringstream ss;
+    ss << (scenario.domain == FailureDomain::SERVER ? "server" : "zone");
+    if (scenario.failed.size() > 1) ss << "s";
+    for (size_t i = 0; i < scenario.failed.size(); i++) {
+        ss << (i == 0 ? " " : "+") << scenario.failed[i];
+    }
+    return ss.str();
+}
+
+std::string FailureAnalyzer::formatReport(const BlastRadiusReport& report, size_t maxListed) {
+    std::stringstream ss;
+    ss << "=== FAILURE ANALYSIS ===" << std::endl;
+    ss << "Scenarios: " << report.scenarios.size() << " (" << std::fixed << std::setprecision(2)
+       << report.elapsedMs << " ms)" << std::endl;
+
+    for (size_t a = 0; a < report.algorithms.size(); a++) {
+        ss << LoadBalancer::algorithmName(report.algorithms[a]) << ": " << report.overflowCounts[a]
+           << " overflowing scenarios" << std::endl;
+
+        // Worst first: most load left unplaced, then the hottest survivor
+        std::vector<size_t> failing;
+        for (size_t s = 0; s < report.scenarios.size(); s++) {
+            if (report.outcomes[a][s].overflows()) failing.push_back(s);
+        }
+        const auto& outcomes = report.outcomes[a];
+        std::sort(failing.begin(), failing.end(), [&outcomes](size_t x, size_t y) {
+            if (outcomes[x].unplacedLoad != outcomes[y].unplacedLoad) {
+                return outcomes[x].unplacedLoad > outcomes[y].unplacedLoad;
+            }
+            return outcomes[x].peakUtilization > outcomes[y].peakUtilization;
+        });
+
+        for (size_t i = 0; i < failing.size() && i < maxListed; i++) {
+            const ScenarioOutcome& outcome = outcomes[failing[i]];
+            ss << "  - " << describe(report.scenarios[failing[i]]) << ": " << outcome.unplacedLoad
+               << " unplaced, " << outcome.overloadedServers << " over capacity, peak "
+               << std::setprecision(1) << outcome.peakUtilization << "%" << std::endl;
+        }
+    }
+
+    ss << "========================" << std::endl;
+    return ss.str();
+}
@@ -0,0 +1,143 @@
+// fairness_metrics.cpp
+#include "include/fairness_metrics.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+// Running sums drift as values are added and subtracted; they are recomputed
+// from the stored entries this often, which keeps the amortized cost O(log n)
+const int kResyncInterval = 65536;
+}
+
+FairnessTracker::FairnessTracker()
+    : sum(0.0),
+      sumSquares(0.0),
+      weightTotal(0.0),
+      weightedSum(0.0),
+      weightedSquares(0.0),
+      rankWeightedSum(0.0),
+      updatesSinceResync(0) {
+}
+
+void FairnessTracker::track(int serverId, const Entry& entry) {
+    double u = entry.utilization;
+    int below;
+    double belowSum;
+    sorted.prefix(u, serverId, below, belowSum);
+    int rank = below + 1;
+    double above = sorted.total() - belowSum;
+
+    // Everything above the new entry moves up one rank
+    rankWeightedSum += rank * u + above;
+    sorted.insert(u, serverId);
+
+    sum += u;
+    sumSquares += u * u;
+    weightTotal += entry.weight;
+    weightedSum += entry.weight * u;
+    weightedSquares += entry.weight * u * u;
+}
+
+void FairnessTracker::untrack(int serverId, const Entry& entry) {
+    double u = entry.utilization;
+    int below;
+    double belowSum;
+    sorted.prefix(u, serverId, below, belowSum);
+    int rank = below + 1;
+    double above = sorted.total() - belowSum - u;
+
+    rankWeightedSum -= rank * u + above;
+    sorted.erase(u, serverId);
+
+    sum -= u;
+    sumSquares -= u * u;
+    weightTotal -= entry.weight;
+    weightedSum -= entry.weight * u;
+    weightedSquares -= entry.weight * u * u;
+}
+
+void FairnessTracker::resync() {
+    sum = sumSquares = weightTotal = weightedSum = weightedSquares = 0.0;
+    for (const auto& pair : entries) {
+        const Entry& entry = pair.second;
+        if (!entry.tracked) continue;
+        sum += entry.utilization;
+        sumSquares += entry.utilization * entry.utilization;
+        weightTotal += entry.weight;
+        weightedSum += entry.weight * entry.utilization;
+        weightedSquares += entry.weight * entry.utilization * entry.utilization;
+    }
+
+    rankWeightedSum = 0.0;
+    double rank = 1.0;
+    sorted.forEach([this, &rank](double value, int) {
+        rankWeightedSum += rank * value;
+        rank += 1.0;
+    });
+    updatesSinceResync = 0;
+}
+
+void FairnessTracker::update(int serverId, int load, int capacity, double performanceMultiplier, bool online) {
+    Entry next;
+    next.weight = capacity * performanceMultiplier;
+    next.tracked = online && next.weight > 0.0;
+    next.utilization = next.tracked ? 100.0 * load / next.weight : 0.0;
+
+    auto it = entries.find(serverId);
+    if (it != entries.end()) {
+        if (it->second.tracked) untrack(serverId, it->second);
+        it->second = next;
+    } else {
+        entries.emplace(serverId, next);
+    }
+    if (next.tracked) track(serverId, next);
+
+    if (++updatesSinceResync >= kResyncInterval) {
+        resync();
+    }
+}
+
+void FairnessTracker::remove(int serverId) {
+    auto it = entries.find(serverId);
+    if (it == entries.end()) return;
+    if (it->second.tracked) untrack(serverId, it->second);
+    entries.erase(it);
+}
+
+void FairnessTracker::clear() {
+    entries.clear();
+    sorted.clear();
+    sum = sumSquares = weightTotal = weightedSum = weightedSquares = rankWeightedSum = 0.0;
+    updatesSinceResync = 0;
+}
+
+FairnessSnapshot FairnessTracker::snapshot() const {
+    FairnessSnapshot result = {sorted.size(), 1.0, 1.0, 0.0, 0.0};
+    int n = result.servers;
+    if (n == 0) return result;
+
+    // An idle fleet counts as perfectly balanced
+    if (sum > 0.0 && sumSquares > 0.0) {
+        double mean = sum / n;
+        result.jainIndex = std::min(1.0, (sum * sum) / (n * sumSquares));
+        result.maxMeanRatio = sorted.maxValue() / mean;
+        result.gini = std::max(0.0, (2.0 * rankWeightedSum) / (n * sum) - (n + 1.0) / n);
+    }
+
+    if (weightTotal > 0.0) {
+        double weightedMean = weightedSum / weightTotal;
+        result.weightedVariance = std::max(0.0, weightedSquares / weightTotal - weightedMean * weightedMean);
+    }
+    return result;
+}
+
+std::string FairnessTracker::format(const FairnessSnapshot& snapshot) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3)
+       << "Jain " << snapshot.jainIndex
+       << ", Max/Mean " << snapshot.maxMeanRatio
+       << ", Gini " << snapshot.gini
+       << ", Weighted Variance " << std::setprecision(2) << snapshot.weightedVariance;
+    return ss.str();
+}
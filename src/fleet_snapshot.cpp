@@ -0,0 +1,82 @@
+// fleet_snapshot.cpp
+#include "include/fleet_snapshot.h"
+#include <algorithm>
+
+FleetSnapshot::FleetSnapshot() : table(std::make_shared<ChunkTable>()), count(0) {
+}
+
+FleetChunk& FleetSnapshot::mutableChunk(size_t i) {
+    // use_count() == 1 means no fork can reach this object, so it is safe to write
+    if (table.use_count() > 1) {
+        table = std::make_shared<ChunkTable>(*table);
+    }
+
+    std::shared_ptr<FleetChunk>& slot = (*table)[i / FleetChunk::kSlots];
+    if (slot.use_count() > 1) {
+        slot = std::make_shared<FleetChunk>(*slot);
+    }
+    return *slot;
+}
+
+void FleetSnapshot::add(int id, int capacity, int load, double multiplier, bool isOnline, int zone) {
+    if (count % FleetChunk::kSlots == 0) {
+        if (table.use_count() > 1) {
+            table = std::make_shared<ChunkTable>(*table);
+        }
+        table->push_back(std::make_shared<FleetChunk>());
+    }
+
+    size_t slot = count % FleetChunk::kSlots;
+    FleetChunk& target = mutableChunk(count);
+    target.ids[slot] = id;
+    target.capacities[slot] = capacity;
+    target.loads[slot] = load;
+    target.multipliers[slot] = multiplier;
+    target.online[slot] = isOnline ? 1 : 0;
+    target.zones[slot] = zone;
+    count++;
+}
+
+size_t FleetSnapshot::sharedChunkCount() const {
+    if (table.use_count() > 1) return table->size();
+
+    size_t shared = 0;
+    for (const auto& chunk : *table) {
+        if (chunk.use_count() > 1) shared++;
+    }
+    return shared;
+}
+
+int FleetSnapshot::getAvailableCapacity(size_t i) const {
+    const FleetChunk& source = chunk(i);
+    size_t slot = i % FleetChunk::kSlots;
+    return source.online[slot] ? source.capacities[slot] - source.loads[slot] : 0;
+}
+
+double FleetSnapshot::getEffectiveCapacity(size_t i) const {
+    const FleetChunk& source = chunk(i);
+    size_t slot = i % FleetChunk::kSlots;
+    return source.online[slot] ? source.capacities[slot] * source.multipliers[slot] : 0.0;
+}
+
+void FleetSnapshot::setCurrentLoad(size_t i, int load) {
+    // Skip the copy when nothing changes
+    if (getCurrentLoad(i) == std::max(0, load)) return;
+    mutableChunk(i).loads[i % FleetChunk::kSlots] = std::max(0, load);
+}
+
+void FleetSnapshot::setOnline(size_t i, bool isOnline) {
+    if (this->isOnline(i) == isOnline) return;
+    mutableChunk(i).online[i % FleetChunk::kSlots] = isOnline ? 1 : 0;
+}
+
+void FleetSnapshot::setPerformanceMultiplier(size_t i, double multiplier) {
+    if (getPerformanceMultiplier(i) == multiplier) return;
+    mutableChunk(i).multipliers[i % FleetChunk::kSlots] = multiplier;
+}
+
+void FleetSnapshot::clearLoads() {
+    for (size_t i = 0; i < count; i++) {
+        setCurrentLoad(i, 0);
+    }
+}
@@ -0,0 +1,205 @@
+// huge_pages.cpp
+#include "include/huge_pages.h"
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace {
+
+std::atomic<bool> hugePagesEnabled{false};
+std::atomic<size_t> mappedBytes[3];
+
+// Blocks handed out by the arena keep 16-byte alignment
+const size_t kArenaAlignment = 16;
+
+} // namespace
+
+namespace hugepages {
+
+size_t roundUp(size_t bytes) {
+    if (bytes == 0) bytes = 1;
+    return (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+}
+
+void* allocate(size_t bytes, HugePageBacking* backing) {
+    size_t length = roundUp(bytes);
+
+    if (hugePagesEnabled.load(std::memory_order_relaxed)) {
+        void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            mappedBytes[static_cast<int>(HugePageBacking::HUGETLBFS)] += length;
+            if (backing) *backing = HugePageBacking::HUGETLBFS;
+            return memory;
+        }
+
+        // No reserved pages: over-map, trim to a 2MB boundary and ask for THP
+        void* raw = mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return nullptr;
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+        if (aligned > start) {
+            munmap(raw, aligned - start);
+        }
+        size_t tail = (start + length + kHugePageSize) - (aligned + length);
+        if (tail > 0) {
+            munmap(reinterpret_cast<void*>(aligned + length), tail);
+        }
+
+        memory = reinterpret_cast<void*>(aligned);
+        if (madvise(memory, length, MADV_HUGEPAGE) == 0) {
+            mappedBytes[static_cast<int>(HugePageBacking::TRANSPARENT)] += length;
+            if (backing) *backing = HugePageBacking::TRANSPARENT;
+        } else {
+            mappedBytes[static_cast<int>(HugePageBacking::NORMAL)] += length;
+            if (backing) *backing = HugePageBacking::NORMAL;
+        }
+        return memory;
+    }
+
+    void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+
+    mappedBytes[static_cast<int>(HugePageBacking::NORMAL)] += length;
+    if (backing) *backing = HugePageBacking::NORMAL;
+    return memory;
+}
+
+void release(void* memory, size_t bytes) {
+    if (!memory) return;
+    munmap(memory, roundUp(bytes));
+}
+
+void setEnabled(bool enabled) {
+    hugePagesEnabled.store(enabled);
+}
+
+bool isEnabled() {
+    return hugePagesEnabled.load();
+}
+
+size_t bytesMapped(HugePageBacking backing) {
+    return mappedBytes[static_cast<int>(backing)].load();
+}
+
+std::string formatReport(const TlbBenchmarkReport& report) {
+    const char* backing = report.arenaBacking == HugePageBacking::HUGETLBFS ? "hugetlbfs" :
+                          report.arenaBacking == HugePageBacking::TRANSPARENT ? "THP" : "regular pages";
+    
+    std::stringstream ss;
+    ss << "=== HUGE PAGE BENCHMARK ===" << std::endl;
+    ss << report.servers << " servers, " << report.lookups << " random lookups; arena on "
+       << backing << std::endl;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Regular pages: " << report.normalNsPerLookup << " ns/lookup";
+    if (report.countersAvailable) ss << ", " << report.normalTlbMisses << " dTLB misses";
+    ss << std::endl;
+    ss << "Huge pages:    " << report.hugeNsPerLookup << " ns/lookup";
+    if (report.countersAvailable) ss << ", " << report.hugeTlbMisses << " dTLB misses";
+    ss << std::endl;
+    if (report.countersAvailable && report.normalTlbMisses > 0) {
+        ss << "dTLB misses reduced by "
+           << 100.0 * (1.0 - static_cast<double>(report.hugeTlbMisses) / report.normalTlbMisses) << "%" << std::endl;
+    } else if (!report.countersAvailable) {
+        ss << "dTLB counters unavailable (perf_event_paranoid)" << std::endl;
+    }
+    ss << "===========================" << std::endl;
+    return ss.str();
+}
+
+} // namespace hugepages
+
+HugePageArena::HugePageArena() : cursor(nullptr), remaining(0) {
+}
+
+HugePageArena::~HugePageArena() {
+    for (auto& region : regions) {
+        hugepages::release(region.first, region.second);
+    }
+}
+
+void* HugePageArena::allocate(size_t bytes) {
+    size_t size = (bytes + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto freeList = freeLists.find(size);
+    if (freeList != freeLists.end() && !freeList->second.empty()) {
+        void* memory = freeList->second.back();
+        freeList->second.pop_back();
+        return memory;
+    }
+
+    if (size > remaining) {
+        size_t regionSize = hugepages::roundUp(size);
+        void* region = hugepages::allocate(regionSize);
+        if (!region) throw std::bad_alloc();
+
+        regions.push_back(std::make_pair(static_cast<char*>(region), regionSize));
+        cursor = static_cast<char*>(region);
+        remaining = regionSize;
+    }
+
+    void* memory = cursor;
+    cursor += size;
+    remaining -= size;
+    return memory;
+}
+
+void HugePageArena::deallocate(void* memory, size_t bytes) {
+    size_t size = (bytes + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+    std::lock_guard<std::mutex> lock(mutex);
+    freeLists[size].push_back(memory);
+}
+
+size_t HugePageArena::regionCount() const {
+    return regions.size();
+}
+
+TlbMissCounter::TlbMissCounter() : fd(-1) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+TlbMissCounter::~TlbMissCounter() {
+    if (fd >= 0) close(fd);
+}
+
+bool TlbMissCounter::available() const {
+    return fd >= 0;
+}
+
+void TlbMissCounter::start() {
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t TlbMissCounter::stop() {
+    if (fd < 0) return 0;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
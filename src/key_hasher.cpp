@@ -0,0 +1,235 @@
+// key_hasher.cpp
+#include "include/key_hasher.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define KEY_HASHER_AVX2 1
+#endif
+
+namespace {
+
+const uint64_t kSecret0 = 0xA0761D6478BD642FULL;
+const uint64_t kSecret1 = 0xE7037ED1A0B428DBULL;
+const uint64_t kSecret2 = 0x8EBC6AF09C88C6E3ULL;
+const uint64_t kSecret3 = 0x589965CC75374CC3ULL;
+
+inline void mum128(uint64_t& a, uint64_t& b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+    mum128(a, b);
+    return a ^ b;
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read3(const uint8_t* p, size_t k) {
+    return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+}
+
+#ifdef KEY_HASHER_AVX2
+// Low 64 bits of a 64x64 multiply from three 32x32->64 multiplies (AVX2 has no vpmullq)
+__attribute__((target("avx2")))
+inline __m256i mullo64(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+    __m256i cross2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+    __m256i cross = _mm256_slli_epi64(_mm256_add_epi64(cross1, cross2), 32);
+    return _mm256_add_epi64(lo, cross);
+}
+
+__attribute__((target("avx2")))
+size_t hashIntBatchAvx2(uint64_t seed, const uint64_t* keys, uint64_t* out, size_t count) {
+    const __m256i offset = _mm256_set1_epi64x(static_cast<long long>(seed * 0x9E3779B97F4A7C15ULL));
+    const __m256i m1 = _mm256_set1_epi64x(static_cast<long long>(0xBF58476D1CE4E5B9ULL));
+    const __m256i m2 = _mm256_set1_epi64x(static_cast<long long>(0x94D049BB133111EBULL));
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i z = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        z = _mm256_add_epi64(z, offset);
+        z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), m1);
+        z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), m2);
+        z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), z);
+    }
+    return i;
+}
+
+bool cpuHasAvx2() {
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+} // namespace
+
+uint64_t KeyHasher::hashBytes(const void* data, size_t length) const {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t s = seed ^ mix(seed ^ kSecret0, kSecret1);
+    uint64_t a;
+    uint64_t b;
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t shift = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = read3(p, length);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t remaining = length;
+        if (remaining > 48) {
+            uint64_t s1 = s;
+            uint64_t s2 = s;
+            do {
+                s = mix(read64(p) ^ kSecret1, read64(p + 8) ^ s);
+                s1 = mix(read64(p + 16) ^ kSecret2, read64(p + 24) ^ s1);
+                s2 = mix(read64(p + 32) ^ kSecret3, read64(p + 40) ^ s2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            s ^= s1 ^ s2;
+        }
+        while (remaining > 16) {
+            s = mix(read64(p) ^ kSecret1, read64(p + 8) ^ s);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    a ^= kSecret1;
+    b ^= s;
+    mum128(a, b);
+    return mix(a ^ kSecret0 ^ length, b ^ kSecret1);
+}
+
+uint64_t KeyHasher::hashString(const std::string& key) const {
+    return hashBytes(key.data(), key.size());
+}
+
+void KeyHasher::hashIntBatch(const uint64_t* keys, uint64_t* out, size_t count) const {
+    size_t done = 0;
+
+#ifdef KEY_HASHER_AVX2
+    if (cpuHasAvx2()) {
+        done = hashIntBatchAvx2(seed, keys, out, count);
+    }
+#endif
+
+    // Tail (and the whole batch without AVX2)
+    for (size_t i = done; i < count; i++) {
+        out[i] = hashInt(keys[i]);
+    }
+}
+
+void KeyHasher::hashStringBatch(const std::vector<std::string>& keys, std::vector<uint64_t>& out) const {
+    out.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        out[i] = hashBytes(keys[i].data(), keys[i].size());
+    }
+}
+
+std::vector<HashBatchTiming> KeyHasher::benchmark(const std::vector<size_t>& batchSizes, size_t keysPerSize) const {
+    keysPerSize = std::max<size_t>(1, keysPerSize);
+    std::vector<uint64_t> intKeys(keysPerSize);
+    std::vector<std::string> stringKeys(keysPerSize);
+    for (size_t i = 0; i < keysPerSize; i++) {
+        intKeys[i] = 0x0A000000ULL + i * 2654435761ULL % 0xFFFFFF;
+        stringKeys[i] = "/api/v1/sessions/" + std::to_string(i * 7919);
+    }
+    std::vector<uint64_t> out(keysPerSize);
+    std::vector<uint64_t> stringOut;
+    uint64_t sink = 0;
+
+    auto nsPerKey = [keysPerSize](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+               keysPerSize;
+    };
+
+    std::vector<HashBatchTiming> timings;
+    for (size_t size : batchSizes) {
+        size = std::max<size_t>(1, std::min(size, keysPerSize));
+        HashBatchTiming timing = HashBatchTiming();
+        timing.batchSize = size;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keysPerSize; i++) {
+            out[i] = hashInt(intKeys[i]);
+        }
+        timing.scalarIntNs = nsPerKey(start);
+        sink ^= out[keysPerSize - 1];
+        
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keysPerSize; i += size) {
+            hashIntBatch(intKeys.data() + i, out.data() + i, std::min(size, keysPerSize - i));
+        }
+        timing.batchIntNs = nsPerKey(start);
+        sink ^= out[keysPerSize - 1];
+        
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keysPerSize; i++) {
+            out[i] = hashString(stringKeys[i]);
+        }
+        timing.scalarStringNs = nsPerKey(start);
+        sink ^= out[keysPerSize - 1];
+        
+        // Batches are handed over as vectors, as a burst's keys would be collected
+        std::vector<std::vector<std::string>> stringBatches;
+        for (size_t i = 0; i < keysPerSize; i += size) {
+            stringBatches.emplace_back(stringKeys.begin() + i, stringKeys.begin() + std::min(keysPerSize, i + size));
+        }
+        start = std::chrono::steady_clock::now();
+        for (const auto& batch : stringBatches) {
+            hashStringBatch(batch, stringOut);
+            sink ^= stringOut.back();
+        }
+        timing.batchStringNs = nsPerKey(start);
+        
+        timings.push_back(timing);
+    }
+
+    volatile uint64_t keep = sink;
+    (void)keep;
+    return timings;
+}
+
+std::string KeyHasher::formatReport(const std::vector<HashBatchTiming>& timings) {
+    std::stringstream ss;
+    ss << "=== KEY HASHING BENCHMARK (ns per key) ===" << std::endl;
+    ss << std::left << std::setw(8) << "Batch" << std::right << std::setw(12) << "int scalar"
+       << std::setw(12) << "int batch" << std::setw(12) << "str scalar" << std::setw(12) << "str batch" << std::endl;
+    ss << std::fixed << std::setprecision(2);
+    for (const auto& timing : timings) {
+        ss << std::left << std::setw(8) << timing.batchSize << std::right
+           << std::setw(12) << timing.scalarIntNs << std::setw(12) << timing.batchIntNs
+           << std::setw(12) << timing.scalarStringNs << std::setw(12) << timing.batchStringNs << std::endl;
+    }
+    ss << "==========================================" << std::endl;
+    return ss.str();
+}
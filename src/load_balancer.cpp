@@ -1,5 +1,22 @@
 // load_balancer.cpp
 #include "include/load_balancer.h"
+#include "include/subsetting.h"
+#include "include/request_tracer.h"
+#include "include/trace_event_writer.h"
+#include "include/server_health.h"
+#include "include/sampling_profiler.h"
+#include "include/huge_pages.h"
+#include "include/numa_placement.h"
+#include "include/load_monitor.h"
+#include "include/tenant_quota.h"
+#include "include/shuffle_sharding.h"
+#include "include/placement_engine.h"
+#include "include/failure_analysis.h"
+#include "include/operation_journal.h"
+#include "include/tls_termination.h"
+#include "include/udp_forwarder.h"
+#include "include/connection_table.h"
+#include "include/connection_pool.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -8,15 +25,116 @@
 #include <thread>
 #include <chrono>
 #include <limits>
+#include <numeric>
 
 // Uncomment these when you want to use the optional modules
-// #include "monitoring.h"
-// #include "server_health.h"
 // #include "load_pattern.h"
 
+// Timeline track ids
+namespace {
+const int kBalancerTrack = 1;
+const int kHealthTrack = 2;
+
+// Stream with no buffer: formatted output is dropped without being rendered
+std::ostream nullStream(nullptr);
+
+// Power drawn by an online server with no load, as a fraction of its idle draw
+// (the server drops into a low-power state once its work is done)
+const double kSleepPowerFraction = 0.1;
+
+// Fleets larger than this are summarized in visualizeLoads instead of drawn
+// one bar per server
+const size_t kDetailedViewServers = 32;
+const int kSummaryServersShown = 5;   // per end of the utilization order
+
+void drawServerBar(std::ostream& ss, const Server& server) {
+    const int barWidth = 40; // Maximum width of the load bar
+    
+    ss << "Server #" << std::setw(2) << server.getId() << " ";
+    
+    // Add status indicator
+    if (!server.isOnline()) {
+        ss << "[OFFLINE] ";
+    } else {
+        ss << "[" << server.getStatus() << "] ";
+    }
+    
+    // Calculate load percentage and bar length
+    double percentage = server.getLoadPercentage();
+    int loadBarLength = static_cast<int>((percentage / 100.0) * barWidth);
+    
+    // Draw the load bar
+    ss << "[";
+    for (int i = 0; i < barWidth; i++) {
+        if (i < loadBarLength) {
+            ss << "#";
+        } else {
+            ss << " ";
+        }
+    }
+    
+    ss << "] " << std::fixed << std::setprecision(1) << percentage << "%" 
+       << " (" << server.getCurrentLoad() << "/" << server.getCapacity() << ")" << std::endl;
+}
+
+// Placement engine adapter over live servers
+class ServerPoolFleet {
+private:
+    const std::vector<std::shared_ptr<Server>>& pool;
+    const ConnectionPoolManager* connectionPools;
+
+public:
+    explicit ServerPoolFleet(const std::vector<std::shared_ptr<Server>>& pool,
+                             const ConnectionPoolManager* connectionPools = nullptr)
+        : pool(pool), connectionPools(connectionPools) {}
+    
+    size_t size() const { return pool.size(); }
+    bool isOnline(size_t i) const { return pool[i]->isOnline(); }
+    int getCurrentLoad(size_t i) const { return pool[i]->getCurrentLoad(); }
+    void setCurrentLoad(size_t i, int load) { pool[i]->setCurrentLoad(load); }
+    int getAvailableCapacity(size_t i) const {
+        // No connection to send a request on means no capacity, whatever the load
+        if (connectionPools && connectionPools->getHeadroom(pool[i]->getId()) == 0) return 0;
+        return pool[i]->getAvailableCapacity();
+    }
+    double getEffectiveCapacity(size_t i) const { return pool[i]->getEffectiveCapacity(); }
+};
+
+// Placement engine adapter over a stand-in fleet behind its own connection pools;
+// lastPlaced is the index of the latest load increase
+class PooledSnapshotFleet {
+private:
+    FleetSnapshot& fleet;
+    const ConnectionPoolManager& pools;
+
+public:
+    int lastPlaced;
+    
+    PooledSnapshotFleet(FleetSnapshot& fleet, const ConnectionPoolManager& pools)
+        : fleet(fleet), pools(pools), lastPlaced(-1) {}
+    
+    size_t size() const { return fleet.size(); }
+    bool isOnline(size_t i) const { return fleet.isOnline(i); }
+    int getCurrentLoad(size_t i) const { return fleet.getCurrentLoad(i); }
+    void setCurrentLoad(size_t i, int load) {
+        if (load > fleet.getCurrentLoad(i)) lastPlaced = static_cast<int>(i);
+        fleet.setCurrentLoad(i, load);
+    }
+    int getAvailableCapacity(size_t i) const {
+        if (pools.getHeadroom(fleet.getId(i)) == 0) return 0;
+        return fleet.getAvailableCapacity(i);
+    }
+    double getEffectiveCapacity(size_t i) const { return fleet.getEffectiveCapacity(i); }
+};
+
+const int kUpstreamAttempts = 10000;   // per benchmark request before it counts as failed
+}
+
 // Server implementation
 Server::Server(int id, int capacity) 
-    : id(id), capacity(capacity), currentLoad(0), performanceMultiplier(1.0), online(true), status("HEALTHY") {
+    : id(id), capacity(capacity), currentLoad(0), performanceMultiplier(1.0), online(true), status("HEALTHY"),
+      costPerUnit(1.0), idlePowerWatts(100.0), peakPowerWatts(200.0), zone(0),
+      observer(nullptr) {
 }
 
 int Server::getId() const {
@@ -44,31 +162,97 @@ std::string Server::getStatus() const {
 }
 
 void Server::setCapacity(int capacity) {
+    int oldCapacity = this->capacity;
     this->capacity = capacity;
+    if (observer && oldCapacity != capacity) {
+        observer->onCapacityChanged(*this, oldCapacity);
+    }
 }
 
 void Server::setCurrentLoad(int load) {
+    int oldLoad = this->currentLoad;
     this->currentLoad = load;
     if (this->currentLoad < 0) {
         this->currentLoad = 0;
     }
+    if (observer && oldLoad != this->currentLoad) {
+        observer->onLoadChanged(*this, oldLoad);
+    }
 }
 
 void Server::setPerformanceMultiplier(double multiplier) {
+    double oldMultiplier = this->performanceMultiplier;
     this->performanceMultiplier = multiplier;
     if (this->performanceMultiplier < 0.0) {
         this->performanceMultiplier = 0.0;
     } else if (this->performanceMultiplier > 1.0) {
         this->performanceMultiplier = 1.0;
     }
+    if (observer && oldMultiplier != this->performanceMultiplier) {
+        observer->onPerformanceChanged(*this, oldMultiplier);
+    }
 }
 
 void Server::setOnline(bool online) {
+    bool changed = this->online != online;
     this->online = online;
+    if (observer && changed) {
+        observer->onOnlineChanged(*this);
+    }
 }
 
 void Server::setStatus(const std::string& status) {
+    std::string oldStatus = this->status;
     this->status = status;
+    if (observer && oldStatus != this->status) {
+        observer->onStatusChanged(*this, oldStatus);
+    }
+}
+
+void Server::setCostModel(double costPerUnit, double idlePowerWatts, double peakPowerWatts) {
+    this->costPerUnit = std::max(0.0, costPerUnit);
+    this->idlePowerWatts = std::max(0.0, idlePowerWatts);
+    this->peakPowerWatts = std::max(this->idlePowerWatts, peakPowerWatts);
+}
+
+void Server::setZone(int zone) {
+    this->zone = zone;
+}
+
+int Server::getZone() const {
+    return zone;
+}
+
+void Server::setObserver(ServerObserver* observer) {
+    this->observer = observer;
+}
+
+double Server::getCostPerUnit() const {
+    return costPerUnit;
+}
+
+double Server::getIdlePowerWatts() const {
+    return idlePowerWatts;
+}
+
+double Server::getPeakPowerWatts() const {
+    return peakPowerWatts;
+}
+
+double Server::getHourlyCost() const {
+    return costPerUnit * currentLoad;
+}
+
+double Server::getPowerDraw() const {
+    if (!online) return 0.0;
+    if (currentLoad == 0) return idlePowerWatts * kSleepPowerFraction;
+    
+    double utilization = std::min(1.0, static_cast<double>(currentLoad) / std::max(1, capacity));
+    return idlePowerWatts + (peakPowerWatts - idlePowerWatts) * utilization;
+}
+
+double Server::getMarginalPowerPerUnit() const {
+    return (peakPowerWatts - idlePowerWatts) / std::max(1, capacity);
 }
 
 int Server::getAvailableCapacity() const {
@@ -87,35 +271,101 @@ double Server::getLoadPercentage() const {
 }
 
 // LoadBalancer implementation
-LoadBalancer::LoadBalancer() 
+LoadBalancer::LoadBalancer(int initialServers, int serverCapacity, bool verbose) 
     : currentAlgorithm(BalancingAlgorithm::ROUND_ROBIN), 
       nextServerId(1),
       randomLoadAmount(10),
-      rng(std::random_device{}()) {
+      rng(std::random_device{}()),
+      verbose(verbose),
+      placingTenant(-1),
+      placementOverride(nullptr),
+      flowCursor(0),
+      capturingFlow(false),
+      flowPlacedServer(-1),
+      connectionBackendsDirty(true),
+      costObjective(CostObjective::PRICE),
+      utilizationSlo(80.0),
+      costIndexPool(nullptr),
+      costIndexDirty(true),
+      failover(false),
+      pendingFailover(0),
+      admissionCeiling(0.0),
+      safetyCheckInterval(0),
+      placementsSinceCheck(0),
+      safetyAlgorithm(BalancingAlgorithm::ROUND_ROBIN),
+      safetyStopping(false),
+      journalFloor(0),
+      fleetLoad(0),
+      fleetCapacity(0),
+      degradedServers(0) {
     
     // Initialize with a few servers
-    for (int i = 0; i < 3; ++i) {
-        addServer();
+    servers.reserve(initialServers);
+    for (int i = 0; i < initialServers; ++i) {
+        addServer(serverCapacity);
     }
     
     lastOperationTime = std::chrono::system_clock::now();
 }
 
 LoadBalancer::~LoadBalancer() {
-    // Clean up if needed
+    stopSafetyThread();
+}
+
+std::ostream& LoadBalancer::console() const {
+    return verbose ? std::cout : nullStream;
+}
+
+void LoadBalancer::setVerbose(bool verboseOutput) {
+    verbose = verboseOutput;
+}
+
+std::shared_ptr<Server> LoadBalancer::createServer(int id, int capacity) {
+    bool hugePages = hugepages::isEnabled();
+    if (hugePages && !serverArena) {
+        serverArena = std::make_shared<HugePageArena>();
+    }
+    auto server = hugePages ? 
+                  std::allocate_shared<Server>(ArenaAllocator<Server>(serverArena), id, capacity) :
+                  std::make_shared<Server>(id, capacity);
+    server->setObserver(this);
+    serversById[id] = server;
+    fleetCapacity += server->getCapacity();
+    indexServer(*server);
+    connectionBackendsDirty = true;
+    if (connectionPools) {
+        connectionPools->addServer(id);
+    }
+    return server;
 }
 
 void LoadBalancer::addServer(int capacity) {
-    auto server = std::make_shared<Server>(nextServerId++, capacity);
+    auto server = createServer(nextServerId++, capacity);
     servers.push_back(server);
+    if (journal) {
+        journal->append(JournalOp::ADD_SERVER, server->getId(), 0, capacity);
+    }
+    refreshSubset(false);
+    tenantShards.clear();
+    costIndexDirty = true;
     
     // Notify health simulator if attached
     if (healthSimulator) {
-        // This would be implemented if you include the health simulator header
-        // healthSimulator->addServer(server->getId());
+        healthSimulator->addServer(server->getId());
+    }
+    
+    if (monitor) {
+        monitor->logServerAddition();
+    }
+    
+    if (timeline) {
+        timeline->instant("scale_out", "scaling", kBalancerTrack,
+                          "{\"server\":" + std::to_string(server->getId()) + 
+                          ",\"capacity\":" + std::to_string(capacity) + "}");
+        emitLoadCounters();
     }
     
-    std::cout << "Server #" << server->getId() << " added with capacity " << capacity << std::endl;
+    console() << "Server #" << server->getId() << " added with capacity " << capacity << std::endl;
 }
 
 bool LoadBalancer::removeServer(int serverId) {
@@ -125,429 +375,1811 @@ bool LoadBalancer::removeServer(int serverId) {
                           });
     
     if (it == servers.end()) {
-        std::cout << "Server #" << serverId << " not found" << std::endl;
+        console() << "Server #" << serverId << " not found" << std::endl;
         return false;
     }
     
     // Redistribute load from the server being removed
     int loadToRedistribute = (*it)->getCurrentLoad();
+    (*it)->setObserver(nullptr);
+    unindexServer(**it);
+    if (journal) {
+        journal->append(JournalOp::REMOVE_SERVER, serverId, (*it)->getCapacity(), 0);
+    }
     
     // Remove server
     servers.erase(it);
+    refreshSubset(false);
+    tenantShards.clear();
+    costIndexDirty = true;
     
     // Notify health simulator if attached
     if (healthSimulator) {
-        // This would be implemented if you include the health simulator header
-        // healthSimulator->removeServer(serverId);
+        healthSimulator->removeServer(serverId);
+    }
+    
+    if (monitor) {
+        monitor->logServerRemoval();
+    }
+    
+    if (timeline) {
+        timeline->instant("scale_in", "scaling", kBalancerTrack,
+                          "{\"server\":" + std::to_string(serverId) + 
+                          ",\"load\":" + std::to_string(loadToRedistribute) + "}");
+        emitLoadCounters();
     }
     
-    std::cout << "Server #" << serverId << " removed" << std::endl;
+    console() << "Server #" << serverId << " removed" << std::endl;
     
     // Redistribute load if there are servers remaining
     if (!servers.empty() && loadToRedistribute > 0) {
-        std::cout << "Redistributing " << loadToRedistribute << " load units..." << std::endl;
+        console() << "Redistributing " << loadToRedistribute << " load units..." << std::endl;
         addSystemLoad(loadToRedistribute);
     }
     
     return true;
 }
 
+std::shared_ptr<Server> LoadBalancer::findServer(int serverId) const {
+    auto it = serversById.find(serverId);
+    return it != serversById.end() ? it->second : nullptr;
+}
+
 std::shared_ptr<Server> LoadBalancer::getServer(int serverId) {
-    auto it = std::find_if(servers.begin(), servers.end(),
-                          [serverId](const std::shared_ptr<Server>& s) { 
-                              return s->getId() == serverId; 
-                          });
+    return findServer(serverId);
+}
+
+const std::vector<std::shared_ptr<Server>>& LoadBalancer::getServers() const {
+    return servers;
+}
+
+const std::vector<std::shared_ptr<Server>>& LoadBalancer::getPlacementServers() const {
+    if (placementOverride) return *placementOverride;
+    return subsetter ? subsetServers : servers;
+}
+
+void LoadBalancer::refreshSubset(bool fullRecompute) {
+    connectionBackendsDirty = true;
+    if (!subsetter) return;
     
-    if (it != servers.end()) {
-        return *it;
+    std::vector<int> ids;
+    ids.reserve(servers.size());
+    for (auto& server : servers) {
+        ids.push_back(server->getId());
     }
     
-    return nullptr;
+    subsetIds = fullRecompute ? subsetter->computeSubset(ids)
+                              : subsetter->updateSubset(subsetIds, ids);
+    
+    subsetServers.clear();
+    subsetServers.reserve(subsetIds.size());
+    subsetTotals = PoolTotals();
+    for (auto& server : servers) {
+        if (std::binary_search(subsetIds.begin(), subsetIds.end(), server->getId())) {
+            subsetServers.push_back(server);
+            const PoolTotals& share = serverShares[server->getId()];
+            subsetTotals.capacity += share.capacity;
+            subsetTotals.load += share.load;
+            subsetTotals.free += share.free;
+        }
+    }
+    costIndexDirty = true;
 }
 
-const std::vector<std::shared_ptr<Server>>& LoadBalancer::getServers() const {
-    return servers;
+int LoadBalancer::distributeLoadRoundRobin(int loadAmount) {
+    ServerPoolFleet fleet(getPlacementServers(), connectionPools.get());
+    return placement::roundRobin(fleet, loadAmount, console());
 }
 
-void LoadBalancer::distributeLoadRoundRobin(int loadAmount) {
-    if (servers.empty()) {
-        std::cout << "No servers available to distribute load" << std::endl;
-        return;
+int LoadBalancer::distributeLoadLeastLoaded(int loadAmount) {
+    ServerPoolFleet fleet(getPlacementServers(), connectionPools.get());
+    return placement::leastLoaded(fleet, loadAmount, console());
+}
+
+int LoadBalancer::distributeLoadWeightedOptimization(int loadAmount) {
+    ServerPoolFleet fleet(getPlacementServers(), connectionPools.get());
+    return placement::weightedOptimization(fleet, loadAmount, console());
+}
+
+double LoadBalancer::marginalCost(const Server& server) const {
+    if (costObjective == CostObjective::PRICE) {
+        return server.getCostPerUnit();
     }
     
-    // Find the first online server
-    size_t startIdx = 0;
-    while (startIdx < servers.size() && !servers[startIdx]->isOnline()) {
-        startIdx++;
+    // Waking an idle server costs its idle draw once, amortized over the load
+    // it can take before hitting the SLO
+    double cost = server.getMarginalPowerPerUnit();
+    if (server.getCurrentLoad() == 0) {
+        int headroom = std::max(1, sloHeadroom(server));
+        cost += server.getIdlePowerWatts() * (1.0 - kSleepPowerFraction) / headroom;
+    }
+    return cost;
+}
+
+int LoadBalancer::sloHeadroom(const Server& server) const {
+    if (!server.isOnline() || poolExhausted(server.getId())) return 0;
+    int sloLoad = static_cast<int>(server.getEffectiveCapacity() * utilizationSlo / 100.0);
+    return std::min(sloLoad, server.getCapacity()) - server.getCurrentLoad();
+}
+
+void LoadBalancer::rebuildCostIndex() {
+    const auto& pool = getPlacementServers();
+    
+    costIndex.clear();
+    costIndexEntries.clear();
+    costIndexPool = &pool;
+    costIndexDirty = false;
+    for (auto& server : pool) {
+        updateCostIndex(*server);
     }
+}
+
+void LoadBalancer::updateCostIndex(const Server& server) {
+    // A dirty index is rebuilt before its next use
+    if (costIndexDirty || !costIndexPool) return;
     
-    if (startIdx >= servers.size()) {
-        std::cout << "No online servers available" << std::endl;
+    eraseCostIndexEntry(server.getId());
+    if (costIndexPool == &subsetServers &&
+        !std::binary_search(subsetIds.begin(), subsetIds.end(), server.getId())) {
+        return;
+    }
+    if (costIndexPool == placementOverride &&
+        std::none_of(placementOverride->begin(), placementOverride->end(),
+                     [&server](const std::shared_ptr<Server>& s) { return s.get() == &server; })) {
         return;
     }
+    if (sloHeadroom(server) > 0) {
+        double cost = marginalCost(server);
+        costIndex.insert(std::make_pair(cost, server.getId()));
+        costIndexEntries[server.getId()] = cost;
+    }
+}
+
+void LoadBalancer::eraseCostIndexEntry(int serverId) {
+    auto entry = costIndexEntries.find(serverId);
+    if (entry == costIndexEntries.end()) return;
+    costIndex.erase(std::make_pair(entry->second, serverId));
+    costIndexEntries.erase(entry);
+}
+
+int LoadBalancer::distributeLoadCostOptimized(int loadAmount) {
+    const auto& pool = getPlacementServers();
+    
+    if (pool.empty()) {
+        console() << "No servers available to distribute load" << std::endl;
+        return 0;
+    }
     
-    // Start with a static distribution
-    int baseLoadPerServer = loadAmount / servers.size();
-    int remainingLoad = loadAmount % servers.size();
+    // Tenant shards are rebuilt on demand, so an index over one is never reused
+    if (costIndexDirty || costIndexPool != &pool || placementOverride) {
+        rebuildCostIndex();
+    }
     
-    // Distribute base load to all servers
-    for (size_t i = 0; i < servers.size(); i++) {
-        size_t idx = (startIdx + i) % servers.size();
+    int remainingLoad = loadAmount;
+    while (remainingLoad > 0 && !costIndex.empty()) {
+        int serverId = costIndex.begin()->second;
         
-        if (servers[idx]->isOnline()) {
-            int serverLoad = baseLoadPerServer;
-            
-            // Distribute remaining load units one by one
-            if (remainingLoad > 0) {
-                serverLoad++;
-                remainingLoad--;
-            }
-            
-            servers[idx]->setCurrentLoad(servers[idx]->getCurrentLoad() + serverLoad);
+        // Connection pools fill without a server hook, so headroom is checked here
+        auto server = getServer(serverId);
+        int headroom = server ? sloHeadroom(*server) : 0;
+        if (headroom <= 0) {
+            eraseCostIndexEntry(serverId);
+            continue;
         }
+        
+        // Fill up to the SLO: a server's cost only falls as it takes load (a woken
+        // server has paid its idle draw), so it stays the cheapest entry. The load
+        // hook re-keys or drops its entry.
+        int loadToAdd = std::min(remainingLoad, headroom);
+        server->setCurrentLoad(server->getCurrentLoad() + loadToAdd);
+        remainingLoad -= loadToAdd;
+    }
+    
+    if (remainingLoad > 0) {
+        // The SLO cannot be met; spill the rest onto whatever capacity is left
+        console() << "Warning: Utilization SLO of " << utilizationSlo << "% exceeded, spilling " 
+                  << remainingLoad << " load units" << std::endl;
+        remainingLoad -= distributeLoadLeastLoaded(remainingLoad);
+        costIndexDirty = true;
+    }
+    
+    // An index over a tenant shard does not outlive the placement
+    if (placementOverride) {
+        costIndexDirty = true;
     }
+    
+    return loadAmount - remainingLoad;
 }
 
-void LoadBalancer::distributeLoadLeastLoaded(int loadAmount) {
-    if (servers.empty()) {
-        std::cout << "No servers available to distribute load" << std::endl;
-        return;
+void LoadBalancer::rebalanceLoads() {
+    if (timeline) {
+        timeline->begin("rebalance", "balancer", kBalancerTrack);
     }
     
-    // Track remaining load to distribute
-    int remainingLoad = loadAmount;
+    // Only the placement pool is re-placed; with subsetting, load on servers
+    // outside the subset belongs to other clients' placements and stays put
+    int totalLoad = 0;
+    for (auto& server : getPlacementServers()) {
+        totalLoad += server->getCurrentLoad();
+        server->setCurrentLoad(0);
+    }
+    costIndexDirty = true;
     
-    // Keep distributing while there's load and available capacity
-    while (remainingLoad > 0) {
-        // Find server with the most available capacity
-        std::shared_ptr<Server> bestServer = nullptr;
-        int bestAvailableCapacity = -1;
-        
+    // Redistribute total load using current algorithm
+    addSystemLoad(totalLoad);
+    
+    if (timeline) {
+        timeline->end("rebalance", "balancer", kBalancerTrack);
+    }
+    
+    if (monitor) {
+        monitor->logRebalancing();
+    }
+    
+    console() << "Load rebalanced using " << getAlgorithmName() << " algorithm" << std::endl;
+}
+
+double LoadBalancer::calculateLoadVariance() const {
+    // Variance of the online servers' load percentages, from the utilization index
+    return utilizationIndex.variance();
+}
+
+int LoadBalancer::getTotalLoad() const {
+    return fleetLoad;
+}
+
+int LoadBalancer::getTotalCapacity() const {
+    return fleetCapacity;
+}
+
+void LoadBalancer::recordMonitorMetrics(double operationTime) {
+    // First metrics sample is the first use of a lazily created monitor
+    std::shared_ptr<LoadMonitor> activeMonitor = getMonitor();
+    if (!activeMonitor) return;
+    
+    ProfilePhaseScope metricsPhase(ProfilePhase::METRICS);
+    std::vector<int> loads;
+    loads.reserve(servers.size());
+    double hourlyCost = 0.0;
+    double powerWatts = 0.0;
+    for (auto& server : servers) {
+        loads.push_back(server->getCurrentLoad());
+        hourlyCost += server->getHourlyCost();
+        powerWatts += server->getPowerDraw();
+    }
+    activeMonitor->recordMetrics(loads, operationTime, hourlyCost, powerWatts);
+    
+    FairnessSnapshot balance = fairness.snapshot();
+    activeMonitor->recordFairness(balance.jainIndex, balance.maxMeanRatio, balance.gini,
+                                  balance.weightedVariance);
+    
+    if (connectionPools) {
+        ConnectionPoolStats pools = connectionPools->getStats();
+        activeMonitor->recordConnectionPools(pools.reuseRatio(), pools.meanCheckoutUs, pools.maxCheckoutUs,
+                                             pools.streamsPerConnection(), pools.exhaustedPools, pools.exhausted);
+    }
+    
+    if (healthSimulator && healthSimulator->isLoadCoupled()) {
+        int offlineServers = 0;
         for (auto& server : servers) {
-            if (!server->isOnline()) continue;
-            
-            int availableCapacity = server->getAvailableCapacity();
-            if (availableCapacity > bestAvailableCapacity) {
-                bestAvailableCapacity = availableCapacity;
-                bestServer = server;
-            }
+            if (!server->isOnline()) offlineServers++;
         }
         
-        // No more capacity available
-        if (!bestServer || bestAvailableCapacity <= 0) {
-            std::cout << "Warning: Insufficient capacity. " << remainingLoad 
-                      << " load units could not be distributed." << std::endl;
-            break;
-        }
+        double peakTemperature = healthSimulator->isThermalModelEnabled() ? 
+                                 healthSimulator->getPeakTemperature() : 0.0;
+        activeMonitor->recordHealthState(peakTemperature, healthSimulator->getThrottledServerCount(),
+                                         offlineServers);
+    }
+}
+
+void LoadBalancer::advanceHealthModels() {
+    // One tick per placement; never forces a lazily created simulator
+    if (!healthSimulator || !healthSimulator->isLoadCoupled()) return;
+    
+    std::vector<std::pair<int, double>> serverLoads;
+    serverLoads.reserve(servers.size());
+    for (auto& server : servers) {
+        serverLoads.emplace_back(server->getId(), server->getLoadPercentage() / 100.0);
+    }
+    healthSimulator->updateLoadEffects(serverLoads);
+    
+    // Load stranded on servers that went offline during the tick moves to the
+    // survivors, which is how one overloaded server can take down the rest
+    if (pendingFailover > 0) {
+        int orphaned = pendingFailover;
+        pendingFailover = 0;
         
-        // Determine how much load to add to this server
-        int loadToAdd = std::min(remainingLoad, bestAvailableCapacity);
-        bestServer->setCurrentLoad(bestServer->getCurrentLoad() + loadToAdd);
-        remainingLoad -= loadToAdd;
+        int moved = placeLoad(orphaned);
+        console() << "Failover: moved " << moved << " of " << orphaned 
+                  << " load units off offline servers" << std::endl;
+        if (monitor) {
+            monitor->logFailover(moved, orphaned - moved);
+        }
+        if (timeline) {
+            emitLoadCounters();
+        }
     }
 }
 
-void LoadBalancer::distributeLoadWeightedOptimization(int loadAmount) {
-    if (servers.empty()) {
-        std::cout << "No servers available to distribute load" << std::endl;
+double LoadBalancer::measureOperationTime() {
+    auto now = std::chrono::system_clock::now();
+    double elapsed = std::chrono::duration<double, std::milli>(now - lastOperationTime).count();
+    lastOperationTime = now;
+    return elapsed;
+}
+
+void LoadBalancer::addRandomLoad() {
+    addSystemLoad(randomLoadAmount);
+}
+
+void LoadBalancer::addLoadToServer(int serverId, int loadAmount) {
+    ProfilePhaseScope phase(ProfilePhase::DISPATCH);
+    
+    auto server = getServer(serverId);
+    if (!server) {
+        console() << "Server #" << serverId << " not found" << std::endl;
         return;
     }
     
-    // Calculate total effective capacity
-    double totalEffectiveCapacity = 0.0;
-    for (auto& server : servers) {
-        if (server->isOnline()) {
-            totalEffectiveCapacity += server->getEffectiveCapacity();
+    if (!server->isOnline()) {
+        console() << "Server #" << serverId << " is offline" << std::endl;
+        return;
+    }
+    
+    int availableCapacity = server->getAvailableCapacity();
+    if (loadAmount > availableCapacity) {
+        console() << "Warning: Exceeding server capacity. Only " 
+                  << availableCapacity << " load units added." << std::endl;
+        loadAmount = availableCapacity;
+    }
+    
+    if (journal) {
+        journal->append(JournalOp::PLACEMENT, serverId, 0, loadAmount);
+    }
+    server->setCurrentLoad(server->getCurrentLoad() + loadAmount);
+    console() << "Added " << loadAmount << " load units to Server #" << serverId << std::endl;
+    
+    if (timeline) {
+        emitLoadCounters();
+    }
+    
+    advanceHealthModels();
+    if (connectionPools) {
+        connectionPools->maintain();
+    }
+    
+    // Record operation time for monitoring
+    recordMonitorMetrics(measureOperationTime());
+}
+
+int LoadBalancer::addSystemLoad(int loadAmount) {
+    ProfilePhaseScope phase(ProfilePhase::DISPATCH);
+    
+    // Sampled request tracing; unsampled requests only pay for the draw
+    bool traced = tracer && tracer->sample();
+    RequestSpan span;
+    std::vector<int> loadsBefore;
+    if (traced) {
+        beginTrace(span, loadAmount, loadsBefore);
+    }
+    
+    if (journal) {
+        journal->append(JournalOp::PLACEMENT, 0, 0, loadAmount);
+    }
+    
+    console() << "Adding " << loadAmount << " load units using " 
+              << getAlgorithmName() << " algorithm" << std::endl;
+    
+    if (traced) {
+        span.dispatchNs = tracer->nowNs();
+    }
+    
+    int placedLoad = placeLoad(loadAmount);
+    placingTenant = -1;   // failover placed by the health tick below belongs to no tenant
+    
+    if (traced) {
+        finishTrace(span, loadsBefore);
+    }
+    
+    if (timeline) {
+        emitLoadCounters();
+    }
+    
+    advanceHealthModels();
+    if (connectionPools) {
+        connectionPools->maintain();
+    }
+    
+    if (safetyCheckInterval > 0) {
+        reportSafetyCheck();
+        if (++placementsSinceCheck >= safetyCheckInterval) {
+            placementsSinceCheck = 0;
+            runSafetyCheck();
+        }
+    }
+    
+    // Record operation time for monitoring
+    recordMonitorMetrics(measureOperationTime());
+    
+    // Display updated system
+    if (verbose) {
+        std::cout << visualizeLoads() << std::endl;
+    }
+    
+    return placedLoad;
+}
+
+int LoadBalancer::placeLoad(int loadAmount) {
+    if (admissionCeiling > 0.0) {
+        int allowed = admissionAllowance();
+        if (loadAmount > allowed) {
+            console() << "Admission ceiling of " << admissionCeiling << "% reached, shedding " 
+                      << (loadAmount - allowed) << " load units" << std::endl;
+            loadAmount = allowed;
         }
     }
     
-    if (totalEffectiveCapacity <= 0.0) {
-        std::cout << "No effective capacity available" << std::endl;
+    // Distribute load according to current algorithm
+    int placedLoad = 0;
+    switch (currentAlgorithm) {
+        case BalancingAlgorithm::ROUND_ROBIN:
+            placedLoad = distributeLoadRoundRobin(loadAmount);
+            break;
+            
+        case BalancingAlgorithm::LEAST_LOADED:
+            placedLoad = distributeLoadLeastLoaded(loadAmount);
+            break;
+            
+        case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
+            placedLoad = distributeLoadWeightedOptimization(loadAmount);
+            break;
+            
+        case BalancingAlgorithm::COST_OPTIMIZED:
+            placedLoad = distributeLoadCostOptimized(loadAmount);
+            break;
+    }
+    
+    return placedLoad;
+}
+
+int LoadBalancer::admissionAllowance() const {
+    // Load the placement pool can still take under the admission ceiling
+    if (admissionCeiling <= 0.0) return std::numeric_limits<int>::max();
+    PoolTotals totals = getPlacementTotals();
+    return std::max(0, static_cast<int>(totals.capacity * admissionCeiling / 100.0) - totals.load);
+}
+
+int LoadBalancer::getFreePlacementCapacity() const {
+    return getPlacementTotals().free;
+}
+
+int LoadBalancer::addTenantLoad(int tenantId, int loadAmount) {
+    if (!tenantQuotas) {
+        tenantQuotas = std::make_shared<TenantQuotaManager>();
+    }
+    
+    // Free capacity only matters while other tenants hold unused reservations. Those
+    // reservations are fleet-wide, so admission weighs them against the whole pool
+    // even when the tenant is sharded
+    int freeCapacity = 0;
+    if (tenantQuotas->needsFreeCapacity(tenantId)) {
+        freeCapacity = getFreePlacementCapacity();
+    }
+    
+    int admitted = tenantQuotas->admit(tenantId, loadAmount, freeCapacity);
+    if (admitted < loadAmount) {
+        console() << "Tenant #" << tenantId << ": quota admitted " << admitted 
+                  << " of " << loadAmount << " load units" << std::endl;
+    }
+    
+    // With shuffle sharding, placement sees only the tenant's shard
+    if (sharder) {
+        placementOverride = &getTenantShard(tenantId);
+    }
+    
+    placingTenant = tenantId;
+    int placedLoad = (admitted > 0) ? addSystemLoad(admitted) : 0;
+    placingTenant = -1;
+    const TenantQuota* before = tenantQuotas->getQuota(tenantId);
+    int oldUsage = before ? before->usage : 0;
+    tenantQuotas->commit(tenantId, placedLoad, loadAmount - placedLoad);
+    journalTenantUsage(tenantId, oldUsage);
+    placementOverride = nullptr;
+    
+    if (monitor) {
+        const TenantQuota* quota = tenantQuotas->getQuota(tenantId);
+        monitor->recordTenantUtilization(tenantId, quota->usage, quota->reservation, 
+                                         quota->limit, quota->rejected);
+    }
+    
+    return placedLoad;
+}
+
+void LoadBalancer::setTenantQuota(int tenantId, int reservation, int limit) {
+    if (!tenantQuotas) {
+        tenantQuotas = std::make_shared<TenantQuotaManager>();
+    }
+    tenantQuotas->setQuota(tenantId, reservation, limit);
+    console() << "Tenant #" << tenantId << " quota: reservation " << reservation 
+              << ", limit " << (limit > 0 ? std::to_string(limit) : "unlimited") << std::endl;
+}
+
+void LoadBalancer::releaseTenantLoad(int tenantId, int loadAmount) {
+    const TenantQuota* quota = tenantQuotas ? tenantQuotas->getQuota(tenantId) : nullptr;
+    if (!quota || loadAmount <= 0) return;
+    
+    if (journal) {
+        journal->append(JournalOp::PLACEMENT, 0, 0, -loadAmount);
+    }
+    
+    // Units go back through setCurrentLoad so the indexes and totals follow. Load a
+    // rebalance or failover has since moved, or that left with a removed server, is
+    // only released from the quota
+    int remaining = loadAmount;
+    auto placements = tenantPlacements.find(tenantId);
+    if (placements != tenantPlacements.end()) {
+        std::map<int, int>& byServer = placements->second;
+        for (auto it = byServer.begin(); it != byServer.end() && remaining > 0;) {
+            int units = std::min(remaining, it->second);
+            auto server = findServer(it->first);
+            if (server) {
+                server->setCurrentLoad(server->getCurrentLoad() - std::min(units, server->getCurrentLoad()));
+            }
+            remaining -= units;
+            it->second -= units;
+            it = (it->second == 0) ? byServer.erase(it) : std::next(it);
+        }
+        if (byServer.empty()) {
+            tenantPlacements.erase(placements);
+        }
+    }
+    
+    int oldUsage = quota->usage;
+    tenantQuotas->release(tenantId, loadAmount);
+    journalTenantUsage(tenantId, oldUsage);
+    
+    if (monitor) {
+        monitor->recordTenantUtilization(tenantId, quota->usage, quota->reservation, 
+                                         quota->limit, quota->rejected);
+    }
+}
+
+std::shared_ptr<const TenantQuotaManager> LoadBalancer::getTenantQuotas() const {
+    return tenantQuotas;
+}
+
+std::vector<int> LoadBalancer::getShardCandidateIds() const {
+    // Shards are drawn from this instance's subset when subsetting is enabled
+    const auto& base = subsetter ? subsetServers : servers;
+    std::vector<int> ids;
+    ids.reserve(base.size());
+    for (auto& server : base) {
+        ids.push_back(server->getId());
+    }
+    return ids;
+}
+
+const std::vector<std::shared_ptr<Server>>& LoadBalancer::getTenantShard(int tenantId) {
+    auto it = tenantShards.find(tenantId);
+    if (it != tenantShards.end()) {
+        return it->second;
+    }
+    
+    std::vector<int> shardIds = sharder->shardFor(tenantId, getShardCandidateIds());
+    std::vector<std::shared_ptr<Server>> shard;
+    shard.reserve(shardIds.size());
+    for (auto& server : servers) {
+        if (std::binary_search(shardIds.begin(), shardIds.end(), server->getId())) {
+            shard.push_back(server);
+        }
+    }
+    
+    return tenantShards.emplace(tenantId, std::move(shard)).first->second;
+}
+
+void LoadBalancer::enableShuffleSharding(int shardSize) {
+    sharder = std::make_shared<ShuffleSharder>(keyHasher, shardSize);
+    tenantShards.clear();
+    console() << "Shuffle sharding enabled with " << sharder->getShardSize() 
+              << " servers per tenant" << std::endl;
+}
+
+void LoadBalancer::disableShuffleSharding() {
+    sharder.reset();
+    tenantShards.clear();
+    console() << "Shuffle sharding disabled" << std::endl;
+}
+
+void LoadBalancer::enableTlsTermination(size_t cacheShards, size_t cacheCapacity) {
+    tlsTerminator = std::make_shared<TlsTerminator>(cacheShards, cacheCapacity, 300.0, keyHasher);
+    console() << "TLS termination enabled with a " << cacheCapacity << "-session cache in "
+              << cacheShards << " shards" << std::endl;
+}
+
+void LoadBalancer::disableTlsTermination() {
+    tlsTerminator.reset();
+    console() << "TLS termination disabled" << std::endl;
+}
+
+std::shared_ptr<TlsTerminator> LoadBalancer::getTlsTerminator() const {
+    return tlsTerminator;
+}
+
+TlsBenchmarkReport LoadBalancer::benchmarkTls(int clients, int connectionsPerClient, bool tickets,
+                                              unsigned threads) {
+    if (!tlsTerminator) {
+        enableTlsTermination();
+    }
+    
+    // Sessions are pinned to the servers this client routes to
+    std::vector<int> backendIds;
+    for (auto& server : getPlacementServers()) {
+        if (server->isOnline()) backendIds.push_back(server->getId());
+    }
+    
+    bool ticketsWereEnabled = tlsTerminator->areTicketsEnabled();
+    tlsTerminator->setTicketsEnabled(tickets);
+    TlsBenchmarkReport report = tlsTerminator->benchmark(backendIds, clients, connectionsPerClient, 60.0, threads);
+    tlsTerminator->setTicketsEnabled(ticketsWereEnabled);
+    return report;
+}
+
+int LoadBalancer::assignFlow() {
+    std::lock_guard<std::mutex> lock(flowMutex);
+    const auto& pool = getPlacementServers();
+    
+    // The round-robin distributor starts every call at the first online server,
+    // which would pin every single-unit flow there; flows rotate instead
+    if (currentAlgorithm == BalancingAlgorithm::ROUND_ROBIN) {
+        if (admissionAllowance() < 1) return -1;
+        for (size_t i = 0; i < pool.size(); i++) {
+            auto& server = pool[(flowCursor + i) % pool.size()];
+            if (server->getAvailableCapacity() <= 0 || poolExhausted(server->getId())) continue;
+            
+            flowCursor = (flowCursor + i + 1) % pool.size();
+            server->setCurrentLoad(server->getCurrentLoad() + 1);
+            return server->getId();
+        }
+        return -1;
+    }
+    
+    // Other algorithms place the unit as usual; the load hook reports where it went
+    capturingFlow = true;
+    flowPlacedServer = -1;
+    int placed = placeLoad(1);
+    capturingFlow = false;
+    return placed > 0 ? flowPlacedServer : -1;
+}
+
+void LoadBalancer::releaseFlow(int serverId) {
+    std::lock_guard<std::mutex> lock(flowMutex);
+    auto server = findServer(serverId);
+    if (server && server->getCurrentLoad() > 0) {
+        server->setCurrentLoad(server->getCurrentLoad() - 1);
+    }
+}
+
+void LoadBalancer::enableConnectionTracking(size_t maxFlows, uint32_t idleTimeoutSeconds) {
+    connectionTable = std::make_shared<ConnectionTable>(maxFlows, idleTimeoutSeconds, keyHasher);
+    connectionBackendsDirty = true;
+    console() << "Connection tracking enabled for " << connectionTable->getStats().capacity << " flows ("
+              << connectionTable->memoryBytes() / (1024 * 1024) << " MB)" << std::endl;
+}
+
+void LoadBalancer::disableConnectionTracking() {
+    connectionTable.reset();
+    console() << "Connection tracking disabled" << std::endl;
+}
+
+std::shared_ptr<ConnectionTable> LoadBalancer::getConnectionTable() const {
+    return connectionTable;
+}
+
+void LoadBalancer::syncConnectionBackends() {
+    // Weighted by capacity, like the algorithms' view of the pool
+    std::vector<int> ids;
+    std::vector<double> weights;
+    for (auto& server : getPlacementServers()) {
+        if (!server->isOnline()) continue;
+        ids.push_back(server->getId());
+        weights.push_back(server->getCapacity());
+    }
+    connectionTable->setBackends(ids, weights);
+    connectionBackendsDirty = false;
+}
+
+int LoadBalancer::routeConnection(const FlowTuple& flow, bool connectionStart, uint32_t now) {
+    if (!connectionTable) {
+        enableConnectionTracking();
+    }
+    if (connectionBackendsDirty) {
+        syncConnectionBackends();
+    }
+    return connectionTable->route(flow, connectionStart, now);
+}
+
+ConnectionBenchmarkReport LoadBalancer::benchmarkConnectionTable(int flows, int lookups) {
+    std::vector<int> ids;
+    std::vector<double> weights;
+    for (auto& server : getPlacementServers()) {
+        if (!server->isOnline()) continue;
+        ids.push_back(server->getId());
+        weights.push_back(server->getCapacity());
+    }
+    return ConnectionTable::benchmark(ids, weights, flows, lookups, keyHasher);
+}
+
+void LoadBalancer::enableConnectionPools(int minIdle, int maxSize, double maxLifetimeSeconds,
+                                         int maxStreamsPerConnection) {
+    ConnectionPoolOptions options;
+    options.minIdle = minIdle;
+    options.maxSize = maxSize;
+    options.maxLifetimeSeconds = maxLifetimeSeconds;
+    options.maxStreamsPerConnection = maxStreamsPerConnection;
+    
+    connectionPools = std::make_shared<ConnectionPoolManager>(options);
+    for (auto& server : servers) {
+        connectionPools->addServer(server->getId());
+    }
+    costIndexDirty = true;
+    console() << "Connection pools enabled: " << minIdle << " warm, up to " << maxSize 
+              << " connections per server";
+    if (maxStreamsPerConnection > 1) {
+        console() << " with " << maxStreamsPerConnection << " streams each";
+    }
+    console() << std::endl;
+}
+
+void LoadBalancer::disableConnectionPools() {
+    connectionPools.reset();
+    costIndexDirty = true;
+    console() << "Connection pools disabled" << std::endl;
+}
+
+std::shared_ptr<ConnectionPoolManager> LoadBalancer::getConnectionPools() const {
+    return connectionPools;
+}
+
+bool LoadBalancer::poolExhausted(int serverId) const {
+    return connectionPools && connectionPools->getHeadroom(serverId) == 0;
+}
+
+bool LoadBalancer::proxyRequest(PooledConnection& connection) {
+    connection = PooledConnection{-1, -1, false};
+    if (!connectionPools) return false;
+    
+    int serverId = assignFlow();
+    ConnectionPool* pool = serverId >= 0 ? connectionPools->getPool(serverId) : nullptr;
+    if (!pool) {
+        if (serverId >= 0) releaseFlow(serverId);
+        return false;
+    }
+    
+    // Another thread can take the last connection between placement and checkout
+    connection = pool->checkout(connectionPools->now());
+    if (connection.slot < 0) {
+        releaseFlow(serverId);
+        return false;
+    }
+    return true;
+}
+
+void LoadBalancer::finishRequest(const PooledConnection& connection, bool broken) {
+    if (!connectionPools || connection.slot < 0) return;
+    
+    ConnectionPool* pool = connectionPools->getPool(connection.serverId);
+    if (pool) {
+        pool->checkin(connection, connectionPools->now(), broken);
+    }
+    releaseFlow(connection.serverId);
+}
+
+ConnectionPoolStats LoadBalancer::benchmarkConnectionPools(unsigned threads, int requestsPerThread) {
+    if (!connectionPools) {
+        enableConnectionPools();
+    }
+    
+    // Each thread keeps one request in flight at a time
+    threads = std::max(1u, threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([this, requestsPerThread]() {
+            for (int i = 0; i < requestsPerThread; i++) {
+                PooledConnection connection;
+                if (proxyRequest(connection)) {
+                    finishRequest(connection);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    connectionPools->maintain();
+    recordMonitorMetrics(measureOperationTime());
+    return connectionPools->getStats();
+}
+
+UpstreamBenchmarkReport LoadBalancer::benchmarkUpstream(int maxStreamsPerConnection, int clients,
+                                                        int requestsPerClient, double serviceUs, int poolSize) {
+    UpstreamBenchmarkReport report = UpstreamBenchmarkReport();
+    report.clients = std::max(1, clients);
+    report.maxStreamsPerConnection = std::max(1, maxStreamsPerConnection);
+    report.poolSize = std::max(1, poolSize);
+    
+    // Stand-in fleet: the placement pool with no load, behind fresh pools
+    FleetSnapshot fleet;
+    ConnectionPoolOptions options;
+    options.minIdle = 1;
+    options.maxSize = report.poolSize;
+    options.maxStreamsPerConnection = report.maxStreamsPerConnection;
+    ConnectionPoolManager pools(options);
+    for (auto& server : getPlacementServers()) {
+        fleet.add(server->getId(), server->getCapacity(), 0, server->getPerformanceMultiplier(),
+                  server->isOnline(), server->getZone());
+        pools.addServer(server->getId());
+    }
+    PooledSnapshotFleet placementFleet(fleet, pools);
+    
+    // Single units, as assignFlow places them; the cost index only covers live servers
+    std::mutex placementMutex;
+    size_t cursor = 0;
+    std::ostream quiet(nullptr);
+    auto place = [&]() -> int {
+        std::lock_guard<std::mutex> lock(placementMutex);
+        if (currentAlgorithm == BalancingAlgorithm::ROUND_ROBIN) {
+            for (size_t i = 0; i < fleet.size(); i++) {
+                size_t index = (cursor + i) % fleet.size();
+                if (!fleet.isOnline(index) || placementFleet.getAvailableCapacity(index) <= 0) continue;
+                
+                cursor = (index + 1) % fleet.size();
+                fleet.setCurrentLoad(index, fleet.getCurrentLoad(index) + 1);
+                return static_cast<int>(index);
+            }
+            return -1;
+        }
+        
+        placementFleet.lastPlaced = -1;
+        int placed = currentAlgorithm == BalancingAlgorithm::WEIGHTED_OPTIMIZATION ?
+                     placement::weightedOptimization(placementFleet, 1, quiet) :
+                     placement::leastLoaded(placementFleet, 1, quiet);
+        return placed > 0 ? placementFleet.lastPlaced : -1;
+    };
+    auto release = [&](int index) {
+        std::lock_guard<std::mutex> lock(placementMutex);
+        fleet.setCurrentLoad(index, fleet.getCurrentLoad(index) - 1);
+    };
+    
+    std::vector<std::vector<double>> latencies(report.clients);
+    std::atomic<uint64_t> refused(0);
+    std::atomic<int> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int c = 0; c < report.clients; c++) {
+        workers.emplace_back([&, c]() {
+            latencies[c].reserve(std::max(0, requestsPerClient));
+            for (int i = 0; i < requestsPerClient; i++) {
+                auto requested = std::chrono::steady_clock::now();
+                PooledConnection connection = {-1, -1, false};
+                int index = -1;
+                for (int attempt = 0; attempt < kUpstreamAttempts && connection.slot < 0; attempt++) {
+                    index = place();
+                    if (index >= 0) {
+                        connection = pools.getPool(fleet.getId(index))->checkout(pools.now());
+                        if (connection.slot >= 0) break;
+                        release(index);
+                    }
+                    refused.fetch_add(1, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+                if (connection.slot < 0) {
+                    failed.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                
+                // The stand-in backend holds the stream for the service time
+                std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(serviceUs));
+                pools.getPool(connection.serverId)->checkin(connection, pools.now());
+                release(index);
+                
+                double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - requested).count();
+                latencies[c].push_back(connection.reused ? us : us + options.connectLatencyUs);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::vector<double> all;
+    for (auto& client : latencies) {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::sort(all.begin(), all.end());
+    
+    ConnectionPoolStats stats = pools.getStats();
+    report.requests = static_cast<int>(all.size());
+    report.connectionsOpened = stats.created;
+    report.peakConnections = stats.peakConnections;
+    report.refused = refused;
+    report.failed = failed;
+    if (!all.empty()) {
+        report.meanLatencyUs = std::accumulate(all.begin(), all.end(), 0.0) / all.size();
+        report.p99LatencyUs = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+    }
+    report.requestsPerSecond = seconds > 0.0 ? all.size() / seconds : 0.0;
+    return report;
+}
+
+std::vector<int> LoadBalancer::getTenantShardIds(int tenantId) {
+    std::vector<int> ids;
+    if (!sharder) return ids;
+    
+    for (auto& server : getTenantShard(tenantId)) {
+        ids.push_back(server->getId());
+    }
+    return ids;
+}
+
+std::string LoadBalancer::getShardIsolationReport(int poisonedTenant, const std::vector<int>& tenantIds) const {
+    std::stringstream ss;
+    if (!sharder) {
+        ss << "Shuffle sharding is not enabled" << std::endl;
+        return ss.str();
+    }
+    
+    ShardIsolationReport report = sharder->analyzeIsolation(poisonedTenant, tenantIds, getShardCandidateIds());
+    
+    ss << "=== SHARD ISOLATION (poisoned tenant #" << poisonedTenant << ") ===" << std::endl;
+    ss << "Shard Size: " << report.shardSize << std::endl;
+    ss << "Tenants Compared: " << report.tenantCount << std::endl;
+    ss << "Mean Shared Servers: " << std::fixed << std::setprecision(2) << report.meanOverlap << std::endl;
+    ss << "Fully Overlapping Tenants: " << report.fullyOverlapping << std::endl;
+    for (const auto& bucket : report.overlapHistogram) {
+        int remaining = report.shardSize - bucket.first;
+        ss << "  " << bucket.first << " shared (" << remaining << " healthy left): " 
+           << bucket.second << " tenants" << std::endl;
+    }
+    
+    return ss.str();
+}
+
+void LoadBalancer::beginTrace(RequestSpan& span, int loadAmount, std::vector<int>& loadsBefore) const {
+    const auto& pool = getPlacementServers();
+    
+    span.requestId = tracer->newRequestId();
+    span.arrivalNs = tracer->nowNs();
+    span.dispatchNs = span.arrivalNs;
+    span.completionNs = span.arrivalNs;
+    span.algorithm = static_cast<int>(currentAlgorithm);
+    span.loadAmount = loadAmount;
+    span.chosenServerId = -1;
+    span.candidateCount = static_cast<int>(pool.size());
+    span.placementCount = 0;
+    span.threadIndex = 0;
+    
+    double totalEffectiveCapacity = 0.0;
+    if (currentAlgorithm == BalancingAlgorithm::WEIGHTED_OPTIMIZATION) {
+        for (auto& server : pool) {
+            totalEffectiveCapacity += server->getEffectiveCapacity();
+        }
+    }
+    
+    // Score each candidate the way the current algorithm sees it
+    loadsBefore.reserve(pool.size());
+    for (size_t i = 0; i < pool.size(); i++) {
+        loadsBefore.push_back(pool[i]->getCurrentLoad());
+        if (i >= static_cast<size_t>(kMaxTraceCandidates)) continue;
+        
+        double score = 0.0;
+        switch (currentAlgorithm) {
+            case BalancingAlgorithm::ROUND_ROBIN:
+                score = pool[i]->getLoadPercentage();
+                break;
+            case BalancingAlgorithm::LEAST_LOADED:
+                score = pool[i]->getAvailableCapacity();
+                break;
+            case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
+                score = (totalEffectiveCapacity > 0.0) ? 
+                        pool[i]->getEffectiveCapacity() / totalEffectiveCapacity : 0.0;
+                break;
+            case BalancingAlgorithm::COST_OPTIMIZED:
+                score = marginalCost(*pool[i]);
+                break;
+        }
+        span.candidates[i] = {pool[i]->getId(), score};
+    }
+}
+
+void LoadBalancer::finishTrace(RequestSpan& span, const std::vector<int>& loadsBefore) const {
+    const auto& pool = getPlacementServers();
+    
+    int largestShare = 0;
+    for (size_t i = 0; i < pool.size() && i < loadsBefore.size(); i++) {
+        int delta = pool[i]->getCurrentLoad() - loadsBefore[i];
+        if (delta <= 0) continue;
+        
+        if (delta > largestShare) {
+            largestShare = delta;
+            span.chosenServerId = pool[i]->getId();
+        }
+        if (span.placementCount < kMaxTracePlacements) {
+            span.placements[span.placementCount++] = {pool[i]->getId(), delta};
+        }
+    }
+    
+    span.completionNs = tracer->nowNs();
+    tracer->record(span);
+}
+
+void LoadBalancer::setBalancingAlgorithm(BalancingAlgorithm algorithm) {
+    if (journal) {
+        journal->append(JournalOp::SET_ALGORITHM, 0, static_cast<int32_t>(currentAlgorithm), 
+                        static_cast<int32_t>(algorithm));
+    }
+    currentAlgorithm = algorithm;
+    console() << "Switched to " << getAlgorithmName() << " algorithm" << std::endl;
+    
+    if (timeline) {
+        timeline->instant("algorithm", "balancer", kBalancerTrack,
+                          "{\"name\":\"" + getAlgorithmName() + "\"}");
+    }
+    
+    // Update monitor if attached
+    if (monitor) {
+        monitor->setAlgorithm(getAlgorithmName());
+    }
+}
+
+BalancingAlgorithm LoadBalancer::getCurrentAlgorithm() const {
+    return currentAlgorithm;
+}
+
+std::string LoadBalancer::getAlgorithmName() const {
+    if (currentAlgorithm == BalancingAlgorithm::COST_OPTIMIZED) {
+        return costObjective == CostObjective::PRICE ? "Cost Optimized (price)" : "Cost Optimized (energy)";
+    }
+    return algorithmName(currentAlgorithm);
+}
+
+std::string LoadBalancer::algorithmName(BalancingAlgorithm algorithm) {
+    switch (algorithm) {
+        case BalancingAlgorithm::ROUND_ROBIN:
+            return "Round Robin";
+        case BalancingAlgorithm::LEAST_LOADED:
+            return "Least Loaded";
+        case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
+            return "Weighted Optimization";
+        case BalancingAlgorithm::COST_OPTIMIZED:
+            return "Cost Optimized";
+        default:
+            return "Unknown";
+    }
+}
+
+void LoadBalancer::setRandomLoadAmount(int amount) {
+    randomLoadAmount = amount;
+    console() << "Random load amount set to " << randomLoadAmount << std::endl;
+}
+
+int LoadBalancer::getRandomLoadAmount() const {
+    return randomLoadAmount;
+}
+
+void LoadBalancer::setHashSeed(uint64_t seed) {
+    keyHasher = KeyHasher(seed);
+    if (sharder) {
+        sharder = std::make_shared<ShuffleSharder>(keyHasher, sharder->getShardSize());
+        tenantShards.clear();
+    }
+}
+
+const KeyHasher& LoadBalancer::getKeyHasher() const {
+    return keyHasher;
+}
+
+void LoadBalancer::setFailover(bool enabled) {
+    failover = enabled;
+    console() << "Failover of offline servers' load " << (enabled ? "enabled" : "disabled") << std::endl;
+}
+
+void LoadBalancer::setAdmissionCeiling(double utilizationPercent) {
+    admissionCeiling = std::max(0.0, std::min(100.0, utilizationPercent));
+    if (admissionCeiling > 0.0) {
+        console() << "Admission ceiling set to " << admissionCeiling << "% utilization" << std::endl;
+    } else {
+        console() << "Admission ceiling disabled" << std::endl;
+    }
+}
+
+void LoadBalancer::onLoadChanged(const Server& server, int oldLoad) {
+    indexServer(server);
+    fleetLoad += server.getCurrentLoad() - oldLoad;
+    if (capturingFlow && server.getCurrentLoad() > oldLoad) {
+        flowPlacedServer = server.getId();
+    }
+    if (placingTenant >= 0 && server.getCurrentLoad() > oldLoad) {
+        tenantPlacements[placingTenant][server.getId()] += server.getCurrentLoad() - oldLoad;
+    }
+    if (journal) {
+        journal->append(JournalOp::SET_LOAD, server.getId(), oldLoad, server.getCurrentLoad());
+    }
+}
+
+void LoadBalancer::onCapacityChanged(const Server& server, int oldCapacity) {
+    indexServer(server);
+    connectionBackendsDirty = true;
+    if (server.isOnline()) {
+        fleetCapacity += server.getCapacity() - oldCapacity;
+    }
+    if (journal) {
+        journal->append(JournalOp::SET_CAPACITY, server.getId(), oldCapacity, server.getCapacity());
+    }
+}
+
+void LoadBalancer::onPerformanceChanged(const Server& server, double oldMultiplier) {
+    indexServer(server);
+    if (journal) {
+        journal->append(JournalOp::SET_MULTIPLIER, server.getId(), OperationJournal::encodeMultiplier(oldMultiplier),
+                        OperationJournal::encodeMultiplier(server.getPerformanceMultiplier()));
+    }
+}
+
+void LoadBalancer::onOnlineChanged(const Server& server) {
+    indexServer(server);
+    connectionBackendsDirty = true;
+    int sign = server.isOnline() ? 1 : -1;
+    fleetCapacity += sign * server.getCapacity();
+    if (server.getStatus() != "HEALTHY") degradedServers += sign;
+    if (journal) {
+        journal->append(JournalOp::SET_ONLINE, server.getId(), server.isOnline() ? 0 : 1, server.isOnline() ? 1 : 0);
+    }
+}
+
+void LoadBalancer::onStatusChanged(const Server& server, const std::string& oldStatus) {
+    if (journal) {
+        journal->append(JournalOp::SET_STATUS, server.getId(), OperationJournal::encodeStatus(oldStatus),
+                        OperationJournal::encodeStatus(server.getStatus()));
+    }
+    if (!server.isOnline()) return;
+    bool wasDegraded = oldStatus != "HEALTHY";
+    bool isDegraded = server.getStatus() != "HEALTHY";
+    degradedServers += static_cast<int>(isDegraded) - static_cast<int>(wasDegraded);
+}
+
+void LoadBalancer::indexServer(const Server& server) {
+    fairness.update(server.getId(), server.getCurrentLoad(), server.getCapacity(),
+                    server.getPerformanceMultiplier(), server.isOnline());
+    utilizationIndex.update(server.getId(), server.getLoadPercentage(), server.isOnline());
+    updateCostIndex(server);
+    updatePoolTotals(server);
+}
+
+void LoadBalancer::unindexServer(const Server& server) {
+    fairness.remove(server.getId());
+    utilizationIndex.remove(server.getId());
+    eraseCostIndexEntry(server.getId());
+    erasePoolTotals(server.getId());
+    serversById.erase(server.getId());
+    connectionBackendsDirty = true;
+    if (connectionPools) {
+        connectionPools->removeServer(server.getId());
+    }
+    
+    fleetLoad -= server.getCurrentLoad();
+    if (server.isOnline()) {
+        fleetCapacity -= server.getCapacity();
+        if (server.getStatus() != "HEALTHY") degradedServers--;
+    }
+}
+
+void LoadBalancer::updatePoolTotals(const Server& server) {
+    PoolTotals share;
+    if (server.isOnline()) {
+        share.capacity = server.getCapacity();
+        share.load = server.getCurrentLoad();
+        share.free = std::max(0, server.getAvailableCapacity());
+    }
+    
+    PoolTotals& old = serverShares[server.getId()];
+    bool inSubset = subsetter && std::binary_search(subsetIds.begin(), subsetIds.end(), server.getId());
+    for (PoolTotals* totals : {&fleetTotals, inSubset ? &subsetTotals : nullptr}) {
+        if (!totals) continue;
+        totals->capacity += share.capacity - old.capacity;
+        totals->load += share.load - old.load;
+        totals->free += share.free - old.free;
+    }
+    old = share;
+}
+
+void LoadBalancer::erasePoolTotals(int serverId) {
+    auto it = serverShares.find(serverId);
+    if (it == serverShares.end()) return;
+    
+    bool inSubset = subsetter && std::binary_search(subsetIds.begin(), subsetIds.end(), serverId);
+    for (PoolTotals* totals : {&fleetTotals, inSubset ? &subsetTotals : nullptr}) {
+        if (!totals) continue;
+        totals->capacity -= it->second.capacity;
+        totals->load -= it->second.load;
+        totals->free -= it->second.free;
+    }
+    serverShares.erase(it);
+}
+
+LoadBalancer::PoolTotals LoadBalancer::getPlacementTotals() const {
+    if (!placementOverride) {
+        return subsetter ? subsetTotals : fleetTotals;
+    }
+    
+    // Tenant shards are a handful of servers and are summed from their members' shares
+    PoolTotals totals;
+    for (auto& server : *placementOverride) {
+        auto it = serverShares.find(server->getId());
+        if (it == serverShares.end()) continue;
+        totals.capacity += it->second.capacity;
+        totals.load += it->second.load;
+        totals.free += it->second.free;
+    }
+    return totals;
+}
+
+FairnessSnapshot LoadBalancer::getFairnessMetrics() const {
+    return fairness.snapshot();
+}
+
+double LoadBalancer::getUtilizationPercentile(double p) const {
+    return utilizationIndex.percentile(p);
+}
+
+int LoadBalancer::getUtilizationRank(int serverId) const {
+    return utilizationIndex.rankOf(serverId);
+}
+
+int LoadBalancer::getKthMostLoadedServer(int k) const {
+    return utilizationIndex.kthMostLoaded(k);
+}
+
+std::vector<int> LoadBalancer::getMostLoadedServers(int n) const {
+    return utilizationIndex.mostLoaded(n);
+}
+
+void LoadBalancer::journalServerAttributes(const Server& server) {
+    journal->append(JournalOp::SET_STATUS, server.getId(), 0, OperationJournal::encodeStatus(server.getStatus()));
+    journal->append(JournalOp::SET_ZONE, server.getId(), 0, server.getZone());
+    journal->append(JournalOp::SET_COST, server.getId(), OperationJournal::encodeMultiplier(1.0),
+                    OperationJournal::encodeMultiplier(server.getCostPerUnit()));
+    journal->append(JournalOp::SET_IDLE_POWER, server.getId(), OperationJournal::encodeWatts(100.0),
+                    OperationJournal::encodeWatts(server.getIdlePowerWatts()));
+    journal->append(JournalOp::SET_PEAK_POWER, server.getId(), OperationJournal::encodeWatts(200.0),
+                    OperationJournal::encodeWatts(server.getPeakPowerWatts()));
+}
+
+void LoadBalancer::journalTenantUsage(int tenantId, int oldUsage) {
+    const TenantQuota* quota = tenantQuotas->getQuota(tenantId);
+    if (journal && quota && quota->usage != oldUsage) {
+        journal->append(JournalOp::SET_TENANT_USAGE, tenantId, oldUsage, quota->usage);
+    }
+}
+
+void LoadBalancer::attachJournal(std::shared_ptr<OperationJournal> journalObj) {
+    journal = journalObj;
+    journalReplayer = journal ? std::make_shared<JournalReplayer>(*journal) : nullptr;
+    journalFloor = 0;
+    if (!journal || journal->size() > 0) return;
+    
+    // A fresh journal starts from the current fleet so replay can rebuild it
+    journal->append(JournalOp::SET_ALGORITHM, 0, 0, static_cast<int32_t>(currentAlgorithm));
+    for (auto& server : servers) {
+        journal->append(JournalOp::ADD_SERVER, server->getId(), 0, server->getCapacity());
+        journal->append(JournalOp::SET_LOAD, server->getId(), 0, server->getCurrentLoad());
+        journal->append(JournalOp::SET_ONLINE, server->getId(), 1, server->isOnline() ? 1 : 0);
+        journal->append(JournalOp::SET_MULTIPLIER, server->getId(), OperationJournal::encodeMultiplier(1.0),
+                        OperationJournal::encodeMultiplier(server->getPerformanceMultiplier()));
+        journalServerAttributes(*server);
+    }
+    if (tenantQuotas) {
+        for (int tenantId : tenantQuotas->getTenantIds()) {
+            journalTenantUsage(tenantId, 0);
+        }
+    }
+    journalFloor = journal->size();
+}
+
+std::shared_ptr<OperationJournal> LoadBalancer::getJournal() const {
+    return journal;
+}
+
+void LoadBalancer::rewindTo(size_t position) {
+    if (!journal) {
+        console() << "No journal attached" << std::endl;
         return;
     }
     
-    // Calculate ideal load distribution based on capacity ratio
-    std::vector<int> idealLoads(servers.size());
-    int distributedLoad = 0;
+    ReplayState state = journalReplayer->stateAt(position);
     
-    for (size_t i = 0; i < servers.size(); i++) {
-        if (!servers[i]->isOnline()) {
-            idealLoads[i] = 0;
-            continue;
-        }
-        
-        // Calculate proportional load
-        double ratio = servers[i]->getEffectiveCapacity() / totalEffectiveCapacity;
-        int serverIdealLoad = static_cast<int>(ratio * loadAmount);
-        
-        // Ensure we don't exceed capacity
-        int availableCapacity = servers[i]->getAvailableCapacity();
-        if (serverIdealLoad > availableCapacity) {
-            serverIdealLoad = availableCapacity;
+    // Rebuilding must not write to the journal it is reading from
+    std::shared_ptr<OperationJournal> active = std::move(journal);
+    journal = nullptr;
+    
+    // Taken down the way removeServer does, so pools and indexes follow
+    for (auto& server : servers) {
+        server->setObserver(nullptr);
+        unindexServer(*server);
+        if (healthSimulator) {
+            healthSimulator->removeServer(server->getId());
         }
-        
-        idealLoads[i] = serverIdealLoad;
-        distributedLoad += serverIdealLoad;
     }
+    servers.clear();
     
-    // Distribute any remaining load to servers that still have capacity
-    int remainingLoad = loadAmount - distributedLoad;
-    while (remainingLoad > 0) {
-        bool distributed = false;
+    for (const auto& entry : state.servers) {
+        const ReplayedServer& replayed = entry.second;
+        auto server = createServer(entry.first, replayed.capacity);
+        servers.push_back(server);
         
-        for (size_t i = 0; i < servers.size() && remainingLoad > 0; i++) {
-            if (!servers[i]->isOnline()) continue;
-            
-            int availableCapacity = servers[i]->getAvailableCapacity() - idealLoads[i];
-            if (availableCapacity > 0) {
-                idealLoads[i]++;
-                remainingLoad--;
-                distributed = true;
+        // The simulator's callbacks run first; the replayed attributes then win
+        if (healthSimulator) {
+            healthSimulator->addServer(server->getId());
+            int32_t health = OperationJournal::encodeStatus(replayed.status);
+            if (health > 0) {
+                healthSimulator->setServerState(server->getId(), static_cast<ServerState>(health));
             }
         }
-        
-        if (!distributed) break; // No more capacity
+        server->setStatus(replayed.status);
+        server->setOnline(replayed.online);
+        server->setCurrentLoad(replayed.load);
+        server->setPerformanceMultiplier(replayed.multiplier);
+        server->setZone(replayed.zone);
+        server->setCostModel(replayed.costPerUnit, replayed.idlePowerWatts, replayed.peakPowerWatts);
+        nextServerId = std::max(nextServerId, entry.first + 1);
     }
     
-    // Apply the calculated loads
-    for (size_t i = 0; i < servers.size(); i++) {
-        if (idealLoads[i] > 0) {
-            servers[i]->setCurrentLoad(servers[i]->getCurrentLoad() + idealLoads[i]);
+    if (tenantQuotas) {
+        for (int tenantId : tenantQuotas->getTenantIds()) {
+            auto usage = state.tenantUsage.find(tenantId);
+            tenantQuotas->setUsage(tenantId, usage != state.tenantUsage.end() ? usage->second : 0);
         }
     }
+    currentAlgorithm = state.algorithm;
+    if (monitor) {
+        monitor->setAlgorithm(getAlgorithmName());
+    }
     
-    if (remainingLoad > 0) {
-        std::cout << "Warning: Insufficient capacity. " << remainingLoad 
-                  << " load units could not be distributed." << std::endl;
+    refreshSubset(false);
+    tenantShards.clear();
+    costIndexDirty = true;
+    
+    journal = active;
+    journal->setPosition(state.position);
+    
+    if (timeline) {
+        emitLoadCounters();
     }
+    console() << "Rewound to journal position " << state.position << " of " << journal->size() << std::endl;
 }
 
-void LoadBalancer::rebalanceLoads() {
-    // Calculate total current load
-    int totalLoad = getTotalLoad();
+bool LoadBalancer::undo() {
+    if (!journal || journal->position() <= journalFloor) return false;
     
-    // Reset all server loads to zero
+    rewindTo(std::max(journalFloor, journal->previousOperation(journal->position())));
+    return true;
+}
+
+bool LoadBalancer::redo() {
+    if (!journal || journal->position() >= journal->size()) return false;
+    
+    rewindTo(journal->nextOperation(journal->position()));
+    return true;
+}
+
+void LoadBalancer::setServerZone(int serverId, int zone) {
+    auto server = getServer(serverId);
+    if (!server) {
+        console() << "Server #" << serverId << " not found" << std::endl;
+        return;
+    }
+    if (journal) {
+        journal->append(JournalOp::SET_ZONE, serverId, server->getZone(), zone);
+    }
+    server->setZone(zone);
+}
+
+FleetSnapshot LoadBalancer::snapshotFleet() const {
+    FleetSnapshot fleet;
     for (auto& server : servers) {
-        server->setCurrentLoad(0);
+        fleet.add(server->getId(), server->getCapacity(), server->getCurrentLoad(),
+                  server->getPerformanceMultiplier(), server->isOnline(), server->getZone());
     }
-    
-    // Redistribute total load using current algorithm
-    addSystemLoad(totalLoad);
-    
-    std::cout << "Load rebalanced using " << getAlgorithmName() << " algorithm" << std::endl;
+    return fleet;
 }
 
-double LoadBalancer::calculateLoadVariance() const {
-    if (servers.empty()) return 0.0;
-    
-    // Calculate mean load percentage
-    double totalPercentage = 0.0;
-    int onlineCount = 0;
-    
+void LoadBalancer::restoreFleet(const FleetSnapshot& fleet) {
+    std::map<int, std::shared_ptr<Server>> byId;
     for (auto& server : servers) {
-        if (server->isOnline()) {
-            totalPercentage += server->getLoadPercentage();
-            onlineCount++;
-        }
+        byId[server->getId()] = server;
     }
     
-    if (onlineCount == 0) return 0.0;
-    
-    double meanPercentage = totalPercentage / onlineCount;
-    
-    // Calculate variance
-    double variance = 0.0;
-    for (auto& server : servers) {
-        if (server->isOnline()) {
-            double diff = server->getLoadPercentage() - meanPercentage;
-            variance += diff * diff;
-        }
+    for (size_t i = 0; i < fleet.size(); i++) {
+        auto it = byId.find(fleet.getId(i));
+        if (it == byId.end()) continue;
+        
+        it->second->setCurrentLoad(fleet.getCurrentLoad(i));
+        it->second->setOnline(fleet.isOnline(i));
+        it->second->setPerformanceMultiplier(fleet.getPerformanceMultiplier(i));
     }
+    costIndexDirty = true;
     
-    return variance / onlineCount;
+    if (timeline) {
+        emitLoadCounters();
+    }
 }
 
-int LoadBalancer::getTotalLoad() const {
-    int total = 0;
-    for (auto& server : servers) {
-        total += server->getCurrentLoad();
+BlastRadiusReport LoadBalancer::analyzeFailures(int maxFailures) const {
+    FailureAnalyzer analyzer(maxFailures);
+    return analyzer.analyze(snapshotFleet(), {BalancingAlgorithm::ROUND_ROBIN,
+                                              BalancingAlgorithm::LEAST_LOADED,
+                                              BalancingAlgorithm::WEIGHTED_OPTIMIZATION});
+}
+
+void LoadBalancer::setCapacitySafetyCheck(int everyPlacements) {
+    safetyCheckInterval = std::max(0, everyPlacements);
+    placementsSinceCheck = 0;
+    if (safetyCheckInterval == 0) {
+        stopSafetyThread();
+    } else if (!safetyThread.joinable()) {
+        safetyStopping = false;
+        safetyThread = std::thread(&LoadBalancer::safetyLoop, this);
     }
-    return total;
 }
 
-int LoadBalancer::getTotalCapacity() const {
-    int total = 0;
-    for (auto& server : servers) {
-        if (server->isOnline()) {
-            total += server->getCapacity();
-        }
+void LoadBalancer::runSafetyCheck() {
+    if (currentAlgorithm == BalancingAlgorithm::COST_OPTIMIZED) return;
+    
+    std::unique_ptr<FleetSnapshot> fleet(new FleetSnapshot(snapshotFleet()));
+    {
+        std::lock_guard<std::mutex> lock(safetyMutex);
+        safetyFleet = std::move(fleet);
+        safetyAlgorithm = currentAlgorithm;
     }
-    return total;
+    safetyWake.notify_one();
 }
 
-double LoadBalancer::measureOperationTime() {
-    auto now = std::chrono::system_clock::now();
-    double elapsed = std::chrono::duration<double, std::milli>(now - lastOperationTime).count();
-    lastOperationTime = now;
-    return elapsed;
+void LoadBalancer::safetyLoop() {
+    // Single failures on this thread alone, so the check never competes with
+    // placement for more than one core
+    FailureAnalyzer analyzer(1, true, 1);
+    std::unique_lock<std::mutex> lock(safetyMutex);
+    for (;;) {
+        safetyWake.wait(lock, [this]() { return safetyStopping || safetyFleet; });
+        if (safetyStopping) return;
+        
+        std::unique_ptr<FleetSnapshot> fleet = std::move(safetyFleet);
+        BalancingAlgorithm algorithm = safetyAlgorithm;
+        lock.unlock();
+        std::unique_ptr<BlastRadiusReport> report(new BlastRadiusReport(analyzer.analyze(*fleet, {algorithm})));
+        lock.lock();
+        safetyResult = std::move(report);
+    }
 }
 
-void LoadBalancer::addRandomLoad() {
-    addSystemLoad(randomLoadAmount);
+void LoadBalancer::stopSafetyThread() {
+    if (!safetyThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(safetyMutex);
+        safetyStopping = true;
+    }
+    safetyWake.notify_one();
+    safetyThread.join();
+    safetyFleet.reset();
+    safetyResult.reset();
 }
 
-void LoadBalancer::addLoadToServer(int serverId, int loadAmount) {
+void LoadBalancer::reportSafetyCheck() {
+    std::unique_ptr<BlastRadiusReport> report;
+    {
+        std::lock_guard<std::mutex> lock(safetyMutex);
+        report = std::move(safetyResult);
+    }
+    if (!report || report->algorithms.empty() || report->overflowCounts[0] == 0) return;
+    
+    console() << "Capacity safety: " << report->overflowCounts[0] << " of " << report->scenarios.size() 
+              << " single failures would overflow under " << algorithmName(report->algorithms[0]) << std::endl;
+    
+    if (timeline) {
+        timeline->instant("capacity_unsafe", "safety", kBalancerTrack,
+                          "{\"overflowing\":" + std::to_string(report->overflowCounts[0]) + 
+                          ",\"scenarios\":" + std::to_string(report->scenarios.size()) + "}");
+    }
+}
+
+void LoadBalancer::setCostObjective(CostObjective objective) {
+    costObjective = objective;
+    costIndexDirty = true;
+    console() << "Cost objective set to " << (objective == CostObjective::PRICE ? "price" : "energy") << std::endl;
+}
+
+CostObjective LoadBalancer::getCostObjective() const {
+    return costObjective;
+}
+
+void LoadBalancer::setUtilizationSlo(double percentage) {
+    utilizationSlo = std::max(1.0, std::min(100.0, percentage));
+    costIndexDirty = true;
+    console() << "Utilization SLO set to " << utilizationSlo << "%" << std::endl;
+}
+
+void LoadBalancer::setServerCostModel(int serverId, double costPerUnit, double idlePowerWatts, double peakPowerWatts) {
     auto server = getServer(serverId);
     if (!server) {
-        std::cout << "Server #" << serverId << " not found" << std::endl;
+        console() << "Server #" << serverId << " not found" << std::endl;
         return;
     }
     
-    if (!server->isOnline()) {
-        std::cout << "Server #" << serverId << " is offline" << std::endl;
-        return;
+    double oldCost = server->getCostPerUnit();
+    double oldIdle = server->getIdlePowerWatts();
+    double oldPeak = server->getPeakPowerWatts();
+    server->setCostModel(costPerUnit, idlePowerWatts, peakPowerWatts);
+    if (journal) {
+        journal->append(JournalOp::SET_COST, serverId, OperationJournal::encodeMultiplier(oldCost),
+                        OperationJournal::encodeMultiplier(server->getCostPerUnit()));
+        journal->append(JournalOp::SET_IDLE_POWER, serverId, OperationJournal::encodeWatts(oldIdle),
+                        OperationJournal::encodeWatts(server->getIdlePowerWatts()));
+        journal->append(JournalOp::SET_PEAK_POWER, serverId, OperationJournal::encodeWatts(oldPeak),
+                        OperationJournal::encodeWatts(server->getPeakPowerWatts()));
     }
-    
-    int availableCapacity = server->getAvailableCapacity();
-    if (loadAmount > availableCapacity) {
-        std::cout << "Warning: Exceeding server capacity. Only " 
-                  << availableCapacity << " load units added." << std::endl;
-        loadAmount = availableCapacity;
+    costIndexDirty = true;
+}
+
+double LoadBalancer::getHourlyCost() const {
+    double total = 0.0;
+    for (auto& server : servers) {
+        total += server->getHourlyCost();
     }
-    
-    server->setCurrentLoad(server->getCurrentLoad() + loadAmount);
-    std::cout << "Added " << loadAmount << " load units to Server #" << serverId << std::endl;
-    
-    // Record operation time for monitoring
-    double operationTime = measureOperationTime();
-    
-    // Update monitor if attached
-    if (monitor) {
-        std::vector<int> loads;
-        for (auto& s : servers) {
-            loads.push_back(s->getCurrentLoad());
-        }
-        // This would be implemented if you include the monitoring header
-        // monitor->recordMetrics(loads, operationTime);
+    return total;
+}
+
+double LoadBalancer::getPowerDraw() const {
+    double total = 0.0;
+    for (auto& server : servers) {
+        total += server->getPowerDraw();
     }
+    return total;
 }
 
-void LoadBalancer::addSystemLoad(int loadAmount) {
-    std::cout << "Adding " << loadAmount << " load units using " 
-              << getAlgorithmName() << " algorithm" << std::endl;
-    
-    // Distribute load according to current algorithm
-    switch (currentAlgorithm) {
-        case BalancingAlgorithm::ROUND_ROBIN:
-            distributeLoadRoundRobin(loadAmount);
-            break;
-            
-        case BalancingAlgorithm::LEAST_LOADED:
-            distributeLoadLeastLoaded(loadAmount);
-            break;
-            
-        case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
-            distributeLoadWeightedOptimization(loadAmount);
-            break;
+void LoadBalancer::setHugePageBacking(bool enabled) {
+    // Only servers added from now on move; existing ones keep their allocation
+    hugepages::setEnabled(enabled);
+}
+
+bool LoadBalancer::isHugePageBackingEnabled() {
+    return hugepages::isEnabled();
+}
+
+TlbBenchmarkReport LoadBalancer::benchmarkHugePages(int serverCount, int lookups) {
+    TlbBenchmarkReport report = TlbBenchmarkReport();
+    report.servers = std::max(1, serverCount);
+    report.lookups = std::max(1, lookups);
+    
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pick(0, report.servers - 1);
+    std::vector<int> order(report.lookups);
+    for (auto& id : order) {
+        id = pick(rng);
     }
     
-    // Record operation time for monitoring
-    double operationTime = measureOperationTime();
-    
-    // Update monitor if attached
-    if (monitor) {
-        std::vector<int> loads;
-        for (auto& server : servers) {
-            loads.push_back(server->getCurrentLoad());
+    // Stand-in server table laid out like the live one, looked up by id as
+    // findServer does and read as the load scans do
+    auto run = [&](std::shared_ptr<HugePageArena> arena, double& nsPerLookup, uint64_t& misses) {
+        std::vector<std::shared_ptr<Server>> table;
+        std::unordered_map<int, std::shared_ptr<Server>> byId;
+        table.reserve(report.servers);
+        byId.reserve(report.servers);
+        for (int id = 0; id < report.servers; id++) {
+            auto server = arena ? std::allocate_shared<Server>(ArenaAllocator<Server>(arena), id, 100) :
+                                  std::make_shared<Server>(id, 100);
+            server->setCurrentLoad(id % 100);
+            table.push_back(server);
+            byId[id] = server;
+        }
+        
+        TlbMissCounter counter;
+        report.countersAvailable = counter.available();
+        long total = 0;
+        auto start = std::chrono::steady_clock::now();
+        counter.start();
+        for (int id : order) {
+            const Server& server = *byId.find(id)->second;
+            total += server.getCurrentLoad() * 100 / server.getCapacity();
         }
-        // This would be implemented if you include the monitoring header
-        // monitor->recordMetrics(loads, operationTime);
+        misses = counter.stop();
+        nsPerLookup = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / report.lookups;
+        
+        volatile long sink = total;
+        (void)sink;
+    };
+    
+    run(nullptr, report.normalNsPerLookup, report.normalTlbMisses);
+    
+    // The arena maps huge pages only while backing is on
+    bool wasEnabled = hugepages::isEnabled();
+    size_t hugetlbBefore = hugepages::bytesMapped(HugePageBacking::HUGETLBFS);
+    size_t transparentBefore = hugepages::bytesMapped(HugePageBacking::TRANSPARENT);
+    hugepages::setEnabled(true);
+    run(std::make_shared<HugePageArena>(), report.hugeNsPerLookup, report.hugeTlbMisses);
+    hugepages::setEnabled(wasEnabled);
+    
+    if (hugepages::bytesMapped(HugePageBacking::HUGETLBFS) > hugetlbBefore) {
+        report.arenaBacking = HugePageBacking::HUGETLBFS;
+    } else if (hugepages::bytesMapped(HugePageBacking::TRANSPARENT) > transparentBefore) {
+        report.arenaBacking = HugePageBacking::TRANSPARENT;
+    } else {
+        report.arenaBacking = HugePageBacking::NORMAL;
     }
-    
-    // Display updated system
-    std::cout << visualizeLoads() << std::endl;
+    return report;
 }
 
-void LoadBalancer::setBalancingAlgorithm(BalancingAlgorithm algorithm) {
-    currentAlgorithm = algorithm;
-    std::cout << "Switched to " << getAlgorithmName() << " algorithm" << std::endl;
+NumaBenchmarkReport LoadBalancer::benchmarkNumaReplicas(int serverCount, int lookupsPerThread) {
+    NumaTopology topology = NumaTopology::detect();
+    NumaBenchmarkReport report = NumaBenchmarkReport();
+    report.nodes = topology.nodeCount();
+    report.servers = std::max(1, serverCount);
+    report.lookupsPerThread = std::max(1, lookupsPerThread);
+    report.threadsPerNode = 4;
+    for (int node = 0; node < report.nodes; node++) {
+        report.threadsPerNode = std::min<int>(report.threadsPerNode, topology.cpusOfNode(node).size());
+    }
+    report.threadsPerNode = std::max(1, report.threadsPerNode);
+    report.pinned = true;
+    
+    // The live fleet's records, tiled out to the table size
+    struct ServerRecord {
+        int id;
+        int capacity;
+        int load;
+    };
+    std::vector<ServerRecord> records(report.servers);
+    for (int i = 0; i < report.servers; i++) {
+        if (servers.empty()) {
+            records[i] = {i, 100, 0};
+        } else {
+            const Server& server = *servers[i % servers.size()];
+            records[i] = {server.getId(), std::max(1, server.getCapacity()), server.getCurrentLoad()};
+        }
+    }
+    NodeReplicatedTable<ServerRecord> table(topology, records.size());
+    table.publish(records.data());
+    report.placed = table.isPlaced();
+    
+    // Every node runs its workers at once, each reading its own replica or the next node's
+    auto run = [&](bool crossNode) {
+        std::mutex pinnedMutex;
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (int node = 0; node < report.nodes; node++) {
+            for (int t = 0; t < report.threadsPerNode; t++) {
+                workers.emplace_back([&, node, t]() {
+                    if (!numa::pinCurrentThreadToNode(topology, node)) {
+                        std::lock_guard<std::mutex> lock(pinnedMutex);
+                        report.pinned = false;
+                    }
+                    const ServerRecord* replica = crossNode ? table.replica((node + 1) % report.nodes) :
+                                                              table.local();
+                    uint64_t x = 0x9E3779B97F4A7C15ULL + node * 131 + t;
+                    long total = 0;
+                    for (int i = 0; i < report.lookupsPerThread; i++) {
+                        // xorshift64
+                        x ^= x << 13;
+                        x ^= x >> 7;
+                        x ^= x << 17;
+                        const ServerRecord& record = replica[x % report.servers];
+                        total += record.load * 100 / record.capacity;
+                    }
+                    volatile long sink = total;
+                    (void)sink;
+                });
+            }
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(workers.size()) * report.lookupsPerThread / std::max(seconds, 1e-9);
+    };
     
-    // Update monitor if attached
-    if (monitor) {
-        // This would be implemented if you include the monitoring header
-        // monitor->setAlgorithm(getAlgorithmName());
+    report.localLookupsPerSecond = run(false);
+    if (report.nodes > 1 && report.placed && report.pinned) {
+        report.crossLookupsPerSecond = run(true);
     }
+    return report;
 }
 
-BalancingAlgorithm LoadBalancer::getCurrentAlgorithm() const {
-    return currentAlgorithm;
+void LoadBalancer::enableSubsetting(int clientId, int subsetSize) {
+    subsetter = std::make_shared<DeterministicSubsetter>(clientId, subsetSize);
+    refreshSubset(true);
+    tenantShards.clear();
+    console() << "Subsetting enabled for client #" << subsetter->getClientId() 
+              << ": " << subsetIds.size() << " of " << servers.size() << " servers" << std::endl;
 }
 
-std::string LoadBalancer::getAlgorithmName() const {
-    switch (currentAlgorithm) {
-        case BalancingAlgorithm::ROUND_ROBIN:
-            return "Round Robin";
-        case BalancingAlgorithm::LEAST_LOADED:
-            return "Least Loaded";
-        case BalancingAlgorithm::WEIGHTED_OPTIMIZATION:
-            return "Weighted Optimization";
-        default:
-            return "Unknown";
-    }
+void LoadBalancer::disableSubsetting() {
+    subsetter.reset();
+    subsetIds.clear();
+    subsetServers.clear();
+    subsetTotals = PoolTotals();
+    tenantShards.clear();
+    console() << "Subsetting disabled" << std::endl;
 }
 
-void LoadBalancer::setRandomLoadAmount(int amount) {
-    randomLoadAmount = amount;
-    std::cout << "Random load amount set to " << randomLoadAmount << std::endl;
+bool LoadBalancer::isSubsettingEnabled() const {
+    return subsetter != nullptr;
 }
 
-int LoadBalancer::getRandomLoadAmount() const {
-    return randomLoadAmount;
+const std::vector<int>& LoadBalancer::getSubsetServerIds() const {
+    return subsetIds;
 }
 
-std::string LoadBalancer::visualizeLoads() const {
-    std::stringstream ss;
+void LoadBalancer::drawFleetSummary(std::ostream& ss) const {
+    int online = utilizationIndex.size();
+    int offline = static_cast<int>(servers.size()) - online;
+    ss << "Fleet: " << servers.size() << " servers (" << online << " online, " 
+       << degradedServers << " degraded, " << offline << " offline)" << std::endl;
+    
+    // Utilization histogram in 10% buckets, with everything past capacity in the last one
+    std::vector<double> bounds;
+    for (int b = 10; b <= 100; b += 10) {
+        bounds.push_back(b);
+    }
+    std::vector<int> buckets = utilizationIndex.histogram(bounds);
+    int largestBucket = std::max(1, *std::max_element(buckets.begin(), buckets.end()));
+    const int histogramWidth = 30;
+    
+    ss << "Utilization histogram:" << std::endl;
+    for (size_t b = 0; b < buckets.size(); b++) {
+        std::string label = (b < bounds.size()) ? 
+                            std::to_string(static_cast<int>(b * 10)) + "-" + std::to_string(static_cast<int>(bounds[b])) + "%" :
+                            "100%+";
+        int barLength = (buckets[b] * histogramWidth + largestBucket - 1) / largestBucket;
+        ss << "  " << std::setw(8) << label << " [" << std::string(barLength, '#') 
+           << std::string(histogramWidth - barLength, ' ') << "] " << buckets[b] << std::endl;
+    }
     
-    // Calculate the maximum capacity for scaling
-    int maxCapacity = 0;
-    for (auto& server : servers) {
-        if (server->getCapacity() > maxCapacity) {
-            maxCapacity = server->getCapacity();
+    ss << "Most loaded:" << std::endl;
+    for (int serverId : utilizationIndex.mostLoaded(kSummaryServersShown)) {
+        auto server = findServer(serverId);
+        if (server) {
+            drawServerBar(ss, *server);
+        }
+    }
+    ss << "Least loaded:" << std::endl;
+    for (int serverId : utilizationIndex.leastLoaded(kSummaryServersShown)) {
+        auto server = findServer(serverId);
+        if (server) {
+            drawServerBar(ss, *server);
         }
     }
     
+    ss << "Utilization p50/p95/p99: " << std::fixed << std::setprecision(1)
+       << utilizationIndex.percentile(50.0) << "% / " << utilizationIndex.percentile(95.0) << "% / "
+       << utilizationIndex.percentile(99.0) << "%" << std::endl;
+}
+
+std::string LoadBalancer::visualizeLoads() const {
+    ProfilePhaseScope phase(ProfilePhase::RENDERING);
+    std::stringstream ss;
+    
     // Display header
     ss << "System Load Visualization:" << std::endl;
     
-    // Display each server's load
-    const int barWidth = 40; // Maximum width of the load bar
-    
-    for (auto& server : servers) {
-        ss << "Server #" << std::setw(2) << server->getId() << " ";
-        
-        // Add status indicator
-        if (!server->isOnline()) {
-            ss << "[OFFLINE] ";
-        } else {
-            ss << "[" << server->getStatus() << "] ";
-        }
-        
-        // Calculate load percentage and bar length
-        double percentage = server->getLoadPercentage();
-        int loadBarLength = static_cast<int>((percentage / 100.0) * barWidth);
-        
-        // Draw the load bar
-        ss << "[";
-        for (int i = 0; i < barWidth; i++) {
-            if (i < loadBarLength) {
-                ss << "#";
-            } else {
-                ss << " ";
-            }
+    // Display each server's load, or a summary read off the indexes on a large fleet
+    if (servers.size() <= kDetailedViewServers) {
+        for (auto& server : servers) {
+            drawServerBar(ss, *server);
         }
-        
-        ss << "] " << std::fixed << std::setprecision(1) << percentage << "%" 
-           << " (" << server->getCurrentLoad() << "/" << server->getCapacity() << ")" << std::endl;
+    } else {
+        drawFleetSummary(ss);
     }
     
     // Display system statistics
@@ -560,7 +2192,12 @@ std::string LoadBalancer::visualizeLoads() const {
     ss << "System Load: " << totalLoad << "/" << totalCapacity 
        << " (" << std::fixed << std::setprecision(1) << systemLoadPercentage << "%)" << std::endl;
     ss << "Load Variance: " << std::fixed << std::setprecision(2) << variance << std::endl;
+    ss << "Balance: " << FairnessTracker::format(fairness.snapshot()) << std::endl;
     ss << "Current Algorithm: " << getAlgorithmName() << std::endl;
+    if (subsetter) {
+        ss << "Subset (client #" << subsetter->getClientId() << "): " 
+           << subsetServers.size() << "/" << servers.size() << " servers" << std::endl;
+    }
     
     return ss.str();
 }
@@ -574,6 +2211,24 @@ std::string LoadBalancer::getSystemStatus() const {
     ss << "Current Total Load: " << getTotalLoad() << std::endl;
     ss << "Load Balancing Algorithm: " << getAlgorithmName() << std::endl;
     ss << "Random Load Amount: " << randomLoadAmount << std::endl;
+    ss << "Hourly Cost: " << std::fixed << std::setprecision(2) << getHourlyCost() << std::endl;
+    ss << "Power Draw: " << std::fixed << std::setprecision(1) << getPowerDraw() << " W" << std::endl;
+    ss << "Balance: " << FairnessTracker::format(fairness.snapshot()) << std::endl;
+    if (tlsTerminator) {
+        TlsTerminationStats tls = tlsTerminator->getStats();
+        ss << "TLS Handshakes: " << tls.total() << " (" << std::fixed << std::setprecision(1)
+           << (100.0 * tls.resumedRatio()) << "% resumed" << (tlsTerminator->isKernelTls() ? ", kTLS" : "")
+           << ")" << std::endl;
+    }
+    if (connectionPools) {
+        ConnectionPoolStats pools = connectionPools->getStats();
+        ss << "Upstream Streams: " << pools.activeStreams << " on " << pools.openConnections << " connections ("
+           << std::fixed << std::setprecision(1) << (100.0 * pools.reuseRatio()) << "% reused)" << std::endl;
+    }
+    if (subsetter) {
+        ss << "Subset Size: " << subsetServers.size() << " (client #" 
+           << subsetter->getClientId() << ")" << std::endl;
+    }
     
     // Add more status information as needed
     
@@ -582,50 +2237,64 @@ std::string LoadBalancer::getSystemStatus() const {
 
 void LoadBalancer::attachMonitor(std::shared_ptr<LoadMonitor> monitorObj) {
     monitor = monitorObj;
-    std::cout << "Load monitor attached" << std::endl;
+    console() << "Load monitor attached" << std::endl;
     
     // Initial setup
     if (monitor) {
-        // This would be implemented if you include the monitoring header
-        // monitor->setAlgorithm(getAlgorithmName());
+        monitor->setAlgorithm(getAlgorithmName());
     }
 }
 
 void LoadBalancer::attachHealthSimulator(std::shared_ptr<ServerHealthSimulator> healthSimObj) {
     healthSimulator = healthSimObj;
-    std::cout << "Server health simulator attached" << std::endl;
+    console() << "Server health simulator attached" << std::endl;
     
     // Register existing servers with the health simulator
     if (healthSimulator) {
         for (auto& server : servers) {
-            // This would be implemented if you include the health simulator header
-            // healthSimulator->addServer(server->getId());
+            healthSimulator->addServer(server->getId());
         }
         
         // Set callbacks from health simulator to update server health
-        // This would be implemented if you include the health simulator header
-        /*
         healthSimulator->setStateChangeCallback([this](int serverId, ServerState state) {
+            ProfilePhaseScope phase(ProfilePhase::HEALTH_UPDATE);
             auto server = this->getServer(serverId);
             if (server) {
+                // Each transition is its own operation, so undo and bisect can isolate it
+                if (journal) {
+                    journal->append(JournalOp::HEALTH, serverId, OperationJournal::encodeStatus(server->getStatus()),
+                                    static_cast<int32_t>(state));
+                }
                 server->setStatus(ServerHealthSimulator::stateToString(state));
                 server->setOnline(state != ServerState::OFFLINE);
+                
+                if (failover && state == ServerState::OFFLINE && server->getCurrentLoad() > 0) {
+                    pendingFailover += server->getCurrentLoad();
+                    server->setCurrentLoad(0);
+                    costIndexDirty = true;
+                }
+            }
+            
+            if (timeline) {
+                timeline->instant("health", "health", kHealthTrack,
+                                  "{\"server\":" + std::to_string(serverId) + 
+                                  ",\"state\":\"" + ServerHealthSimulator::stateToString(state) + "\"}");
             }
         });
         
         healthSimulator->setPerformanceUpdateCallback([this](int serverId, double multiplier) {
+            ProfilePhaseScope phase(ProfilePhase::HEALTH_UPDATE);
             auto server = this->getServer(serverId);
             if (server) {
                 server->setPerformanceMultiplier(multiplier);
             }
         });
-        */
     }
 }
 
 void LoadBalancer::attachLoadGenerator(std::shared_ptr<LoadPatternGenerator> loadGenObj) {
     loadGenerator = loadGenObj;
-    std::cout << "Load pattern generator attached" << std::endl;
+    console() << "Load pattern generator attached" << std::endl;
     
     // Set callback from load generator to add load
     if (loadGenerator) {
@@ -638,6 +2307,142 @@ void LoadBalancer::attachLoadGenerator(std::shared_ptr<LoadPatternGenerator> loa
     }
 }
 
+void LoadBalancer::setMonitorFactory(std::function<std::shared_ptr<LoadMonitor>()> factory) {
+    monitorFactory = factory;
+}
+
+void LoadBalancer::setHealthSimulatorFactory(std::function<std::shared_ptr<ServerHealthSimulator>()> factory) {
+    healthSimulatorFactory = factory;
+}
+
+void LoadBalancer::setLoadGeneratorFactory(std::function<std::shared_ptr<LoadPatternGenerator>()> factory) {
+    loadGeneratorFactory = factory;
+}
+
+std::shared_ptr<LoadMonitor> LoadBalancer::getMonitor() {
+    if (!monitor && monitorFactory) {
+        auto factory = std::move(monitorFactory);
+        monitorFactory = nullptr;
+        attachMonitor(factory());
+    }
+    return monitor;
+}
+
+std::shared_ptr<ServerHealthSimulator> LoadBalancer::getHealthSimulator() {
+    if (!healthSimulator && healthSimulatorFactory) {
+        auto factory = std::move(healthSimulatorFactory);
+        healthSimulatorFactory = nullptr;
+        attachHealthSimulator(factory());
+    }
+    return healthSimulator;
+}
+
+std::shared_ptr<LoadPatternGenerator> LoadBalancer::getLoadGenerator() {
+    if (!loadGenerator && loadGeneratorFactory) {
+        auto factory = std::move(loadGeneratorFactory);
+        loadGeneratorFactory = nullptr;
+        attachLoadGenerator(factory());
+    }
+    return loadGenerator;
+}
+
+StartupBenchmarkReport LoadBalancer::benchmarkStartup(int serverCount, int serverCapacity,
+                                                      BalancingAlgorithm algorithm) {
+    StartupBenchmarkReport report = StartupBenchmarkReport();
+    report.servers = std::max(1, serverCount);
+    report.algorithm = algorithm;
+    
+    auto start = std::chrono::steady_clock::now();
+    LoadBalancer balancer(report.servers, serverCapacity, false);
+    balancer.currentAlgorithm = algorithm;
+    
+    // The factories only count: the first pick should not need any module
+    int constructed = 0;
+    balancer.setMonitorFactory([&constructed]() {
+        constructed++;
+        return std::shared_ptr<LoadMonitor>();
+    });
+    balancer.setHealthSimulatorFactory([&constructed]() {
+        constructed++;
+        return std::shared_ptr<ServerHealthSimulator>();
+    });
+    balancer.setLoadGeneratorFactory([&constructed]() {
+        constructed++;
+        return std::shared_ptr<LoadPatternGenerator>();
+    });
+    auto built = std::chrono::steady_clock::now();
+    
+    report.chosenServer = balancer.assignFlow();
+    auto picked = std::chrono::steady_clock::now();
+    
+    report.constructMs = std::chrono::duration<double, std::milli>(built - start).count();
+    report.firstPickUs = std::chrono::duration<double, std::micro>(picked - built).count();
+    report.modulesConstructed = constructed;
+    return report;
+}
+
+std::string LoadBalancer::formatStartupReport(const StartupBenchmarkReport& report) {
+    std::stringstream ss;
+    ss << "=== STARTUP BENCHMARK ===" << std::endl;
+    ss << report.servers << " servers, " << algorithmName(report.algorithm) << std::endl;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Construction:  " << report.constructMs << " ms" << std::endl;
+    ss << "First pick:    " << report.firstPickUs << " us";
+    if (report.chosenServer >= 0) {
+        ss << " (server #" << report.chosenServer << ")";
+    } else {
+        ss << " (no server had room)";
+    }
+    ss << std::endl;
+    ss << "Time to first pick: " << report.constructMs + report.firstPickUs / 1000.0 << " ms" << std::endl;
+    ss << "Lazy modules built: " << report.modulesConstructed << std::endl;
+    ss << "=========================" << std::endl;
+    return ss.str();
+}
+
+void LoadBalancer::attachTimeline(std::shared_ptr<TraceEventWriter> timelineObj) {
+    timeline = timelineObj;
+    timelineLoads.clear();
+    console() << "Timeline writer attached" << std::endl;
+    
+    if (timeline) {
+        timeline->setProcessName("Load Balancer");
+        timeline->setThreadName(kBalancerTrack, "Balancer");
+        timeline->setThreadName(kHealthTrack, "Server Health");
+        emitLoadCounters();
+    }
+}
+
+void LoadBalancer::emitLoadCounters() {
+    ProfilePhaseScope phase(ProfilePhase::METRICS);
+    
+    // Only servers whose load changed get a new counter sample
+    std::map<int, int> current;
+    for (auto& server : servers) {
+        int load = server->getCurrentLoad();
+        current[server->getId()] = load;
+        
+        auto it = timelineLoads.find(server->getId());
+        if (it == timelineLoads.end() || it->second != load) {
+            timeline->counter("Server #" + std::to_string(server->getId()), "load", load);
+        }
+    }
+    
+    // Removed servers drop to zero
+    for (auto& entry : timelineLoads) {
+        if (current.find(entry.first) == current.end() && entry.second != 0) {
+            timeline->counter("Server #" + std::to_string(entry.first), "load", 0);
+        }
+    }
+    
+    timelineLoads.swap(current);
+}
+
+void LoadBalancer::attachTracer(std::shared_ptr<RequestTracer> tracerObj) {
+    tracer = tracerObj;
+    console() << "Request tracer attached" << std::endl;
+}
+
 bool LoadBalancer::processCommand(char command) {
     switch (command) {
         case 'a':
@@ -659,7 +2464,7 @@ bool LoadBalancer::processCommand(char command) {
                 }
                 removeServer(highestId);
             } else {
-                std::cout << "No servers to remove" << std::endl;
+                console() << "No servers to remove" << std::endl;
             }
             return true;
         }
@@ -668,10 +2473,67 @@ bool LoadBalancer::processCommand(char command) {
             rebalanceLoads();
             return true;
             
+        case 'n':
+            console() << FailureAnalyzer::formatReport(analyzeFailures());
+            return true;
+            
+        case 't':
+            // Session ids alone exercise the shared cache; tickets bypass it
+            console() << TlsTerminator::formatReport(benchmarkTls(1000, 20, false));
+            console() << TlsTerminator::formatReport(benchmarkTls(1000, 20, true));
+            return true;
+            
+        case 'u':
+            console() << UdpForwarder::formatReport(UdpForwarder::benchmark(*this, 64, 2000));
+            return true;
+            
+        case 'k':
+            // Bursts place one key per load unit, so batches run from one key to a few hundred
+            console() << KeyHasher::formatReport(keyHasher.benchmark({1, 4, 16, 64, 256, 1024}, 1 << 20));
+            return true;
+            
+        case 'c':
+            console() << ConnectionTable::formatReport(benchmarkConnectionTable(1 << 20, 1 << 22));
+            return true;
+            
+        case 'p':
+            console() << ConnectionPoolManager::formatStats(benchmarkConnectionPools(4, 10000));
+            return true;
+            
+        case 'x':
+            console() << ConnectionPoolManager::formatUpstreamReports({benchmarkUpstream(1, 64, 100),
+                                                                       benchmarkUpstream(100, 64, 100)});
+            return true;
+            
+        case 'f': {
+            // Toggle the sampling profiler; stopping writes the folded stacks
+            SamplingProfiler& profiler = SamplingProfiler::instance();
+            if (profiler.isRunning()) {
+                profiler.stop();
+                profiler.writeFoldedStacks("profile.folded");
+            } else {
+                profiler.start(99, 30.0);
+            }
+            return true;
+        }
+            
+        case 'g':
+            console() << hugepages::formatReport(benchmarkHugePages(1 << 20, 1 << 22));
+            return true;
+            
+        case 'i':
+            console() << formatStartupReport(benchmarkStartup(10000, 100, currentAlgorithm));
+            return true;
+            
+        case 'o':
+            // 4M records of 12 bytes per replica, well past the last-level cache
+            console() << numa::formatReport(benchmarkNumaReplicas(1 << 22, 1 << 22));
+            return true;
+            
         case 'm': {
             // Cycle through algorithms
             int algo = static_cast<int>(currentAlgorithm);
-            algo = (algo + 1) % 3;  // Assuming 3 algorithms
+            algo = (algo + 1) % kBalancingAlgorithmCount;
             setBalancingAlgorithm(static_cast<BalancingAlgorithm>(algo));
             return true;
         }
@@ -691,7 +2553,7 @@ bool LoadBalancer::processCommand(char command) {
             return true;
             
         case 'q':
-            std::cout << "Exiting simulation..." << std::endl;
+            console() << "Exiting simulation..." << std::endl;
             return false;  // Signal to quit
             
         default:
@@ -702,7 +2564,7 @@ bool LoadBalancer::processCommand(char command) {
                 return true;
             }
             
-            std::cout << "Unknown command. Type 'h' for help." << std::endl;
+            console() << "Unknown command. Type 'h' for help." << std::endl;
             return true;
     }
 }
@@ -714,6 +2576,17 @@ void LoadBalancer::displayHelp() const {
     std::cout << "d: Remove a server" << std::endl;
     std::cout << "r: Rebalance all loads using current algorithm" << std::endl;
     std::cout << "m: Switch between optimization algorithms" << std::endl;
+    std::cout << "n: Analyze single and double failures (N-2)" << std::endl;
+    std::cout << "t: Benchmark TLS handshakes with session resumption" << std::endl;
+    std::cout << "u: Benchmark UDP forwarding over loopback" << std::endl;
+    std::cout << "k: Benchmark scalar and batch key hashing by batch size" << std::endl;
+    std::cout << "c: Benchmark the L4 connection table" << std::endl;
+    std::cout << "p: Benchmark backend connection pools" << std::endl;
+    std::cout << "x: Compare HTTP/1.1 and multiplexed upstream connections" << std::endl;
+    std::cout << "g: Compare server lookups on regular and huge pages (dTLB misses)" << std::endl;
+    std::cout << "i: Measure time to first pick with 10,000 servers" << std::endl;
+    std::cout << "o: Compare server-table reads from the local and a remote NUMA node" << std::endl;
+    std::cout << "f: Start/stop the sampling profiler (folded stacks to profile.folded)" << std::endl;
     std::cout << "1-9: Add load to a specific server (by ID)" << std::endl;
     std::cout << "+/-: Increase/decrease the random load amount" << std::endl;
     std::cout << "h: Display this help message" << std::endl;
@@ -722,13 +2595,24 @@ void LoadBalancer::displayHelp() const {
 }
 
 void LoadBalancer::runScalabilityDemo() {
-    std::cout << "=== RUNNING SCALABILITY DEMO ===" << std::endl;
-    std::cout << "Starting with 3 servers and gradually scaling up to 8..." << std::endl;
+    console() << "=== RUNNING SCALABILITY DEMO ===" << std::endl;
+    if (timeline) {
+        timeline->begin("scalability_demo", "demo", kBalancerTrack);
+    }
+    console() << "Starting with 3 servers and gradually scaling up to 8..." << std::endl;
     
     // Ensure we have 3 servers to start
     while (servers.size() > 3) {
+        servers.back()->setObserver(nullptr);
+        unindexServer(*servers.back());
+        if (journal) {
+            journal->append(JournalOp::REMOVE_SERVER, servers.back()->getId(), servers.back()->getCapacity(), 0);
+        }
         servers.pop_back();
     }
+    refreshSubset(false);
+    tenantShards.clear();
+    costIndexDirty = true;
     
     while (servers.size() < 3) {
         addServer();
@@ -743,8 +2627,8 @@ void LoadBalancer::runScalabilityDemo() {
     setBalancingAlgorithm(BalancingAlgorithm::ROUND_ROBIN);
     
     // Display initial state
-    std::cout << "Initial state:" << std::endl;
-    std::cout << visualizeLoads() << std::endl;
+    console() << "Initial state:" << std::endl;
+    console() << visualizeLoads() << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(1));
     
     // Add some initial load
@@ -755,7 +2639,7 @@ void LoadBalancer::runScalabilityDemo() {
     
     // Start adding servers and more load
     for (int i = 0; i < 5; i++) {
-        std::cout << "Adding new server and more load..." << std::endl;
+        console() << "Adding new server and more load..." << std::endl;
         addServer();
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
         
@@ -774,7 +2658,10 @@ void LoadBalancer::runScalabilityDemo() {
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
     
-    std::cout << "Final state:" << std::endl;
-    std::cout << visualizeLoads() << std::endl;
-    std::cout << "=== SCALABILITY DEMO COMPLETED ===" << std::endl;
+    console() << "Final state:" << std::endl;
+    console() << visualizeLoads() << std::endl;
+    if (timeline) {
+        timeline->end("scalability_demo", "demo", kBalancerTrack);
+    }
+    console() << "=== SCALABILITY DEMO COMPLETED ===" << std::endl;
 }
\ No newline at end of file
@@ -1,21 +1,15 @@
 #include "include/load_monitor.h"
 #include <iostream>
+#include <algorithm>
 #include <numeric>
 #include <iomanip>
 #include <sstream>
+#include <ctime>
+#include <map>
 
-LoadMonitor::LoadMonitor(const std::string& logFilePath) : currentAlgorithm("Round Robin") {
-    logFile.open(logFilePath, std::ios::out | std::ios::app);
+LoadMonitor::LoadMonitor(const std::string& logFilePath) 
+    : logFilePath(logFilePath), logOpenAttempted(false), currentAlgorithm("Round Robin"), poolsRecorded(false) {
     startTime = std::chrono::system_clock::now();
-    
-    if (logFile.is_open()) {
-        logFile << "=== Load Balancer Monitoring Started at " 
-                << std::put_time(std::localtime(std::chrono::system_clock::to_time_t(startTime)), 
-                                 "%Y-%m-%d %H:%M:%S") << " ===" << std::endl;
-        logFile << "Timestamp,Algorithm,ServerCount,AvgLoad,LoadVariance,ResponseTime" << std::endl;
-    } else {
-        std::cerr << "Warning: Could not open log file for monitoring!" << std::endl;
-    }
 }
 
 LoadMonitor::~LoadMonitor() {
@@ -26,7 +20,28 @@ LoadMonitor::~LoadMonitor() {
     }
 }
 
-void LoadMonitor::recordMetrics(const std::vector<int>& serverLoads, double responseTime) {
+bool LoadMonitor::ensureLogOpen() {
+    if (logOpenAttempted) {
+        return logFile.is_open();
+    }
+    logOpenAttempted = true;
+    
+    logFile.open(logFilePath, std::ios::out | std::ios::app);
+    
+    if (logFile.is_open()) {
+        std::time_t started = std::chrono::system_clock::to_time_t(startTime);
+        logFile << "=== Load Balancer Monitoring Started at " 
+                << std::put_time(std::localtime(&started), "%Y-%m-%d %H:%M:%S") << " ===" << std::endl;
+        logFile << "Timestamp,Algorithm,ServerCount,AvgLoad,LoadVariance,ResponseTime,CostPerHour,PowerWatts" << std::endl;
+    } else {
+        std::cerr << "Warning: Could not open log file for monitoring!" << std::endl;
+    }
+    
+    return logFile.is_open();
+}
+
+void LoadMonitor::recordMetrics(const std::vector<int>& serverLoads, double responseTime,
+                                double costPerHour, double powerWatts) {
     double timestamp = getElapsedTimeSeconds();
     double avgLoad = calculateAverageLoad(serverLoads);
     double variance = calculateLoadVariance(serverLoads);
@@ -38,25 +53,51 @@ void LoadMonitor::recordMetrics(const std::vector<int>& serverLoads, double resp
         variance,
         responseTime,
         static_cast<int>(serverLoads.size()),
-        currentAlgorithm
+        currentAlgorithm,
+        costPerHour,
+        powerWatts,
+        0.0,
+        0,
+        0,
+        1.0,
+        1.0,
+        0.0,
+        0.0
     };
     metrics.push_back(snapshot);
     
     // Log to file
-    if (logFile.is_open()) {
+    if (ensureLogOpen()) {
         logFile << timestamp << ","
                 << currentAlgorithm << ","
                 << serverLoads.size() << ","
                 << avgLoad << ","
                 << variance << ","
-                << responseTime << std::endl;
+                << responseTime << ","
+                << costPerHour << ","
+                << powerWatts << std::endl;
     }
 }
 
+void LoadMonitor::recordHealthState(double peakTemperature, int throttledServers, int offlineServers) {
+    if (metrics.empty()) return;
+    metrics.back().peakTemperature = peakTemperature;
+    metrics.back().throttledServers = throttledServers;
+    metrics.back().offlineServers = offlineServers;
+}
+
+void LoadMonitor::recordFairness(double jainIndex, double maxMeanRatio, double gini, double weightedVariance) {
+    if (metrics.empty()) return;
+    metrics.back().jainIndex = jainIndex;
+    metrics.back().maxMeanRatio = maxMeanRatio;
+    metrics.back().gini = gini;
+    metrics.back().weightedVariance = weightedVariance;
+}
+
 void LoadMonitor::setAlgorithm(const std::string& algorithm) {
     currentAlgorithm = algorithm;
     
-    if (logFile.is_open()) {
+    if (ensureLogOpen()) {
         logFile << getElapsedTimeSeconds() << ",Algorithm changed to: " 
                 << algorithm << std::endl;
     }
@@ -88,23 +129,55 @@ double LoadMonitor::getElapsedTimeSeconds() {
 }
 
 void LoadMonitor::logServerAddition() {
-    if (logFile.is_open()) {
+    if (ensureLogOpen()) {
         logFile << getElapsedTimeSeconds() << ",Server added" << std::endl;
     }
 }
 
 void LoadMonitor::logServerRemoval() {
-    if (logFile.is_open()) {
+    if (ensureLogOpen()) {
         logFile << getElapsedTimeSeconds() << ",Server removed" << std::endl;
     }
 }
 
 void LoadMonitor::logRebalancing() {
-    if (logFile.is_open()) {
+    if (ensureLogOpen()) {
         logFile << getElapsedTimeSeconds() << ",Load rebalanced" << std::endl;
     }
 }
 
+void LoadMonitor::logFailover(int moved, int shed) {
+    failoverShed[currentAlgorithm] += shed;
+    
+    if (ensureLogOpen()) {
+        logFile << getElapsedTimeSeconds() << ",Failover moved " << moved 
+                << " shed " << shed << std::endl;
+    }
+}
+
+void LoadMonitor::recordTenantUtilization(int tenantId, int usage, int reservation, int limit, int rejected) {
+    tenantMetrics[tenantId] = {usage, reservation, limit, rejected};
+    
+    if (ensureLogOpen()) {
+        logFile << getElapsedTimeSeconds() << ",Tenant " << tenantId 
+                << " usage " << usage << "/" << (limit > 0 ? std::to_string(limit) : "unlimited") 
+                << ", rejected " << rejected << std::endl;
+    }
+}
+
+void LoadMonitor::recordConnectionPools(double reuseRatio, double meanCheckoutUs, double maxCheckoutUs,
+                                        double streamsPerConnection, int exhaustedPools, uint64_t refused) {
+    // Only a change in the number of exhausted pools is worth a log line
+    bool exhaustionChanged = !poolsRecorded || poolMetrics.exhaustedPools != exhaustedPools;
+    poolMetrics = {reuseRatio, meanCheckoutUs, maxCheckoutUs, streamsPerConnection, exhaustedPools, refused};
+    poolsRecorded = true;
+    
+    if (exhaustionChanged && ensureLogOpen()) {
+        logFile << getElapsedTimeSeconds() << ",Connection pools exhausted: " << exhaustedPools 
+                << ", refused " << refused << std::endl;
+    }
+}
+
 void LoadMonitor::generateReport(const std::string& reportPath) {
     std::ofstream report(reportPath);
     if (!report.is_open()) {
@@ -129,19 +202,88 @@ void LoadMonitor::generateReport(const std::string& reportPath) {
     for (const auto& pair : algorithmMetrics) {
         double avgVariance = 0.0;
         double avgResponse = 0.0;
+        double avgCost = 0.0;
+        double avgPower = 0.0;
+        double maxTemperature = 0.0;
+        int throttledSamples = 0;
+        int maxOffline = 0;
+        double avgJain = 0.0;
+        double avgGini = 0.0;
+        double avgWeightedVariance = 0.0;
+        double worstMaxMean = 0.0;
         
         for (const auto& snapshot : pair.second) {
+            maxTemperature = std::max(maxTemperature, snapshot.peakTemperature);
+            if (snapshot.throttledServers > 0) throttledSamples++;
+            maxOffline = std::max(maxOffline, snapshot.offlineServers);
             avgVariance += snapshot.loadVariance;
+            avgJain += snapshot.jainIndex;
+            avgGini += snapshot.gini;
+            avgWeightedVariance += snapshot.weightedVariance;
+            worstMaxMean = std::max(worstMaxMean, snapshot.maxMeanRatio);
             avgResponse += snapshot.responseTime;
+            avgCost += snapshot.costPerHour;
+            avgPower += snapshot.powerWatts;
         }
         
         avgVariance /= pair.second.size();
         avgResponse /= pair.second.size();
+        avgCost /= pair.second.size();
+        avgPower /= pair.second.size();
+        avgJain /= pair.second.size();
+        avgGini /= pair.second.size();
+        avgWeightedVariance /= pair.second.size();
         
         report << "Algorithm: " << pair.first << std::endl;
         report << "  Samples: " << pair.second.size() << std::endl;
         report << "  Avg Load Variance: " << avgVariance << std::endl;
-        report << "  Avg Response Time: " << avgResponse << " ms" << std::endl << std::endl;
+        report << "  Avg Weighted Variance: " << avgWeightedVariance << std::endl;
+        report << "  Avg Jain's Index: " << avgJain << std::endl;
+        report << "  Avg Gini: " << avgGini << std::endl;
+        report << "  Worst Max/Mean: " << worstMaxMean << std::endl;
+        report << "  Avg Response Time: " << avgResponse << " ms" << std::endl;
+        report << "  Avg Cost: " << avgCost << " per hour" << std::endl;
+        report << "  Avg Energy: " << (avgPower / 1000.0) << " kWh per hour" << std::endl;
+        if (maxTemperature > 0.0) {
+            report << "  Peak Temperature: " << maxTemperature << " C" << std::endl;
+            report << "  Samples With Throttling: " << throttledSamples << std::endl;
+        }
+        if (maxOffline > 0) {
+            report << "  Max Offline Servers: " << maxOffline << std::endl;
+        }
+        auto shed = failoverShed.find(pair.first);
+        if (shed != failoverShed.end()) {
+            report << "  Load Shed On Failover: " << shed->second << std::endl;
+        }
+        report << std::endl;
+    }
+    
+    if (!tenantMetrics.empty()) {
+        report << "TENANT UTILIZATION:" << std::endl;
+        report << "--------------------------" << std::endl;
+        
+        for (const auto& pair : tenantMetrics) {
+            const TenantSnapshot& tenant = pair.second;
+            report << "Tenant: " << pair.first << std::endl;
+            report << "  Usage: " << tenant.usage << std::endl;
+            report << "  Reservation: " << tenant.reservation << std::endl;
+            report << "  Limit: " << (tenant.limit > 0 ? std::to_string(tenant.limit) : "unlimited") << std::endl;
+            if (tenant.limit > 0) {
+                report << "  Limit Utilization: " << (100.0 * tenant.usage / tenant.limit) << "%" << std::endl;
+            }
+            report << "  Rejected: " << tenant.rejected << std::endl << std::endl;
+        }
+    }
+    
+    if (poolsRecorded) {
+        report << "CONNECTION POOLS:" << std::endl;
+        report << "--------------------------" << std::endl;
+        report << "  Reuse Ratio: " << (100.0 * poolMetrics.reuseRatio) << "%" << std::endl;
+        report << "  Avg Checkout Latency: " << poolMetrics.meanCheckoutUs << " us" << std::endl;
+        report << "  Max Checkout Latency: " << poolMetrics.maxCheckoutUs << " us" << std::endl;
+        report << "  Streams Per Connection: " << poolMetrics.streamsPerConnection << std::endl;
+        report << "  Refused Checkouts: " << poolMetrics.refused << std::endl;
+        report << "  Exhausted Pools: " << poolMetrics.exhaustedPools << std::endl << std::endl;
     }
     
     report << "=== END OF REPORT ===" << std::endl;
@@ -159,7 +301,22 @@ std::string LoadMonitor::getPerformanceSummary() {
         auto latest = metrics.back();
         summary << "- Current Avg Load: " << latest.avgLoad << std::endl;
         summary << "- Current Load Variance: " << latest.loadVariance << std::endl;
+        summary << "- Current Balance: Jain " << latest.jainIndex << ", Max/Mean " << latest.maxMeanRatio
+                << ", Gini " << latest.gini << ", Weighted Variance " << latest.weightedVariance << std::endl;
         summary << "- Current Response Time: " << latest.responseTime << " ms" << std::endl;
+        summary << "- Current Cost: " << latest.costPerHour << " per hour, " 
+                << latest.powerWatts << " W" << std::endl;
+    }
+    
+    if (poolsRecorded) {
+        summary << "- Connection Pools: " << (100.0 * poolMetrics.reuseRatio) << "% reused, " 
+                << poolMetrics.meanCheckoutUs << " us avg checkout, " << poolMetrics.exhaustedPools 
+                << " exhausted" << std::endl;
+    }
+    
+    for (const auto& pair : tenantMetrics) {
+        summary << "- Tenant " << pair.first << ": " << pair.second.usage << " used, " 
+                << pair.second.rejected << " rejected" << std::endl;
     }
     
     return summary.str();
@@ -0,0 +1,172 @@
+// numa_placement.cpp
+#include "include/numa_placement.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace {
+
+const int kMaxNodes = 64;
+const int kMpolBind = 2;   // MPOL_BIND from <linux/mempolicy.h>
+
+// Parses sysfs cpu lists such as "0-3,8-11"
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+
+    for (int node = 0; node < kMaxNodes; node++) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!in.is_open()) break;
+
+        std::string list;
+        std::getline(in, list);
+        topology.nodeCpus.push_back(parseCpuList(list));
+    }
+
+    if (topology.nodeCpus.empty()) {
+        std::vector<int> cpus;
+        int cpuCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < cpuCount; cpu++) {
+            cpus.push_back(cpu);
+        }
+        topology.nodeCpus.push_back(cpus);
+    }
+
+    for (size_t node = 0; node < topology.nodeCpus.size(); node++) {
+        for (int cpu : topology.nodeCpus[node]) {
+            if (cpu >= static_cast<int>(topology.cpuNodes.size())) {
+                topology.cpuNodes.resize(cpu + 1, 0);
+            }
+            topology.cpuNodes[cpu] = static_cast<int>(node);
+        }
+    }
+
+    return topology;
+}
+
+int NumaTopology::nodeCount() const {
+    return static_cast<int>(nodeCpus.size());
+}
+
+const std::vector<int>& NumaTopology::cpusOfNode(int node) const {
+    return nodeCpus.at(node);
+}
+
+int NumaTopology::nodeOfCpu(int cpu) const {
+    if (cpu < 0 || cpu >= static_cast<int>(cpuNodes.size())) return 0;
+    return cpuNodes[cpu];
+}
+
+int NumaTopology::currentNode() const {
+    return nodeOfCpu(sched_getcpu());
+}
+
+namespace numa {
+
+void* allocateOnNode(const NumaTopology& topology, size_t bytes, int node, bool* placed) {
+    if (bytes == 0) bytes = 1;
+    if (placed) *placed = false;
+
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    unsigned long nodeMask = 1UL << (node % kMaxNodes);
+    long bound = syscall(SYS_mbind, memory, bytes, kMpolBind, &nodeMask, kMaxNodes + 1, 0);
+    if (bound == 0) {
+        if (placed) *placed = true;
+        return memory;
+    }
+
+    // First touch from the node itself; an unpinned toucher leaves placement to chance
+    bool pinned = false;
+    std::thread toucher([&]() {
+        pinned = pinCurrentThreadToNode(topology, node);
+        firstTouch(memory, bytes);
+    });
+    toucher.join();
+    if (placed) *placed = pinned;
+
+    return memory;
+}
+
+void freeOnNode(void* memory, size_t bytes) {
+    if (!memory) return;
+    if (bytes == 0) bytes = 1;
+    munmap(memory, bytes);
+}
+
+void firstTouch(void* memory, size_t bytes) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile char* bytesPtr = static_cast<volatile char*>(memory);
+    for (size_t offset = 0; offset < bytes; offset += pageSize) {
+        bytesPtr[offset] = 0;
+    }
+}
+
+bool pinCurrentThreadToNode(const NumaTopology& topology, int node) {
+    if (node < 0 || node >= topology.nodeCount()) return false;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : topology.cpusOfNode(node)) {
+        CPU_SET(cpu, &cpuSet);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+}
+
+std::string formatReport(const NumaBenchmarkReport& report) {
+    std::stringstream ss;
+    ss << "=== NUMA REPLICA BENCHMARK ===" << std::endl;
+    ss << report.nodes << " node(s), " << report.servers << " servers, " << report.threadsPerNode
+       << " thread(s) per node, " << report.lookupsPerThread << " lookups each" << std::endl;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Local replica: " << report.localLookupsPerSecond / 1e6 << " M lookups/s" << std::endl;
+    if (report.nodes == 1) {
+        ss << "Single node: no cross-node reads to compare" << std::endl;
+    } else if (!report.placed || !report.pinned) {
+        // Replicas or readers share a node, so a "cross-node" run would read local memory
+        ss << "Cross-node:    not measured; "
+           << (!report.placed ? "replicas could not be placed on their nodes" :
+                                "workers could not be pinned to their nodes") << std::endl;
+    } else {
+        ss << "Cross-node:    " << report.crossLookupsPerSecond / 1e6 << " M lookups/s";
+        if (report.crossLookupsPerSecond > 0) {
+            ss << " (local is " << report.localLookupsPerSecond / report.crossLookupsPerSecond << "x)";
+        }
+        ss << std::endl;
+    }
+    ss << "==============================" << std::endl;
+    return ss.str();
+}
+
+} // namespace numa
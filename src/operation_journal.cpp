@@ -0,0 +1,190 @@
+// operation_journal.cpp
+#include "include/operation_journal.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+const char kJournalMagic[4] = {'L', 'B', 'J', '1'};
+const double kMultiplierScale = 1000000.0;
+const double kWattsScale = 1000.0;
+const char* const kStatuses[] = {"HEALTHY", "DEGRADED", "CRITICAL", "OFFLINE"};
+}
+
+OperationJournal::OperationJournal(size_t expectedRecords) : cursor(0), generation(0) {
+    records.reserve(expectedRecords);
+}
+
+bool OperationJournal::isOperationStart(const JournalRecord& record) {
+    JournalOp op = static_cast<JournalOp>(record.op);
+    return op == JournalOp::ADD_SERVER || op == JournalOp::REMOVE_SERVER ||
+           op == JournalOp::SET_ALGORITHM || op == JournalOp::PLACEMENT ||
+           op == JournalOp::HEALTH || op == JournalOp::SET_ZONE || op == JournalOp::SET_COST;
+}
+
+size_t OperationJournal::previousOperation(size_t position) const {
+    position = std::min(position, records.size());
+    while (position > 0) {
+        position--;
+        if (isOperationStart(records[position])) return position;
+    }
+    return 0;
+}
+
+size_t OperationJournal::nextOperation(size_t position) const {
+    while (position < records.size()) {
+        position++;
+        if (position == records.size() || isOperationStart(records[position])) return position;
+    }
+    return records.size();
+}
+
+void OperationJournal::setPosition(size_t position) {
+    cursor = std::min(position, records.size());
+}
+
+int32_t OperationJournal::encodeMultiplier(double multiplier) {
+    return static_cast<int32_t>(std::lround(multiplier * kMultiplierScale));
+}
+
+double OperationJournal::decodeMultiplier(int32_t encoded) {
+    return encoded / kMultiplierScale;
+}
+
+int32_t OperationJournal::encodeWatts(double watts) {
+    return static_cast<int32_t>(std::lround(watts * kWattsScale));
+}
+
+double OperationJournal::decodeWatts(int32_t encoded) {
+    return encoded / kWattsScale;
+}
+
+int32_t OperationJournal::encodeStatus(const std::string& status) {
+    for (int32_t i = 0; i < 4; i++) {
+        if (status == kStatuses[i]) return i;
+    }
+    return -1;
+}
+
+std::string OperationJournal::decodeStatus(int32_t encoded) {
+    return (encoded >= 0 && encoded < 4) ? kStatuses[encoded] : "UNKNOWN";
+}
+
+bool OperationJournal::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    uint64_t count = cursor;
+    out.write(kJournalMagic, sizeof(kJournalMagic));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(records.data()), count * sizeof(JournalRecord));
+    return static_cast<bool>(out);
+}
+
+bool OperationJournal::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, kJournalMagic, sizeof(magic)) != 0) return false;
+
+    std::vector<JournalRecord, HugePageAllocator<JournalRecord>> loaded(count);
+    in.read(reinterpret_cast<char*>(loaded.data()), count * sizeof(JournalRecord));
+    if (!in) return false;
+
+    records.swap(loaded);
+    cursor = records.size();
+    generation++;
+    return true;
+}
+
+int ReplayState::getTotalLoad() const {
+    int total = 0;
+    for (const auto& entry : servers) {
+        total += entry.second.load;
+    }
+    return total;
+}
+
+JournalReplayer::JournalReplayer(const OperationJournal& journal, size_t checkpointInterval)
+    : journal(journal), checkpointInterval(std::max<size_t>(1, checkpointInterval)),
+      generation(journal.getGeneration()) {
+    ReplayState initial;
+    initial.algorithm = BalancingAlgorithm::ROUND_ROBIN;
+    initial.position = 0;
+    checkpoints.push_back(initial);
+}
+
+void JournalReplayer::apply(ReplayState& state, const JournalRecord& record) {
+    switch (static_cast<JournalOp>(record.op)) {
+        case JournalOp::ADD_SERVER:
+            state.servers[record.serverId] = ReplayedServer();
+            state.servers[record.serverId].capacity = record.after;
+            break;
+        case JournalOp::REMOVE_SERVER:
+            state.servers.erase(record.serverId);
+            break;
+        case JournalOp::SET_LOAD:
+            state.servers[record.serverId].load = record.after;
+            break;
+        case JournalOp::SET_ONLINE:
+            state.servers[record.serverId].online = record.after != 0;
+            break;
+        case JournalOp::SET_MULTIPLIER:
+            state.servers[record.serverId].multiplier = OperationJournal::decodeMultiplier(record.after);
+            break;
+        case JournalOp::SET_CAPACITY:
+            state.servers[record.serverId].capacity = record.after;
+            break;
+        case JournalOp::SET_ALGORITHM:
+            state.algorithm = static_cast<BalancingAlgorithm>(record.after);
+            break;
+        case JournalOp::PLACEMENT:
+        case JournalOp::HEALTH:
+            break;
+        case JournalOp::SET_STATUS:
+            state.servers[record.serverId].status = OperationJournal::decodeStatus(record.after);
+            break;
+        case JournalOp::SET_ZONE:
+            state.servers[record.serverId].zone = record.after;
+            break;
+        case JournalOp::SET_COST:
+            state.servers[record.serverId].costPerUnit = OperationJournal::decodeMultiplier(record.after);
+            break;
+        case JournalOp::SET_IDLE_POWER:
+            state.servers[record.serverId].idlePowerWatts = OperationJournal::decodeWatts(record.after);
+            break;
+        case JournalOp::SET_PEAK_POWER:
+            state.servers[record.serverId].peakPowerWatts = OperationJournal::decodeWatts(record.after);
+            break;
+        case JournalOp::SET_TENANT_USAGE:
+            state.tenantUsage[record.serverId] = record.after;
+            break;
+    }
+    state.position++;
+}
+
+ReplayState JournalReplayer::stateAt(size_t position) {
+    position = std::min(position, journal.size());
+
+    // Checkpoints past a discarded redo tail no longer describe the journal
+    if (generation != journal.getGeneration()) {
+        checkpoints.resize(1);
+        generation = journal.getGeneration();
+    }
+
+    size_t nearest = std::min(position / checkpointInterval, checkpoints.size() - 1);
+    ReplayState state = checkpoints[nearest];
+
+    while (state.position < position) {
+        apply(state, journal[state.position]);
+        if (state.position % checkpointInterval == 0 && state.position / checkpointInterval == checkpoints.size()) {
+            checkpoints.push_back(state);
+        }
+    }
+    return state;
+}
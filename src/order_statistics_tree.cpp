@@ -0,0 +1,207 @@
+// order_statistics_tree.cpp
+#include "include/order_statistics_tree.h"
+
+OrderStatisticsTree::OrderStatisticsTree() : root(-1), rngState(0x9E3779B9u) {
+}
+
+bool OrderStatisticsTree::less(double value, int id, const Node& node) {
+    return value < node.value || (value == node.value && id < node.id);
+}
+
+bool OrderStatisticsTree::before(const Node& node, double value, int id) {
+    return node.value < value || (node.value == value && node.id < id);
+}
+
+uint32_t OrderStatisticsTree::nextPriority() {
+    // xorshift32; priorities only need to be well spread, not unpredictable
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+int OrderStatisticsTree::count(int node) const {
+    return node < 0 ? 0 : nodes[node].count;
+}
+
+double OrderStatisticsTree::sum(int node) const {
+    return node < 0 ? 0.0 : nodes[node].sum;
+}
+
+double OrderStatisticsTree::squares(int node) const {
+    return node < 0 ? 0.0 : nodes[node].squares;
+}
+
+void OrderStatisticsTree::pull(int node) {
+    Node& n = nodes[node];
+    n.count = 1 + count(n.left) + count(n.right);
+    n.sum = n.value + sum(n.left) + sum(n.right);
+    n.squares = n.value * n.value + squares(n.left) + squares(n.right);
+}
+
+// left receives the keys before (value, id), right the rest
+void OrderStatisticsTree::split(int node, double value, int id, int& left, int& right) {
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    if (before(nodes[node], value, id)) {
+        split(nodes[node].right, value, id, nodes[node].right, right);
+        left = node;
+    } else {
+        split(nodes[node].left, value, id, left, nodes[node].left);
+        right = node;
+    }
+    pull(node);
+}
+
+int OrderStatisticsTree::merge(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        pull(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    pull(right);
+    return right;
+}
+
+int OrderStatisticsTree::insertAt(int node, int created) {
+    if (node < 0) return created;
+    Node& c = nodes[created];
+    if (c.priority > nodes[node].priority) {
+        int left, right;
+        split(node, c.value, c.id, left, right);
+        nodes[created].left = left;
+        nodes[created].right = right;
+        pull(created);
+        return created;
+    }
+    if (less(c.value, c.id, nodes[node])) {
+        int child = insertAt(nodes[node].left, created);
+        nodes[node].left = child;
+    } else {
+        int child = insertAt(nodes[node].right, created);
+        nodes[node].right = child;
+    }
+    pull(node);
+    return node;
+}
+
+int OrderStatisticsTree::eraseAt(int node, double value, int id, bool& erased) {
+    if (node < 0) return -1;
+    const Node& n = nodes[node];
+    if (n.value == value && n.id == id) {
+        erased = true;
+        freeSlots.push_back(node);
+        return merge(n.left, n.right);
+    }
+    if (less(value, id, n)) {
+        int child = eraseAt(n.left, value, id, erased);
+        nodes[node].left = child;
+    } else {
+        int child = eraseAt(n.right, value, id, erased);
+        nodes[node].right = child;
+    }
+    pull(node);
+    return node;
+}
+
+void OrderStatisticsTree::insert(double value, int id) {
+    int created;
+    if (!freeSlots.empty()) {
+        created = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        created = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[created] = Node{value, id, nextPriority(), -1, -1, 1, value, value * value};
+    root = insertAt(root, created);
+}
+
+bool OrderStatisticsTree::erase(double value, int id) {
+    bool erased = false;
+    root = eraseAt(root, value, id, erased);
+    return erased;
+}
+
+void OrderStatisticsTree::clear() {
+    nodes.clear();
+    freeSlots.clear();
+    root = -1;
+}
+
+int OrderStatisticsTree::size() const {
+    return count(root);
+}
+
+double OrderStatisticsTree::total() const {
+    return sum(root);
+}
+
+double OrderStatisticsTree::totalSquares() const {
+    return squares(root);
+}
+
+double OrderStatisticsTree::maxValue() const {
+    int node = root;
+    if (node < 0) return 0.0;
+    while (nodes[node].right >= 0) {
+        node = nodes[node].right;
+    }
+    return nodes[node].value;
+}
+
+int OrderStatisticsTree::countLess(double value, int id) const {
+    int result = 0;
+    int node = root;
+    while (node >= 0) {
+        const Node& n = nodes[node];
+        if (before(n, value, id)) {
+            result += count(n.left) + 1;
+            node = n.right;
+        } else {
+            node = n.left;
+        }
+    }
+    return result;
+}
+
+void OrderStatisticsTree::prefix(double value, int id, int& countBefore, double& sumBefore) const {
+    countBefore = 0;
+    sumBefore = 0.0;
+    int node = root;
+    while (node >= 0) {
+        const Node& n = nodes[node];
+        if (before(n, value, id)) {
+            countBefore += count(n.left) + 1;
+            sumBefore += sum(n.left) + n.value;
+            node = n.right;
+        } else {
+            node = n.left;
+        }
+    }
+}
+
+bool OrderStatisticsTree::select(int k, double& value, int& id) const {
+    if (k < 0 || k >= size()) return false;
+    int node = root;
+    while (node >= 0) {
+        const Node& n = nodes[node];
+        int leftCount = count(n.left);
+        if (k < leftCount) {
+            node = n.left;
+        } else if (k == leftCount) {
+            value = n.value;
+            id = n.id;
+            return true;
+        } else {
+            k -= leftCount + 1;
+            node = n.right;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,223 @@
+// request_tracer.cpp
+#include "include/request_tracer.h"
+#include "include/trace_event_writer.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+std::atomic<uint64_t> tracerInstances{1};
+
+// Per-thread cache of the ring registered with the most recently used tracer
+struct ThreadRingCache {
+    uint64_t instanceId = 0;
+    void* ring = nullptr;
+};
+
+thread_local ThreadRingCache ringCache;
+
+// Every ring this thread registered, by tracer; instance ids are never reused, so
+// entries of destroyed tracers are simply never looked up again
+thread_local std::unordered_map<uint64_t, void*> threadRings;
+
+uint64_t& threadSampleState() {
+    thread_local uint64_t state = 0x9E3779B97F4A7C15ULL ^
+        reinterpret_cast<uintptr_t>(&ringCache);
+    return state;
+}
+
+template <typename T>
+void writeField(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+RequestTracer::SpanRing::SpanRing(size_t capacity, int threadIndex)
+    : slots(capacity), head(0), threadIndex(threadIndex) {
+}
+
+RequestTracer::RequestTracer(double sampleRate, size_t ringCapacity)
+    : instanceId(tracerInstances.fetch_add(1)),
+      sampleThreshold(0),
+      ringCapacity(std::max<size_t>(ringCapacity, 1)),
+      startTime(std::chrono::steady_clock::now()),
+      nextRequestId(1) {
+    setSampleRate(sampleRate);
+}
+
+void RequestTracer::setSampleRate(double sampleRate) {
+    sampleRate = std::max(0.0, std::min(1.0, sampleRate));
+    if (sampleRate >= 1.0) {
+        sampleThreshold = UINT64_MAX;
+    } else {
+        sampleThreshold = static_cast<uint64_t>(sampleRate * 18446744073709551616.0);
+    }
+}
+
+double RequestTracer::getSampleRate() const {
+    return static_cast<double>(sampleThreshold) / 18446744073709551616.0;
+}
+
+bool RequestTracer::sample() const {
+    if (sampleThreshold == 0) return false;
+
+    // xorshift64
+    uint64_t& x = threadSampleState();
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x < sampleThreshold || sampleThreshold == UINT64_MAX;
+}
+
+uint64_t RequestTracer::newRequestId() {
+    return nextRequestId.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t RequestTracer::nowNs() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+RequestTracer::SpanRing* RequestTracer::threadRing() {
+    if (ringCache.instanceId == instanceId) {
+        return static_cast<SpanRing*>(ringCache.ring);
+    }
+
+    // Threads alternating between tracers keep one ring per tracer
+    void*& ring = threadRings[instanceId];
+    if (!ring) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::unique_ptr<SpanRing>(
+            new SpanRing(ringCapacity, static_cast<int>(rings.size()))));
+        ring = rings.back().get();
+    }
+    ringCache.instanceId = instanceId;
+    ringCache.ring = ring;
+    return static_cast<SpanRing*>(ring);
+}
+
+void RequestTracer::record(const RequestSpan& span) {
+    SpanRing* ring = threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    RequestSpan& slot = ring->slots[head % ring->slots.size()];
+    slot = span;
+    slot.threadIndex = ring->threadIndex;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<RequestSpan> RequestTracer::collect() const {
+    std::vector<RequestSpan> spans;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+
+    for (auto& ring : rings) {
+        uint64_t capacity = ring->slots.size();
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > capacity ? head - capacity : 0;
+
+        size_t copiedFrom = spans.size();
+        for (uint64_t i = first; i < head; i++) {
+            spans.push_back(ring->slots[i % capacity]);
+        }
+
+        // Discard slots the writer may have overwritten during the copy, including
+        // the one it may be writing now (span headAfter, which reuses headAfter - capacity)
+        uint64_t headAfter = ring->head.load(std::memory_order_acquire);
+        uint64_t safeFirst = headAfter + 1 > capacity ? headAfter + 1 - capacity : 0;
+        if (safeFirst > first) {
+            size_t lapped = static_cast<size_t>(std::min(safeFirst - first, head - first));
+            spans.erase(spans.begin() + copiedFrom, spans.begin() + copiedFrom + lapped);
+        }
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const RequestSpan& a, const RequestSpan& b) {
+        return a.arrivalNs < b.arrivalNs;
+    });
+    return spans;
+}
+
+bool RequestTracer::exportBinary(const std::string& path) const {
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open trace file " << path << std::endl;
+        return false;
+    }
+
+    std::vector<RequestSpan> spans = collect();
+
+    // Header: magic, version, span count. Each span stores only its used candidates
+    // and placements.
+    out.write("LBTR", 4);
+    writeField(out, static_cast<uint32_t>(1));
+    writeField(out, static_cast<uint64_t>(spans.size()));
+
+    for (const auto& span : spans) {
+        writeField(out, span.requestId);
+        writeField(out, span.arrivalNs);
+        writeField(out, span.dispatchNs);
+        writeField(out, span.completionNs);
+        writeField(out, static_cast<int32_t>(span.algorithm));
+        writeField(out, static_cast<int32_t>(span.loadAmount));
+        writeField(out, static_cast<int32_t>(span.chosenServerId));
+        writeField(out, static_cast<int32_t>(span.candidateCount));
+        writeField(out, static_cast<int32_t>(span.threadIndex));
+
+        int storedCandidates = std::min(span.candidateCount, kMaxTraceCandidates);
+        writeField(out, static_cast<uint16_t>(storedCandidates));
+        for (int i = 0; i < storedCandidates; i++) {
+            writeField(out, static_cast<int32_t>(span.candidates[i].serverId));
+            writeField(out, span.candidates[i].score);
+        }
+
+        writeField(out, static_cast<uint16_t>(span.placementCount));
+        for (int i = 0; i < span.placementCount; i++) {
+            writeField(out, static_cast<int32_t>(span.placements[i].serverId));
+            writeField(out, static_cast<int32_t>(span.placements[i].amount));
+        }
+    }
+
+    return out.good();
+}
+
+bool RequestTracer::exportChromeTrace(const std::string& path) const {
+    TraceEventWriter writer(path);
+    if (!writer.isOpen()) {
+        return false;
+    }
+
+    std::vector<RequestSpan> spans = collect();
+    writer.setProcessName("Request traces");
+
+    for (const auto& span : spans) {
+        std::stringstream args;
+        args << "{\"request\":" << span.requestId
+             << ",\"algorithm\":" << span.algorithm
+             << ",\"load\":" << span.loadAmount
+             << ",\"chosen\":" << span.chosenServerId
+             << ",\"queueWaitUs\":" << (span.dispatchNs - span.arrivalNs) / 1000.0
+             << ",\"candidateCount\":" << span.candidateCount
+             << ",\"candidates\":[";
+
+        int storedCandidates = std::min(span.candidateCount, kMaxTraceCandidates);
+        for (int i = 0; i < storedCandidates; i++) {
+            if (i > 0) args << ",";
+            args << "[" << span.candidates[i].serverId << "," << span.candidates[i].score << "]";
+        }
+
+        args << "],\"placements\":[";
+        for (int i = 0; i < span.placementCount; i++) {
+            if (i > 0) args << ",";
+            args << "[" << span.placements[i].serverId << "," << span.placements[i].amount << "]";
+        }
+        args << "]}";
+
+        // Complete event covering arrival to completion
+        writer.complete("place", "request", span.threadIndex, span.arrivalNs / 1000.0,
+                        (span.completionNs - span.arrivalNs) / 1000.0, args.str());
+    }
+
+    return writer.close();
+}
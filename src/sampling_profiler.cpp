@@ -0,0 +1,202 @@
+// sampling_profiler.cpp
+#include "include/sampling_profiler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <csignal>
+#include <sys/time.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+
+namespace {
+
+// Read from the signal handler, so it must stay a plain TLS int
+thread_local int currentPhase = static_cast<int>(ProfilePhase::OTHER);
+
+// Frames belonging to the handler and the kernel signal trampoline
+const int kHandlerFrames = 2;
+
+struct sigaction previousAction;
+
+} // namespace
+
+ProfilePhaseScope::ProfilePhaseScope(ProfilePhase phase) : previousPhase(currentPhase) {
+    currentPhase = static_cast<int>(phase);
+}
+
+ProfilePhaseScope::~ProfilePhaseScope() {
+    currentPhase = previousPhase;
+}
+
+std::atomic<SamplingProfiler*> SamplingProfiler::activeProfiler{nullptr};
+
+SamplingProfiler::SamplingProfiler()
+    : capacity(0), nextSample(0), droppedSamples(0), frequencyHz(0), running(false) {
+}
+
+SamplingProfiler& SamplingProfiler::instance() {
+    static SamplingProfiler profiler;
+    return profiler;
+}
+
+void SamplingProfiler::handleSignal(int) {
+    SamplingProfiler* profiler = activeProfiler.load(std::memory_order_acquire);
+    if (!profiler) return;
+
+    size_t index = profiler->nextSample.fetch_add(1, std::memory_order_relaxed);
+    if (index >= profiler->capacity) {
+        profiler->droppedSamples.fetch_add(1, std::memory_order_relaxed);
+        if (index == profiler->capacity) {
+            // Buffer full: disarm; signals already pending are only counted
+            struct itimerval timer = {};
+            setitimer(ITIMER_PROF, &timer, nullptr);
+        }
+        return;
+    }
+
+    Sample& sample = profiler->samples[index];
+    sample.phase = currentPhase;
+    sample.depth = backtrace(sample.frames, kMaxFrames);
+}
+
+bool SamplingProfiler::start(int frequency, double durationSeconds) {
+    if (running) {
+        std::cerr << "Sampling profiler already running" << std::endl;
+        return false;
+    }
+
+    frequencyHz = std::max(1, std::min(frequency, 10000));
+    capacity = static_cast<size_t>(std::max(1.0, frequencyHz * durationSeconds));
+    samples.reset(new Sample[capacity]);
+    nextSample.store(0);
+    droppedSamples.store(0);
+
+    // The first backtrace() call may load libgcc and allocate; never let that
+    // happen inside the handler
+    void* warmup[4];
+    backtrace(warmup, 4);
+
+    struct sigaction action = {};
+    action.sa_handler = &SamplingProfiler::handleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previousAction) != 0) {
+        std::cerr << "Failed to install SIGPROF handler" << std::endl;
+        return false;
+    }
+
+    activeProfiler.store(this, std::memory_order_release);
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / frequencyHz;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        std::cerr << "Failed to start profiling timer" << std::endl;
+        activeProfiler.store(nullptr);
+        sigaction(SIGPROF, &previousAction, nullptr);
+        return false;
+    }
+
+    running = true;
+    std::cout << "Sampling profiler started at " << frequencyHz << " Hz for "
+              << durationSeconds << " s of CPU time" << std::endl;
+    return true;
+}
+
+void SamplingProfiler::stop() {
+    if (!running) return;
+
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    activeProfiler.store(nullptr, std::memory_order_release);
+    sigaction(SIGPROF, &previousAction, nullptr);
+    running = false;
+
+    std::cout << "Sampling profiler stopped: " << getSampleCount() << " samples" << std::endl;
+}
+
+bool SamplingProfiler::isRunning() const {
+    return running;
+}
+
+size_t SamplingProfiler::getSampleCount() const {
+    return std::min(nextSample.load(), capacity);
+}
+
+size_t SamplingProfiler::getDroppedSamples() const {
+    return droppedSamples.load();
+}
+
+std::string SamplingProfiler::symbolize(void* address) {
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = (status == 0 && demangled) ? demangled : info.dli_sname;
+        std::free(demangled);
+
+        // Semicolons separate frames in the folded format
+        std::replace(name.begin(), name.end(), ';', ':');
+        return name;
+    }
+
+    std::stringstream ss;
+    ss << address;
+    return ss.str();
+}
+
+std::vector<std::string> SamplingProfiler::foldedStacks() const {
+    std::map<std::string, int> counts;
+    std::map<void*, std::string> symbols;
+
+    size_t sampleCount = getSampleCount();
+    for (size_t i = 0; i < sampleCount; i++) {
+        const Sample& sample = samples[i];
+
+        std::string stack = phaseToString(static_cast<ProfilePhase>(sample.phase));
+        for (int f = sample.depth - 1; f >= kHandlerFrames; f--) {
+            auto it = symbols.find(sample.frames[f]);
+            if (it == symbols.end()) {
+                it = symbols.emplace(sample.frames[f], symbolize(sample.frames[f])).first;
+            }
+            stack += ";" + it->second;
+        }
+        counts[stack]++;
+    }
+
+    std::vector<std::string> lines;
+    for (const auto& entry : counts) {
+        lines.push_back(entry.first + " " + std::to_string(entry.second));
+    }
+    return lines;
+}
+
+bool SamplingProfiler::writeFoldedStacks(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open profile output " << path << std::endl;
+        return false;
+    }
+
+    for (const auto& line : foldedStacks()) {
+        out << line << "\n";
+    }
+
+    std::cout << "Folded stacks written to " << path << std::endl;
+    return out.good();
+}
+
+std::string SamplingProfiler::phaseToString(ProfilePhase phase) {
+    switch (phase) {
+        case ProfilePhase::DISPATCH:      return "dispatch";
+        case ProfilePhase::HEALTH_UPDATE: return "health_update";
+        case ProfilePhase::METRICS:       return "metrics";
+        case ProfilePhase::RENDERING:     return "rendering";
+        default:                          return "other";
+    }
+}
@@ -1,10 +1,12 @@
 // server_health.cc
 #include "include/server_health.h"
+#include "include/sampling_profiler.h"
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 
 ServerHealthSimulator::ServerHealthSimulator() 
-    : rng(std::random_device{}()) {
+    : rng(std::random_device{}()), thermalEnabled(false), overloadEnabled(false) {
     
     // Initialize state labels
     stateLabels[ServerState::HEALTHY] = "HEALTHY";
@@ -32,19 +34,34 @@ void ServerHealthSimulator::addServer(int serverId) {
     newServer.recoveryProbability = 0.2;  // 20% chance of recovery per update when degraded
     newServer.lastStateChange = std::chrono::system_clock::now();
     newServer.performanceMultiplier = 1.0;
+    newServer.thermalThrottle = 1.0;
     
     servers.push_back(newServer);
+    loadFraction.push_back(0.0);
+    temperature.push_back(thermal.ambient);
+    throttle.push_back(1.0);
+    overloadExcess.push_back(0.0);
+    overloadPressure.push_back(0.0);
+    overloadDegraded.push_back(0);
 }
 
 void ServerHealthSimulator::removeServer(int serverId) {
-    servers.erase(
-        std::remove_if(servers.begin(), servers.end(),
-                      [serverId](const ServerHealth& sh) { return sh.serverId == serverId; }),
-        servers.end()
-    );
+    auto it = std::find_if(servers.begin(), servers.end(),
+                           [serverId](const ServerHealth& sh) { return sh.serverId == serverId; });
+    if (it == servers.end()) return;
+    
+    size_t index = it - servers.begin();
+    servers.erase(it);
+    loadFraction.erase(loadFraction.begin() + index);
+    temperature.erase(temperature.begin() + index);
+    throttle.erase(throttle.begin() + index);
+    overloadExcess.erase(overloadExcess.begin() + index);
+    overloadPressure.erase(overloadPressure.begin() + index);
+    overloadDegraded.erase(overloadDegraded.begin() + index);
 }
 
 void ServerHealthSimulator::updateServerStates() {
+    ProfilePhaseScope phase(ProfilePhase::HEALTH_UPDATE);
     std::uniform_real_distribution<> dist(0.0, 1.0);
     
     for (auto& server : servers) {
@@ -72,7 +89,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 }
                 break;
@@ -91,7 +108,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 } 
                 else if (randomValue > (1.0 - server.failureProbability * 2)) {
@@ -106,7 +123,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 }
                 break;
@@ -125,7 +142,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 } 
                 else if (randomValue > (1.0 - server.failureProbability * 3)) {
@@ -140,7 +157,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 }
                 break;
@@ -158,7 +175,7 @@ void ServerHealthSimulator::updateServerStates() {
                     }
                     
                     if (performanceUpdateCallback) {
-                        performanceUpdateCallback(server.serverId, server.performanceMultiplier);
+                        performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
                     }
                 }
                 break;
@@ -195,7 +212,7 @@ double ServerHealthSimulator::getServerPerformanceMultiplier(int serverId) const
                            [serverId](const ServerHealth& sh) { return sh.serverId == serverId; });
     
     if (it != servers.end()) {
-        return it->performanceMultiplier;
+        return effectiveMultiplier(*it);
     }
     
     // Default to 1.0 if server not found
@@ -243,7 +260,7 @@ void ServerHealthSimulator::setServerState(int serverId, ServerState state) {
         }
         
         if (performanceUpdateCallback) {
-            performanceUpdateCallback(serverId, it->performanceMultiplier);
+            performanceUpdateCallback(serverId, effectiveMultiplier(*it));
         }
     }
 }
@@ -281,7 +298,7 @@ void ServerHealthSimulator::degradeServerPerformance(int serverId, double degrad
         }
         
         if (performanceUpdateCallback) {
-            performanceUpdateCallback(serverId, it->performanceMultiplier);
+            performanceUpdateCallback(serverId, effectiveMultiplier(*it));
         }
     }
 }
@@ -301,7 +318,7 @@ void ServerHealthSimulator::recoverServer(int serverId) {
         }
         
         if (performanceUpdateCallback) {
-            performanceUpdateCallback(serverId, 1.0);
+            performanceUpdateCallback(serverId, effectiveMultiplier(*it));
         }
     }
 }
@@ -357,6 +374,241 @@ void ServerHealthSimulator::simulateHighLoad(int serverId) {
     }
 }
 
+double ServerHealthSimulator::effectiveMultiplier(const ServerHealth& server) const {
+    return server.performanceMultiplier * server.thermalThrottle;
+}
+
+void ServerHealthSimulator::enableThermalModel(const ThermalParams& params) {
+    thermal = params;
+    thermal.throttleMax = std::max(thermal.throttleMax, thermal.throttleStart + 1.0);
+    thermal.minThrottle = std::max(0.0, std::min(1.0, thermal.minThrottle));
+    thermalEnabled = true;
+    
+    std::fill(temperature.begin(), temperature.end(), thermal.ambient);
+}
+
+void ServerHealthSimulator::disableThermalModel() {
+    thermalEnabled = false;
+    
+    // Lift any throttling still in place
+    std::fill(throttle.begin(), throttle.end(), 1.0);
+    for (auto& server : servers) {
+        if (server.thermalThrottle != 1.0) {
+            server.thermalThrottle = 1.0;
+            if (performanceUpdateCallback) {
+                performanceUpdateCallback(server.serverId, effectiveMultiplier(server));
+            }
+        }
+    }
+}
+
+bool ServerHealthSimulator::isThermalModelEnabled() const {
+    return thermalEnabled;
+}
+
+void ServerHealthSimulator::thermalStep(double dt) {
+    const size_t count = servers.size();
+    const double* load = loadFraction.data();
+    double* temp = temperature.data();
+    double* scale = throttle.data();
+    
+    const double ambient = thermal.ambient;
+    const double heating = thermal.heatingRate * dt;
+    const double cooling = std::min(1.0, thermal.coolingRate * dt);
+    const double start = thermal.throttleStart;
+    const double floor = thermal.minThrottle;
+    const double slope = (1.0 - thermal.minThrottle) / (thermal.throttleMax - thermal.throttleStart);
+    
+    for (size_t i = 0; i < count; i++) {
+        double t = temp[i] + heating * load[i] - cooling * (temp[i] - ambient);
+        double over = std::max(0.0, t - start);
+        temp[i] = t;
+        scale[i] = std::max(floor, 1.0 - over * slope);
+    }
+}
+
+void ServerHealthSimulator::enableOverloadModel(const OverloadParams& params) {
+    overload = params;
+    overload.threshold = std::max(0.0, std::min(0.99, overload.threshold));
+    overloadEnabled = true;
+    
+    std::fill(overloadPressure.begin(), overloadPressure.end(), 0.0);
+}
+
+void ServerHealthSimulator::disableOverloadModel() {
+    overloadEnabled = false;
+    std::fill(overloadExcess.begin(), overloadExcess.end(), 0.0);
+    std::fill(overloadPressure.begin(), overloadPressure.end(), 0.0);
+    std::fill(overloadDegraded.begin(), overloadDegraded.end(), 0);
+}
+
+bool ServerHealthSimulator::isOverloadModelEnabled() const {
+    return overloadEnabled;
+}
+
+double ServerHealthSimulator::getServerOverloadPressure(int serverId) const {
+    auto it = std::find_if(servers.begin(), servers.end(),
+                           [serverId](const ServerHealth& sh) { return sh.serverId == serverId; });
+    
+    if (it != servers.end()) {
+        return overloadPressure[it - servers.begin()];
+    }
+    
+    return 0.0;
+}
+
+bool ServerHealthSimulator::isLoadCoupled() const {
+    return thermalEnabled || overloadEnabled;
+}
+
+void ServerHealthSimulator::overloadStep(double dt) {
+    const size_t count = servers.size();
+    overloadServing.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        overloadServing[i] = servers[i].state == ServerState::OFFLINE ? 0.0 : 1.0;
+    }
+    
+    const double* load = loadFraction.data();
+    const double* serving = overloadServing.data();
+    double* excess = overloadExcess.data();
+    double* pressure = overloadPressure.data();
+    
+    const double threshold = overload.threshold;
+    const double accrual = overload.accrualRate * dt;
+    const double relief = overload.relief * dt;
+    const double keep = 1.0 - std::min(1.0, relief);
+    
+    // Offline servers shed excess instead of measuring it, and build no pressure
+    if (overload.queueingCollapse) {
+        // Queueing delay grows as u/(1-u), so pressure climbs steeply near saturation
+        const double base = threshold / (1.0 - threshold);
+        for (size_t i = 0; i < count; i++) {
+            double u = std::min(load[i], 0.99);
+            double measured = std::max(0.0, u / (1.0 - u) - base);
+            double e = serving[i] * measured + (1.0 - serving[i]) * std::max(0.0, excess[i] * keep - relief);
+            excess[i] = e;
+            pressure[i] = std::max(0.0, pressure[i] + accrual * e * serving[i] - relief * (e == 0.0));
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            double measured = std::max(0.0, load[i] - threshold);
+            double e = serving[i] * measured + (1.0 - serving[i]) * std::max(0.0, excess[i] * keep - relief);
+            excess[i] = e;
+            pressure[i] = std::max(0.0, pressure[i] + accrual * e * serving[i] - relief * (e == 0.0));
+        }
+    }
+}
+
+void ServerHealthSimulator::applyOverloadTransitions() {
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    
+    // Collected first: state changes run callbacks that may touch the simulator
+    std::vector<std::pair<int, ServerState>> transitions;
+    
+    for (size_t i = 0; i < servers.size(); i++) {
+        const ServerHealth& server = servers[i];
+        if (server.state == ServerState::HEALTHY) overloadDegraded[i] = 0;
+        
+        if (overloadExcess[i] > 0.0) {
+            if (server.state == ServerState::OFFLINE) continue;
+            
+            // A GC pause under pressure fails health checks outright; otherwise the
+            // server degrades one level with probability equal to its pressure
+            double pause = overload.gcPauseProbability * std::min(1.0, overloadExcess[i]);
+            if (dist(rng) < pause) {
+                transitions.emplace_back(server.serverId, ServerState::OFFLINE);
+                overloadPressure[i] = 0.0;
+                overloadDegraded[i] = 1;
+            } else if (dist(rng) < overloadPressure[i]) {
+                ServerState next = (server.state == ServerState::HEALTHY)  ? ServerState::DEGRADED :
+                                   (server.state == ServerState::DEGRADED) ? ServerState::CRITICAL :
+                                                                             ServerState::OFFLINE;
+                transitions.emplace_back(server.serverId, next);
+                overloadPressure[i] *= 0.5;
+                overloadDegraded[i] = 1;
+            }
+        } else if (overloadDegraded[i] && overloadPressure[i] == 0.0) {
+            // Relieved servers climb back one level at a time; random failures
+            // recover on their own schedule
+            if (dist(rng) < server.recoveryProbability) {
+                ServerState next = (server.state == ServerState::OFFLINE)  ? ServerState::CRITICAL :
+                                   (server.state == ServerState::CRITICAL) ? ServerState::DEGRADED :
+                                                                             ServerState::HEALTHY;
+                transitions.emplace_back(server.serverId, next);
+            }
+        }
+    }
+    
+    for (const auto& transition : transitions) {
+        setServerState(transition.first, transition.second);
+    }
+}
+
+void ServerHealthSimulator::updateLoadEffects(const std::vector<std::pair<int, double>>& serverLoads, double dt) {
+    if (!isLoadCoupled()) return;
+    ProfilePhaseScope phase(ProfilePhase::HEALTH_UPDATE);
+    
+    // Callers usually list servers in the order they were added, so try the
+    // matching slot before searching
+    for (size_t i = 0; i < serverLoads.size(); i++) {
+        int serverId = serverLoads[i].first;
+        size_t index = i;
+        if (index >= servers.size() || servers[index].serverId != serverId) {
+            auto it = std::find_if(servers.begin(), servers.end(),
+                                   [serverId](const ServerHealth& sh) { return sh.serverId == serverId; });
+            if (it == servers.end()) continue;
+            index = it - servers.begin();
+        }
+        loadFraction[index] = std::max(0.0, serverLoads[i].second);
+    }
+    
+    if (thermalEnabled) {
+        thermalStep(dt);
+        
+        // Only report throttle changes large enough to matter for placement
+        for (size_t i = 0; i < servers.size(); i++) {
+            bool cooledOff = throttle[i] == 1.0 && servers[i].thermalThrottle != 1.0;
+            if (std::abs(throttle[i] - servers[i].thermalThrottle) < 0.01 && !cooledOff) {
+                continue;
+            }
+            
+            servers[i].thermalThrottle = throttle[i];
+            if (performanceUpdateCallback && servers[i].state != ServerState::OFFLINE) {
+                performanceUpdateCallback(servers[i].serverId, effectiveMultiplier(servers[i]));
+            }
+        }
+    }
+    
+    if (overloadEnabled) {
+        overloadStep(dt);
+        applyOverloadTransitions();
+    }
+}
+
+double ServerHealthSimulator::getServerTemperature(int serverId) const {
+    auto it = std::find_if(servers.begin(), servers.end(),
+                           [serverId](const ServerHealth& sh) { return sh.serverId == serverId; });
+    
+    if (it != servers.end()) {
+        return temperature[it - servers.begin()];
+    }
+    
+    return thermal.ambient;
+}
+
+double ServerHealthSimulator::getPeakTemperature() const {
+    if (temperature.empty()) return thermal.ambient;
+    return *std::max_element(temperature.begin(), temperature.end());
+}
+
+int ServerHealthSimulator::getThrottledServerCount() const {
+    int count = 0;
+    for (const auto& server : servers) {
+        if (server.thermalThrottle < 1.0) count++;
+    }
+    return count;
+}
+
 std::string ServerHealthSimulator::stateToString(ServerState state) {
     switch (state) {
         case ServerState::HEALTHY:  return "HEALTHY";
@@ -0,0 +1,80 @@
+// shuffle_sharding.cpp
+#include "include/shuffle_sharding.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+ShuffleSharder::ShuffleSharder(const KeyHasher& hasher, int shardSize)
+    : hasher(hasher), shardSize(std::max(1, shardSize)) {
+}
+
+int ShuffleSharder::getShardSize() const {
+    return shardSize;
+}
+
+std::vector<int> ShuffleSharder::shardFor(int tenantId, const std::vector<int>& serverIds) const {
+    if (static_cast<int>(serverIds.size()) <= shardSize) {
+        std::vector<int> shard = serverIds;
+        std::sort(shard.begin(), shard.end());
+        return shard;
+    }
+
+    // hashPair(server, tenant) for every server in one batch
+    uint64_t tenantKey = hasher.hashInt(static_cast<uint64_t>(tenantId));
+    std::vector<uint64_t> keys(serverIds.size());
+    for (size_t i = 0; i < serverIds.size(); i++) {
+        keys[i] = static_cast<uint64_t>(serverIds[i]) ^ tenantKey;
+    }
+    std::vector<uint64_t> scores(serverIds.size());
+    hasher.hashIntBatch(keys.data(), scores.data(), keys.size());
+
+    std::vector<std::pair<uint64_t, int>> ranked(serverIds.size());
+    for (size_t i = 0; i < serverIds.size(); i++) {
+        ranked[i] = std::make_pair(scores[i], serverIds[i]);
+    }
+    std::nth_element(ranked.begin(), ranked.begin() + shardSize, ranked.end(),
+                     std::greater<std::pair<uint64_t, int>>());
+
+    std::vector<int> shard;
+    shard.reserve(shardSize);
+    for (int i = 0; i < shardSize; i++) {
+        shard.push_back(ranked[i].second);
+    }
+    std::sort(shard.begin(), shard.end());
+    return shard;
+}
+
+ShardIsolationReport ShuffleSharder::analyzeIsolation(int poisonedTenant, const std::vector<int>& tenantIds,
+                                                      const std::vector<int>& serverIds) const {
+    ShardIsolationReport report;
+    report.poisonedTenant = poisonedTenant;
+    report.shardSize = std::min<int>(shardSize, static_cast<int>(serverIds.size()));
+    report.tenantCount = 0;
+    report.fullyOverlapping = 0;
+    report.meanOverlap = 0.0;
+
+    std::vector<int> poisonedShard = shardFor(poisonedTenant, serverIds);
+    long long totalOverlap = 0;
+
+    for (int tenantId : tenantIds) {
+        if (tenantId == poisonedTenant) continue;
+
+        std::vector<int> shard = shardFor(tenantId, serverIds);
+        std::vector<int> shared;
+        std::set_intersection(shard.begin(), shard.end(), poisonedShard.begin(), poisonedShard.end(),
+                              std::back_inserter(shared));
+
+        int overlap = static_cast<int>(shared.size());
+        report.overlapHistogram[overlap]++;
+        report.tenantCount++;
+        totalOverlap += overlap;
+        if (overlap == static_cast<int>(shard.size()) && !shard.empty()) {
+            report.fullyOverlapping++;
+        }
+    }
+
+    if (report.tenantCount > 0) {
+        report.meanOverlap = static_cast<double>(totalOverlap) / report.tenantCount;
+    }
+    return report;
+}
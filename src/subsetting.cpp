@@ -0,0 +1,107 @@
+// subsetting.cpp
+#include "include/subsetting.h"
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+DeterministicSubsetter::DeterministicSubsetter(int clientId, int subsetSize, uint64_t seed)
+    : clientId(clientId), subsetSize(subsetSize), seed(seed) {
+    if (this->clientId < 0) this->clientId = 0;
+    if (this->subsetSize < 1) this->subsetSize = 1;
+}
+
+int DeterministicSubsetter::getClientId() const {
+    return clientId;
+}
+
+int DeterministicSubsetter::getSubsetSize() const {
+    return subsetSize;
+}
+
+std::vector<int> DeterministicSubsetter::roundOrder(const std::vector<int>& sortedIds, int round) const {
+    std::vector<int> order = sortedIds;
+
+    // Fisher-Yates with a standardized engine so every instance derives the same order
+    // (std::shuffle is implementation-defined across standard libraries)
+    std::mt19937_64 roundRng(seed ^ (static_cast<uint64_t>(round) * 0x9E3779B97F4A7C15ULL));
+    for (size_t i = order.size(); i > 1; i--) {
+        size_t j = static_cast<size_t>(roundRng() % i);
+        std::swap(order[i - 1], order[j]);
+    }
+
+    return order;
+}
+
+std::vector<int> DeterministicSubsetter::computeSubset(const std::vector<int>& serverIds) const {
+    std::vector<int> sortedIds = serverIds;
+    std::sort(sortedIds.begin(), sortedIds.end());
+
+    if (static_cast<int>(sortedIds.size()) <= subsetSize) {
+        return sortedIds;
+    }
+
+    int subsetCount = static_cast<int>(sortedIds.size()) / subsetSize;
+    int round = clientId / subsetCount;
+    int subsetIndex = clientId % subsetCount;
+
+    std::vector<int> order = roundOrder(sortedIds, round);
+    auto start = order.begin() + subsetIndex * subsetSize;
+    std::vector<int> subset(start, start + subsetSize);
+    std::sort(subset.begin(), subset.end());
+
+    return subset;
+}
+
+std::vector<int> DeterministicSubsetter::updateSubset(const std::vector<int>& previousSubset,
+                                                      const std::vector<int>& serverIds) const {
+    std::unordered_set<int> present(serverIds.begin(), serverIds.end());
+    std::vector<int> fresh = computeSubset(serverIds);
+    std::unordered_set<int> freshIds(fresh.begin(), fresh.end());
+
+    std::vector<int> subset;
+    std::unordered_set<int> chosen;
+    for (int id : previousSubset) {
+        if (present.count(id) && static_cast<int>(subset.size()) < subsetSize) {
+            subset.push_back(id);
+            chosen.insert(id);
+        }
+    }
+
+    // Bounded drift toward the fresh subset
+    int moves = std::max(1, subsetSize / 4);
+    auto admit = fresh.begin();
+    for (auto& id : subset) {
+        if (moves == 0) break;
+        if (freshIds.count(id)) continue;
+
+        while (admit != fresh.end() && chosen.count(*admit)) ++admit;
+        if (admit == fresh.end()) break;
+        chosen.erase(id);
+        id = *admit;
+        chosen.insert(id);
+        moves--;
+    }
+
+    if (static_cast<int>(subset.size()) < subsetSize) {
+        // Fill from the fresh subset first, then from the rest of this client's round order
+        std::vector<int> candidates = fresh;
+
+        std::vector<int> sortedIds(serverIds.begin(), serverIds.end());
+        std::sort(sortedIds.begin(), sortedIds.end());
+        if (static_cast<int>(sortedIds.size()) > subsetSize) {
+            int subsetCount = static_cast<int>(sortedIds.size()) / subsetSize;
+            std::vector<int> order = roundOrder(sortedIds, clientId / subsetCount);
+            candidates.insert(candidates.end(), order.begin(), order.end());
+        }
+
+        for (int id : candidates) {
+            if (static_cast<int>(subset.size()) >= subsetSize) break;
+            if (chosen.insert(id).second) {
+                subset.push_back(id);
+            }
+        }
+    }
+
+    std::sort(subset.begin(), subset.end());
+    return subset;
+}
@@ -0,0 +1,109 @@
+// tenant_quota.cpp
+#include "include/tenant_quota.h"
+#include <algorithm>
+
+TenantQuotaManager::TenantQuotaManager() : unusedReservations(0) {
+}
+
+int TenantQuotaManager::unusedReservation(const TenantQuota& quota) {
+    return std::max(0, quota.reservation - quota.usage);
+}
+
+TenantQuota& TenantQuotaManager::tenant(int tenantId) {
+    auto it = tenants.find(tenantId);
+    if (it == tenants.end()) {
+        it = tenants.emplace(tenantId, TenantQuota{0, 0, 0, 0}).first;
+    }
+    return it->second;
+}
+
+void TenantQuotaManager::setQuota(int tenantId, int reservation, int limit) {
+    TenantQuota& quota = tenant(tenantId);
+    unusedReservations -= unusedReservation(quota);
+    quota.reservation = std::max(0, reservation);
+    quota.limit = std::max(0, limit);
+    unusedReservations += unusedReservation(quota);
+}
+
+void TenantQuotaManager::removeTenant(int tenantId) {
+    auto it = tenants.find(tenantId);
+    if (it == tenants.end()) return;
+
+    unusedReservations -= unusedReservation(it->second);
+    tenants.erase(it);
+}
+
+int TenantQuotaManager::admit(int tenantId, int requested, int freeCapacity) const {
+    if (requested <= 0) return 0;
+
+    auto it = tenants.find(tenantId);
+    if (it == tenants.end()) {
+        // Unknown tenants may only use capacity nobody has reserved
+        if (unusedReservations == 0) return requested;
+        return static_cast<int>(std::max<long long>(0, std::min<long long>(requested, freeCapacity - unusedReservations)));
+    }
+
+    const TenantQuota& quota = it->second;
+    long long allowed = requested;
+
+    if (quota.limit > 0) {
+        allowed = std::min<long long>(allowed, quota.limit - quota.usage);
+    }
+
+    long long othersReserved = unusedReservations - unusedReservation(quota);
+    if (othersReserved > 0) {
+        allowed = std::min<long long>(allowed, freeCapacity - othersReserved);
+    }
+
+    return static_cast<int>(std::max<long long>(0, allowed));
+}
+
+bool TenantQuotaManager::needsFreeCapacity(int tenantId) const {
+    auto it = tenants.find(tenantId);
+    int own = (it == tenants.end()) ? 0 : unusedReservation(it->second);
+    return unusedReservations - own > 0;
+}
+
+void TenantQuotaManager::commit(int tenantId, int placed, int rejected) {
+    TenantQuota& quota = tenant(tenantId);
+    unusedReservations -= unusedReservation(quota);
+    quota.usage += std::max(0, placed);
+    quota.rejected += std::max(0, rejected);
+    unusedReservations += unusedReservation(quota);
+}
+
+void TenantQuotaManager::release(int tenantId, int amount) {
+    auto it = tenants.find(tenantId);
+    if (it == tenants.end()) return;
+
+    TenantQuota& quota = it->second;
+    unusedReservations -= unusedReservation(quota);
+    quota.usage = std::max(0, quota.usage - std::max(0, amount));
+    unusedReservations += unusedReservation(quota);
+}
+
+void TenantQuotaManager::setUsage(int tenantId, int usage) {
+    TenantQuota& quota = tenant(tenantId);
+    unusedReservations -= unusedReservation(quota);
+    quota.usage = std::max(0, usage);
+    unusedReservations += unusedReservation(quota);
+}
+
+const TenantQuota* TenantQuotaManager::getQuota(int tenantId) const {
+    auto it = tenants.find(tenantId);
+    return it == tenants.end() ? nullptr : &it->second;
+}
+
+std::vector<int> TenantQuotaManager::getTenantIds() const {
+    std::vector<int> ids;
+    ids.reserve(tenants.size());
+    for (const auto& entry : tenants) {
+        ids.push_back(entry.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+long long TenantQuotaManager::getUnusedReservations() const {
+    return unusedReservations;
+}
@@ -0,0 +1,263 @@
+// tls_termination.cpp
+#include "include/tls_termination.h"
+#include "include/placement_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+TlsSessionCache::TlsSessionCache(size_t shardCount, size_t capacity, double lifetimeSeconds, const KeyHasher& hasher)
+    : hasher(hasher), lifetimeSeconds(lifetimeSeconds) {
+    size_t count = 1;
+    while (count < shardCount) {
+        count <<= 1;
+    }
+    shardMask = count - 1;
+    capacityPerShard = std::max<size_t>(1, capacity / count);
+
+    shards.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+    }
+}
+
+TlsSessionCache::Shard& TlsSessionCache::shardFor(uint64_t sessionId) const {
+    return *shards[hasher.hashInt(sessionId) & shardMask];
+}
+
+void TlsSessionCache::store(uint64_t sessionId, int backendId, double now) {
+    Shard& shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(sessionId);
+    if (it != shard.index.end()) {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    shard.lru.push_front(Entry{sessionId, backendId, now + lifetimeSeconds});
+    shard.index[sessionId] = shard.lru.begin();
+
+    if (shard.lru.size() > capacityPerShard) {
+        shard.index.erase(shard.lru.back().sessionId);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+}
+
+bool TlsSessionCache::lookup(uint64_t sessionId, double now, int& backendId) {
+    Shard& shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(sessionId);
+    if (it == shard.index.end()) return false;
+
+    if (it->second->expiresAt <= now) {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        return false;
+    }
+
+    // A resumption does not extend the session's lifetime, only its LRU position
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    backendId = it->second->backendId;
+    return true;
+}
+
+void TlsSessionCache::erase(uint64_t sessionId) {
+    Shard& shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(sessionId);
+    if (it != shard.index.end()) {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+size_t TlsSessionCache::size() const {
+    size_t total = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->lru.size();
+    }
+    return total;
+}
+
+uint64_t TlsSessionCache::getEvictions() const {
+    uint64_t total = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->evictions;
+    }
+    return total;
+}
+
+void TlsSessionCache::resetEvictions() {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->evictions = 0;
+    }
+}
+
+size_t TlsSessionCache::getShardCount() const {
+    return shards.size();
+}
+
+double TlsSessionCache::getLifetime() const {
+    return lifetimeSeconds;
+}
+
+TlsTerminator::TlsTerminator(size_t cacheShards, size_t cacheCapacity, double sessionLifetimeSeconds,
+                             const KeyHasher& hasher)
+    : cache(cacheShards, cacheCapacity, sessionLifetimeSeconds, hasher),
+      ticketsEnabled(true),
+      kernelTls(false),
+      ticketEpoch(0),
+      acceptedTicketKeys(2),
+      nextSessionId(1),
+      fullHandshakes(0),
+      resumedBySessionId(0),
+      resumedByTicket(0),
+      cpuNanos(0) {
+}
+
+void TlsTerminator::setCostModel(const TlsCostModel& model) {
+    cost = model;
+}
+
+void TlsTerminator::setTicketsEnabled(bool enabled) {
+    ticketsEnabled = enabled;
+}
+
+bool TlsTerminator::areTicketsEnabled() const {
+    return ticketsEnabled;
+}
+
+void TlsTerminator::setKernelTls(bool enabled) {
+    kernelTls = enabled;
+}
+
+bool TlsTerminator::isKernelTls() const {
+    return kernelTls;
+}
+
+void TlsTerminator::rotateTicketKey() {
+    ticketEpoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TlsTerminator::ticketValid(const SessionTicket& ticket, double now) const {
+    uint32_t current = ticketEpoch.load(std::memory_order_relaxed);
+    if (ticket.keyEpoch > current || current - ticket.keyEpoch >= acceptedTicketKeys) return false;
+    return now - ticket.issuedAt < cache.getLifetime();
+}
+
+void TlsTerminator::charge(double us) {
+    cpuNanos.fetch_add(static_cast<uint64_t>(us * 1000.0), std::memory_order_relaxed);
+}
+
+double TlsTerminator::recordCostUs(size_t bytes) const {
+    double kb = bytes / 1024.0;
+    return kb * (cost.recordCryptoUsPerKb + (kernelTls ? 0.0 : cost.copyUsPerKb));
+}
+
+void TlsTerminator::chargeRecords(size_t bytes) {
+    charge(recordCostUs(bytes));
+}
+
+TlsTerminationStats TlsTerminator::getStats() const {
+    TlsTerminationStats stats;
+    stats.fullHandshakes = fullHandshakes.load(std::memory_order_relaxed);
+    stats.resumedBySessionId = resumedBySessionId.load(std::memory_order_relaxed);
+    stats.resumedByTicket = resumedByTicket.load(std::memory_order_relaxed);
+    stats.cacheEvictions = cache.getEvictions();
+    stats.cachedSessions = cache.size();
+    stats.cpuSeconds = cpuNanos.load(std::memory_order_relaxed) / 1e9;
+    return stats;
+}
+
+void TlsTerminator::resetStats() {
+    fullHandshakes = 0;
+    resumedBySessionId = 0;
+    resumedByTicket = 0;
+    cpuNanos = 0;
+    cache.resetEvictions();
+}
+
+TlsBenchmarkReport TlsTerminator::benchmark(const std::vector<int>& backendIds, int clients, int connectionsPerClient,
+                                            double reconnectIntervalSeconds, unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    TlsBenchmarkReport report;
+    report.clients = std::max(0, clients);
+    report.connectionsPerClient = std::max(0, connectionsPerClient);
+    report.threads = threads;
+    report.tickets = ticketsEnabled;
+
+    TlsTerminationStats before = getStats();
+    auto start = std::chrono::steady_clock::now();
+
+    // New sessions go to a backend picked by session id, as keyed routing would
+    auto pickBackend = [&backendIds](uint64_t sessionId) {
+        return backendIds.empty() ? -1 : backendIds[sessionId % backendIds.size()];
+    };
+    std::unordered_set<int> liveBackends(backendIds.begin(), backendIds.end());
+    auto backendAlive = [&liveBackends](int backendId) {
+        return liveBackends.count(backendId) > 0;
+    };
+
+    // Every client reconnects once per round, so sessions compete for the cache
+    // the way concurrent clients would
+    std::vector<TlsClientHello> hellos(report.clients, TlsClientHello{0, false, SessionTicket{0, 0, -1, 0.0}});
+    for (int round = 0; round < report.connectionsPerClient; round++) {
+        placement::forEachBatch(hellos.size(), threads, 64, [&](size_t first, size_t last) {
+            for (size_t client = first; client < last; client++) {
+                // Clients are staggered over the interval
+                double now = reconnectIntervalSeconds * (round + static_cast<double>(client) / hellos.size());
+                TlsHandshakeResult result = handshake(hellos[client], now, pickBackend, backendAlive);
+                hellos[client].sessionId = result.sessionId;
+                hellos[client].hasTicket = ticketsEnabled;
+                hellos[client].ticket = result.ticket;
+            }
+        });
+    }
+
+    report.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    TlsTerminationStats after = getStats();
+    report.stats = after;
+    report.stats.fullHandshakes -= before.fullHandshakes;
+    report.stats.resumedBySessionId -= before.resumedBySessionId;
+    report.stats.resumedByTicket -= before.resumedByTicket;
+    report.stats.cacheEvictions -= before.cacheEvictions;
+    report.stats.cpuSeconds -= before.cpuSeconds;
+
+    uint64_t total = report.stats.total();
+    report.handshakesPerSecond = report.elapsedMs > 0.0 ? total / (report.elapsedMs / 1000.0) : 0.0;
+    report.modeledHandshakesPerCore = report.stats.cpuSeconds > 0.0 ? total / report.stats.cpuSeconds : 0.0;
+    return report;
+}
+
+std::string TlsTerminator::formatReport(const TlsBenchmarkReport& report) {
+    const TlsTerminationStats& stats = report.stats;
+    std::stringstream ss;
+    ss << "=== TLS TERMINATION BENCHMARK ===" << std::endl;
+    ss << "Clients: " << report.clients << " x " << report.connectionsPerClient << " connections, "
+       << (report.tickets ? "session tickets" : "session ids only") << std::endl;
+    ss << "Handshakes: " << stats.total() << " (" << stats.fullHandshakes << " full, "
+       << stats.resumedBySessionId << " session id, " << stats.resumedByTicket << " ticket)" << std::endl;
+    ss << "Resumed/Full: " << std::fixed << std::setprecision(1) << (100.0 * stats.resumedRatio()) << "% / "
+       << (100.0 * (1.0 - stats.resumedRatio())) << "%" << std::endl;
+    ss << "Session Cache: " << stats.cachedSessions << " sessions, " << stats.cacheEvictions << " evictions" << std::endl;
+    ss << "Throughput: " << std::setprecision(0) << report.handshakesPerSecond << " handshakes/s ("
+       << std::setprecision(2) << report.elapsedMs << " ms)" << std::endl;
+    ss << "Modeled CPU: " << std::setprecision(3) << stats.cpuSeconds << " s, " << std::setprecision(0)
+       << report.modeledHandshakesPerCore << " handshakes/s per core" << std::endl;
+    ss << "=================================" << std::endl;
+    return ss.str();
+}
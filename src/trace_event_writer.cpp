@@ -0,0 +1,154 @@
+// trace_event_writer.cpp
+#include "include/trace_event_writer.h"
+#include <iostream>
+#include <cstdio>
+
+namespace {
+
+// Appends text as the body of a JSON string
+void appendEscaped(std::string& buffer, const char* text) {
+    for (const char* c = text; *c; c++) {
+        switch (*c) {
+            case '"':  buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(*c));
+                    buffer += escaped;
+                } else {
+                    buffer += *c;
+                }
+        }
+    }
+}
+
+} // namespace
+
+TraceEventWriter::TraceEventWriter(const std::string& path, size_t bufferSize)
+    : flushThreshold(bufferSize), firstEvent(true), failed(false), startTime(std::chrono::steady_clock::now()) {
+    out.open(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Warning: Could not open trace file " << path << std::endl;
+        return;
+    }
+
+    buffer.reserve(flushThreshold + 4096);
+    buffer += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+}
+
+TraceEventWriter::~TraceEventWriter() {
+    close();
+}
+
+bool TraceEventWriter::isOpen() const {
+    return out.is_open();
+}
+
+double TraceEventWriter::nowUs() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void TraceEventWriter::beginEvent(const std::string& name, const char* category, char phase,
+                                  int tid, double timestampUs) {
+    char header[96];
+    std::snprintf(header, sizeof(header), "\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                  phase, tid, timestampUs);
+
+    if (!firstEvent) buffer += ",\n";
+    firstEvent = false;
+
+    buffer += "{\"name\":\"";
+    appendEscaped(buffer, name.c_str());
+    buffer += "\",\"cat\":\"";
+    appendEscaped(buffer, category);
+    buffer += header;
+}
+
+void TraceEventWriter::endEvent(const std::string& args) {
+    if (!args.empty()) {
+        buffer += ",\"args\":";
+        buffer += args;
+    }
+    buffer += "}";
+
+    if (buffer.size() >= flushThreshold) {
+        flush();
+    }
+}
+
+void TraceEventWriter::setProcessName(const std::string& name) {
+    if (!isOpen()) return;
+    beginEvent("process_name", "__metadata", 'M', 0, 0.0);
+    std::string args = "{\"name\":\"";
+    appendEscaped(args, name.c_str());
+    endEvent(args + "\"}");
+}
+
+void TraceEventWriter::setThreadName(int tid, const std::string& name) {
+    if (!isOpen()) return;
+    beginEvent("thread_name", "__metadata", 'M', tid, 0.0);
+    std::string args = "{\"name\":\"";
+    appendEscaped(args, name.c_str());
+    endEvent(args + "\"}");
+}
+
+void TraceEventWriter::instant(const std::string& name, const char* category, int tid, const std::string& args) {
+    if (!isOpen()) return;
+    beginEvent(name, category, 'i', tid, nowUs());
+    buffer += ",\"s\":\"t\"";
+    endEvent(args);
+}
+
+void TraceEventWriter::begin(const std::string& name, const char* category, int tid, const std::string& args) {
+    if (!isOpen()) return;
+    beginEvent(name, category, 'B', tid, nowUs());
+    endEvent(args);
+}
+
+void TraceEventWriter::end(const std::string& name, const char* category, int tid) {
+    if (!isOpen()) return;
+    beginEvent(name, category, 'E', tid, nowUs());
+    endEvent("");
+}
+
+void TraceEventWriter::complete(const std::string& name, const char* category, int tid,
+                                double timestampUs, double durationUs, const std::string& args) {
+    if (!isOpen()) return;
+    beginEvent(name, category, 'X', tid, timestampUs);
+
+    char duration[48];
+    std::snprintf(duration, sizeof(duration), ",\"dur\":%.3f", durationUs);
+    buffer += duration;
+    endEvent(args);
+}
+
+void TraceEventWriter::counter(const std::string& name, const char* series, double value) {
+    if (!isOpen()) return;
+    // Each counter name becomes its own track
+    beginEvent(name, "counter", 'C', 0, nowUs());
+
+    char number[48];
+    std::snprintf(number, sizeof(number), "\":%.3f}", value);
+    std::string args = "{\"";
+    appendEscaped(args, series);
+    endEvent(args + number);
+}
+
+void TraceEventWriter::flush() {
+    if (!isOpen() || buffer.empty()) return;
+    out.write(buffer.data(), buffer.size());
+    if (!out.good()) failed = true;
+    buffer.clear();
+}
+
+bool TraceEventWriter::close() {
+    if (isOpen()) {
+        buffer += "\n]}\n";
+        flush();
+        out.close();
+    }
+    return !failed && !out.fail();
+}
@@ -0,0 +1,562 @@
+// udp_forwarder.cpp
+#include "include/udp_forwarder.h"
+#include "include/load_balancer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace {
+
+const int kBatchSize = 64;
+const size_t kMaxDatagram = 9216;            // EDNS responses and jumbo frames; larger ones are dropped
+const int kMaxSegments = 64;                 // kernel limit on GSO segments per send
+const size_t kMaxGsoBytes = 65507;           // a GSO send is segmented from one UDP datagram
+const int kReceiveTimeoutMs = 50;            // workers notice stop() this often
+const int kSocketBufferBytes = 4 << 20;
+
+int openUdpSocket(uint16_t port, bool reusePort) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    if (reusePort) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+    int bufferBytes = kSocketBufferBytes;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+uint16_t boundPort(int fd) {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) return 0;
+    return ntohs(address.sin_port);
+}
+
+} // namespace
+
+UdpFlowTable::UdpFlowTable(size_t capacity, uint32_t idleTimeoutSeconds, const KeyHasher& hasher)
+    : idleTimeout(std::max<uint32_t>(1, idleTimeoutSeconds)), hasher(hasher), liveFlows(0), rebuildPending(false),
+      rebuilds(0) {
+    size_t size = 16;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+    for (size_t i = 0; i < size; i++) {
+        slots[i].key.store(kEmpty, std::memory_order_relaxed);
+        slots[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t UdpFlowTable::flowKey(const sockaddr_in& source, uint16_t listenPort) {
+    return (static_cast<uint64_t>(ntohl(source.sin_addr.s_addr)) << 32) |
+           (static_cast<uint64_t>(ntohs(source.sin_port)) << 16) | listenPort;
+}
+
+void UdpFlowTable::touch(Slot& slot, uint64_t value, uint32_t now) {
+    // At most one write per flow per second; a failed CAS means it just expired
+    if (lastSeenOf(value) != now) {
+        slot.value.compare_exchange_strong(value, packValue(serverOf(value), now), std::memory_order_acq_rel);
+    }
+}
+
+uint64_t UdpFlowTable::awaitValue(Slot& slot, uint64_t flow) const {
+    for (;;) {
+        uint64_t value = slot.value.load(std::memory_order_acquire);
+        if (value != 0) return value;
+        if (slot.key.load(std::memory_order_acquire) != flow) return 0;
+        std::this_thread::yield();
+    }
+}
+
+int UdpFlowTable::lookup(uint64_t flow, uint32_t now) {
+    size_t start = hasher.hashInt(flow) & mask;
+    for (size_t probe = 0; probe <= mask; probe++) {
+        Slot& slot = slots[(start + probe) & mask];
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key == kEmpty) break;
+        if (key != flow) continue;
+
+        uint64_t value = awaitValue(slot, flow);
+        if (value == 0) continue;
+        touch(slot, value, now);
+        return serverOf(value);
+    }
+    return -1;
+}
+
+std::shared_lock<std::shared_mutex> UdpFlowTable::reader() const {
+    while (rebuildPending.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    return std::shared_lock<std::shared_mutex>(maintenance);
+}
+
+void UdpFlowTable::rebuild() {
+    rebuildPending.store(true, std::memory_order_release);
+    std::unique_lock<std::shared_mutex> lock(maintenance);
+
+    // No reader is inside the table, so live flows are simply reinserted
+    std::vector<std::pair<uint64_t, uint64_t>> live;
+    live.reserve(size());
+    for (size_t i = 0; i <= mask; i++) {
+        uint64_t key = slots[i].key.load(std::memory_order_relaxed);
+        if (key != kEmpty && key != kTombstone) {
+            live.emplace_back(key, slots[i].value.load(std::memory_order_relaxed));
+        }
+        slots[i].key.store(kEmpty, std::memory_order_relaxed);
+        slots[i].value.store(0, std::memory_order_relaxed);
+    }
+    for (auto& flow : live) {
+        size_t i = hasher.hashInt(flow.first) & mask;
+        while (slots[i].key.load(std::memory_order_relaxed) != kEmpty) {
+            i = (i + 1) & mask;
+        }
+        slots[i].key.store(flow.first, std::memory_order_relaxed);
+        slots[i].value.store(flow.second, std::memory_order_relaxed);
+    }
+    rebuilds++;
+    rebuildPending.store(false, std::memory_order_release);
+}
+
+size_t UdpFlowTable::size() const {
+    return liveFlows.load(std::memory_order_relaxed);
+}
+
+size_t UdpFlowTable::capacity() const {
+    return mask + 1;
+}
+
+uint64_t UdpFlowTable::getRebuilds() const {
+    std::shared_lock<std::shared_mutex> lock(maintenance);
+    return rebuilds;
+}
+
+UdpForwarder::UdpForwarder(LoadBalancer& balancer, uint16_t listenPort, unsigned workers,
+                           size_t flowCapacity, uint32_t idleTimeoutSeconds)
+    : balancer(balancer),
+      flows(flowCapacity, idleTimeoutSeconds, balancer.getKeyHasher()),
+      listenPort(listenPort),
+      workerCount(std::max(1u, workers)),
+      running(false),
+      gsoEnabled(false),
+      startTime(std::chrono::steady_clock::now()),
+      packetsIn(0),
+      packetsOut(0),
+      dropped(0),
+      truncated(0),
+      batches(0),
+      gsoSends(0),
+      newFlows(0),
+      expiredFlows(0) {
+}
+
+UdpForwarder::~UdpForwarder() {
+    stop();
+}
+
+void UdpForwarder::addBackend(int serverId, uint16_t port) {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    backends[serverId] = address;
+}
+
+bool UdpForwarder::start() {
+    if (running) return true;
+
+    // The first socket fixes the port (ephemeral when 0); the rest join it
+    for (unsigned i = 0; i < workerCount; i++) {
+        int fd = openUdpSocket(listenPort, true);
+        if (fd < 0) {
+            for (int open : sockets) close(open);
+            sockets.clear();
+            return false;
+        }
+        if (i == 0) listenPort = boundPort(fd);
+
+        timeval timeout = {0, kReceiveTimeoutMs * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockets.push_back(fd);
+    }
+
+    // GSO needs Linux 4.18+; the socket option probes for it
+    int segment = 0;
+    gsoEnabled = setsockopt(sockets[0], SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0;
+
+    startTime = std::chrono::steady_clock::now();
+    running = true;
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(&UdpForwarder::workerLoop, this, i);
+    }
+    return true;
+}
+
+void UdpForwarder::stop() {
+    if (!running.exchange(false)) return;
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    for (int fd : sockets) {
+        close(fd);
+    }
+    sockets.clear();
+    expireFlows(nowSeconds(), true);
+}
+
+uint32_t UdpForwarder::nowSeconds() const {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+void UdpForwarder::expireFlows(uint32_t now, bool all) {
+    size_t expired = flows.expireIdle(now, [this](int serverId) { balancer.releaseFlow(serverId); }, all);
+    expiredFlows.fetch_add(expired, std::memory_order_relaxed);
+}
+
+void UdpForwarder::workerLoop(unsigned index) {
+    int fd = sockets[index];
+    std::vector<char> buffers(kBatchSize * kMaxDatagram);
+    std::vector<char> coalesced(kBatchSize * kMaxDatagram);
+
+    mmsghdr in[kBatchSize];
+    iovec inIov[kBatchSize];
+    sockaddr_in sources[kBatchSize];
+    std::memset(in, 0, sizeof(in));
+    for (int i = 0; i < kBatchSize; i++) {
+        inIov[i].iov_base = &buffers[i * kMaxDatagram];
+        inIov[i].iov_len = kMaxDatagram;
+        in[i].msg_hdr.msg_iov = &inIov[i];
+        in[i].msg_hdr.msg_iovlen = 1;
+        in[i].msg_hdr.msg_name = &sources[i];
+    }
+
+    mmsghdr out[kBatchSize];
+    iovec outIov[kBatchSize];
+    int outSegments[kBatchSize];
+    alignas(cmsghdr) char control[kBatchSize][CMSG_SPACE(sizeof(uint16_t))];
+    const sockaddr_in* destinations[kBatchSize];
+    uint32_t lastSweep = nowSeconds();
+
+    while (running.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < kBatchSize; i++) {
+            in[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+        }
+
+        int received = recvmmsg(fd, in, kBatchSize, MSG_WAITFORONE, nullptr);
+        uint32_t now = nowSeconds();
+
+        // One worker sweeps idle flows, at most once a second
+        if (index == 0 && now != lastSweep) {
+            expireFlows(now, false);
+            lastSweep = now;
+        }
+        if (received <= 0) continue;
+
+        // Resolve every datagram's backend through the flow table
+        uint64_t created = 0;
+        uint64_t cut = 0;
+        auto reader = flows.reader();
+        for (int i = 0; i < received; i++) {
+            if (in[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                destinations[i] = nullptr;
+                cut++;
+                continue;
+            }
+
+            bool isNew = false;
+            int serverId = flows.route(UdpFlowTable::flowKey(sources[i], listenPort), now,
+                                       [this]() { return balancer.assignFlow(); },
+                                       [this](int id) { balancer.releaseFlow(id); }, isNew);
+            if (isNew) created++;
+
+            auto backend = backends.find(serverId);
+            destinations[i] = (backend != backends.end()) ? &backend->second : nullptr;
+        }
+        reader.unlock();
+
+        // Build the send batch, coalescing runs of equal-size datagrams to one
+        // backend into GSO sends (the last datagram of a run may be shorter)
+        bool gso = gsoEnabled.load(std::memory_order_relaxed);
+        int messages = 0;
+        size_t coalescedBytes = 0;
+        uint64_t unroutable = 0;
+        for (int i = 0; i < received;) {
+            if (!destinations[i]) {
+                if (!(in[i].msg_hdr.msg_flags & MSG_TRUNC)) unroutable++;
+                i++;
+                continue;
+            }
+
+            size_t length = in[i].msg_len;
+            int end = i + 1;
+            if (gso) {
+                const int maxRun = static_cast<int>(std::min<size_t>(kMaxSegments, kMaxGsoBytes / length));
+                while (end < received && end - i < maxRun && destinations[end] == destinations[i] &&
+                       in[end].msg_len == length) {
+                    end++;
+                }
+                if (end < received && end - i < maxRun && destinations[end] == destinations[i] &&
+                    in[end].msg_len < length) {
+                    end++;
+                }
+            }
+
+            mmsghdr& message = out[messages];
+            std::memset(&message, 0, sizeof(message));
+            message.msg_hdr.msg_name = const_cast<sockaddr_in*>(destinations[i]);
+            message.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            message.msg_hdr.msg_iov = &outIov[messages];
+            message.msg_hdr.msg_iovlen = 1;
+            outSegments[messages] = end - i;
+
+            if (end - i > 1) {
+                char* run = &coalesced[coalescedBytes];
+                size_t runBytes = 0;
+                for (int j = i; j < end; j++) {
+                    std::memcpy(run + runBytes, inIov[j].iov_base, in[j].msg_len);
+                    runBytes += in[j].msg_len;
+                }
+                coalescedBytes += runBytes;
+                outIov[messages].iov_base = run;
+                outIov[messages].iov_len = runBytes;
+
+                message.msg_hdr.msg_control = control[messages];
+                message.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                cmsghdr* header = CMSG_FIRSTHDR(&message.msg_hdr);
+                header->cmsg_level = SOL_UDP;
+                header->cmsg_type = UDP_SEGMENT;
+                header->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(length);
+                std::memcpy(CMSG_DATA(header), &segmentSize, sizeof(segmentSize));
+            } else {
+                outIov[messages].iov_base = inIov[i].iov_base;
+                outIov[messages].iov_len = length;
+            }
+
+            messages++;
+            i = end;
+        }
+
+        // sendmmsg may stop early; resume after the messages it did send
+        uint64_t sent = 0;
+        uint64_t gsoMessages = 0;
+        int next = 0;
+        while (next < messages) {
+            int result = sendmmsg(fd, out + next, messages - next, 0);
+            if (result <= 0) {
+                if (errno == EINTR) continue;
+
+                // A kernel that rejects the segment cmsg gets plain sends from now on
+                if (errno == EINVAL || errno == EIO) {
+                    gsoEnabled = false;
+                }
+                for (int m = next; m < messages; m++) {
+                    unroutable += outSegments[m];
+                }
+                break;
+            }
+            for (int m = next; m < next + result; m++) {
+                sent += outSegments[m];
+                if (outSegments[m] > 1) gsoMessages++;
+            }
+            next += result;
+        }
+
+        packetsIn.fetch_add(received, std::memory_order_relaxed);
+        packetsOut.fetch_add(sent, std::memory_order_relaxed);
+        dropped.fetch_add(unroutable, std::memory_order_relaxed);
+        truncated.fetch_add(cut, std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        gsoSends.fetch_add(gsoMessages, std::memory_order_relaxed);
+        newFlows.fetch_add(created, std::memory_order_relaxed);
+    }
+}
+
+uint16_t UdpForwarder::getListenPort() const {
+    return listenPort;
+}
+
+bool UdpForwarder::isGsoEnabled() const {
+    return gsoEnabled;
+}
+
+UdpForwarderStats UdpForwarder::getStats() const {
+    UdpForwarderStats stats;
+    stats.packetsIn = packetsIn.load(std::memory_order_relaxed);
+    stats.packetsOut = packetsOut.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.truncated = truncated.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    stats.gsoSends = gsoSends.load(std::memory_order_relaxed);
+    stats.newFlows = newFlows.load(std::memory_order_relaxed);
+    stats.expiredFlows = expiredFlows.load(std::memory_order_relaxed);
+    stats.tableRebuilds = flows.getRebuilds();
+    return stats;
+}
+
+size_t UdpForwarder::getFlowCount() const {
+    return flows.size();
+}
+
+UdpBenchmarkReport UdpForwarder::benchmark(LoadBalancer& balancer, int flows, int packetsPerFlow,
+                                           unsigned workers, size_t payloadBytes) {
+    UdpBenchmarkReport report;
+    std::memset(&report, 0, sizeof(report));
+    report.flows = std::max(1, flows);
+    report.packetsPerFlow = std::max(1, packetsPerFlow);
+    report.workers = std::max(1u, workers);
+    report.payloadBytes = std::max<size_t>(1, std::min(payloadBytes, kMaxDatagram));
+
+    // One sink per online server stands in for the backend
+    UdpForwarder forwarder(balancer, 0, report.workers, 4 * report.flows);
+    std::vector<int> sinks;
+    for (auto& server : balancer.getServers()) {
+        if (!server->isOnline()) continue;
+        int fd = openUdpSocket(0, false);
+        if (fd < 0) continue;
+        sinks.push_back(fd);
+        forwarder.addBackend(server->getId(), boundPort(fd));
+    }
+
+    std::vector<int> clients;
+    for (int i = 0; i < report.flows; i++) {
+        int fd = openUdpSocket(0, false);
+        if (fd < 0) break;
+        clients.push_back(fd);
+    }
+
+    if (sinks.empty() || clients.empty() || !forwarder.start()) {
+        for (int fd : sinks) close(fd);
+        for (int fd : clients) close(fd);
+        return report;
+    }
+    report.flows = static_cast<int>(clients.size());
+    report.gso = forwarder.isGsoEnabled();
+
+    sockaddr_in target;
+    std::memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    target.sin_port = htons(forwarder.getListenPort());
+    for (int fd : clients) {
+        connect(fd, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+    }
+
+    // Sinks drain on their own thread until the senders are done and traffic stops
+    std::atomic<uint64_t> received(0);
+    std::atomic<bool> sending(true);
+    std::thread drain([&]() {
+        std::vector<pollfd> polls;
+        for (int fd : sinks) polls.push_back(pollfd{fd, POLLIN, 0});
+        std::vector<char> buffer(kBatchSize * kMaxDatagram);
+        mmsghdr messages[kBatchSize];
+        iovec iovs[kBatchSize];
+        std::memset(messages, 0, sizeof(messages));
+        for (int i = 0; i < kBatchSize; i++) {
+            iovs[i].iov_base = &buffer[i * kMaxDatagram];
+            iovs[i].iov_len = kMaxDatagram;
+            messages[i].msg_hdr.msg_iov = &iovs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int quietPolls = 0;
+        while (sending || quietPolls < 4) {
+            int ready = poll(polls.data(), polls.size(), 50);
+            if (ready <= 0) {
+                if (!sending) quietPolls++;
+                continue;
+            }
+            quietPolls = 0;
+            for (auto& p : polls) {
+                if (!(p.revents & POLLIN)) continue;
+                int count = recvmmsg(p.fd, messages, kBatchSize, MSG_DONTWAIT, nullptr);
+                if (count > 0) received.fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    // Flows take turns sending a burst, so the forwarder sees them interleaved
+    const int burst = 32;
+    std::vector<char> payload(report.payloadBytes, 'x');
+    mmsghdr messages[burst];
+    iovec iov = {payload.data(), payload.size()};
+    std::memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < burst; i++) {
+        messages[i].msg_hdr.msg_iov = &iov;
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int offset = 0; offset < report.packetsPerFlow; offset += burst) {
+        int count = std::min(burst, report.packetsPerFlow - offset);
+        for (int fd : clients) {
+            int result = sendmmsg(fd, messages, count, 0);
+            if (result > 0) report.sent += result;
+        }
+    }
+    sending = false;
+    drain.join();
+
+    // The drain waited out four quiet polls after the last datagram arrived
+    report.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count() - 4 * 50.0;
+    report.elapsedMs = std::max(report.elapsedMs, 1.0);
+    report.received = received;
+    report.forwarder = forwarder.getStats();
+    report.packetsPerSecond = report.received / (report.elapsedMs / 1000.0);
+
+    forwarder.stop();
+    report.forwarder.expiredFlows = forwarder.getStats().expiredFlows;
+    for (int fd : sinks) close(fd);
+    for (int fd : clients) close(fd);
+    return report;
+}
+
+std::string UdpForwarder::formatReport(const UdpBenchmarkReport& report) {
+    const UdpForwarderStats& stats = report.forwarder;
+    std::stringstream ss;
+    ss << "=== UDP FORWARDING BENCHMARK ===" << std::endl;
+    ss << "Flows: " << report.flows << " x " << report.packetsPerFlow << " datagrams of "
+       << report.payloadBytes << " bytes, " << report.workers << " worker(s)" << std::endl;
+    ss << "Sent: " << report.sent << ", forwarded: " << stats.packetsOut << ", received: " << report.received
+       << ", dropped: " << stats.dropped << ", truncated: " << stats.truncated << std::endl;
+    ss << "Batches: " << stats.batches << " (" << std::fixed << std::setprecision(1)
+       << (stats.batches ? static_cast<double>(stats.packetsIn) / stats.batches : 0.0) << " datagrams each), GSO "
+       << (report.gso ? "on" : "off") << " with " << stats.gsoSends << " coalesced sends" << std::endl;
+    ss << "New flows: " << stats.newFlows << ", expired: " << stats.expiredFlows << ", table rebuilds: "
+       << stats.tableRebuilds << std::endl;
+    ss << "Throughput: " << std::setprecision(0) << report.packetsPerSecond << " packets/s ("
+       << std::setprecision(2) << report.elapsedMs << " ms)" << std::endl;
+    ss << "================================" << std::endl;
+    return ss.str();
+}
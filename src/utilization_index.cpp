@@ -0,0 +1,115 @@
+// utilization_index.cpp
+#include "include/utilization_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void UtilizationIndex::update(int serverId, double loadPercentage, bool online) {
+    auto it = indexed.find(serverId);
+    if (it != indexed.end()) {
+        if (online && it->second == loadPercentage) return;
+        sorted.erase(it->second, serverId);
+        if (!online) {
+            indexed.erase(it);
+            return;
+        }
+        it->second = loadPercentage;
+    } else {
+        if (!online) return;
+        indexed.emplace(serverId, loadPercentage);
+    }
+    sorted.insert(loadPercentage, serverId);
+}
+
+void UtilizationIndex::remove(int serverId) {
+    auto it = indexed.find(serverId);
+    if (it == indexed.end()) return;
+    sorted.erase(it->second, serverId);
+    indexed.erase(it);
+}
+
+void UtilizationIndex::clear() {
+    indexed.clear();
+    sorted.clear();
+}
+
+int UtilizationIndex::size() const {
+    return sorted.size();
+}
+
+double UtilizationIndex::percentile(double p) const {
+    int n = sorted.size();
+    if (n == 0) return 0.0;
+
+    p = std::max(0.0, std::min(100.0, p));
+    int rank = std::max(1, static_cast<int>(std::ceil(p / 100.0 * n)));
+
+    double value = 0.0;
+    int id = 0;
+    sorted.select(rank - 1, value, id);
+    return value;
+}
+
+int UtilizationIndex::rankOf(int serverId) const {
+    auto it = indexed.find(serverId);
+    if (it == indexed.end()) return 0;
+    return sorted.size() - sorted.countLess(it->second, serverId);
+}
+
+int UtilizationIndex::kthMostLoaded(int k) const {
+    return kthLeastLoaded(sorted.size() + 1 - k);
+}
+
+int UtilizationIndex::kthLeastLoaded(int k) const {
+    double value = 0.0;
+    int id = -1;
+    if (!sorted.select(k - 1, value, id)) return -1;
+    return id;
+}
+
+std::vector<int> UtilizationIndex::mostLoaded(int n) const {
+    std::vector<int> ids;
+    n = std::min(n, sorted.size());
+    ids.reserve(std::max(0, n));
+    for (int k = 1; k <= n; k++) {
+        ids.push_back(kthMostLoaded(k));
+    }
+    return ids;
+}
+
+std::vector<int> UtilizationIndex::leastLoaded(int n) const {
+    std::vector<int> ids;
+    n = std::min(n, sorted.size());
+    ids.reserve(std::max(0, n));
+    for (int k = 1; k <= n; k++) {
+        ids.push_back(kthLeastLoaded(k));
+    }
+    return ids;
+}
+
+double UtilizationIndex::mean() const {
+    int n = sorted.size();
+    return n > 0 ? sorted.total() / n : 0.0;
+}
+
+double UtilizationIndex::variance() const {
+    int n = sorted.size();
+    if (n == 0) return 0.0;
+    double m = sorted.total() / n;
+    return std::max(0.0, sorted.totalSquares() / n - m * m);
+}
+
+std::vector<int> UtilizationIndex::histogram(const std::vector<double>& bounds) const {
+    std::vector<int> counts;
+    counts.reserve(bounds.size() + 1);
+
+    // Every key with value below a bound sorts before (bound, lowest id)
+    int below = 0;
+    for (double bound : bounds) {
+        int upTo = sorted.countLess(bound, std::numeric_limits<int>::min());
+        counts.push_back(upTo - below);
+        below = upTo;
+    }
+    counts.push_back(sorted.size() - below);
+    return counts;
+}